@@ -0,0 +1,194 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include "frame_search.h"
+
+static const char *TAG = "frame_search";
+
+// below this many trials per task the hand-off costs more than it saves
+#define FRAME_SEARCH_MIN_TRIES_PER_TASK     (2)
+
+typedef struct
+{
+    frame_search_pool_t *pool;
+    int index;                      // part index, 0 is the calling task's
+    SemaphoreHandle_t start;
+    fsk_frame_candidate result;
+} frame_search_worker_t;
+
+struct frame_search_pool
+{
+    int nworkers;                   // running helper tasks
+    int nslots;                     // allocated length of workers
+    frame_search_worker_t *workers;
+    SemaphoreHandle_t done;
+    bool quit;
+
+    // the search in progress, set up by frame_search_find_frame()
+    fsk_plan *fskp;
+    fsk_sample_t *samples;
+    unsigned int frame_nsamples;
+    unsigned int try_first_sample;
+    unsigned int try_max_nsamples;
+    unsigned int try_step_nsamples;
+    float try_confidence_search_limit;
+    const char *expect_bits_string;
+    unsigned int ntries;
+    int nparts;
+};
+
+static void search_part(frame_search_pool_t *pool, int part, fsk_frame_candidate *result)
+{
+    unsigned int j_begin = pool->ntries * part / pool->nparts;
+    unsigned int j_end = pool->ntries * (part + 1) / pool->nparts;
+    fsk_frame_candidate_init(result);
+    fsk_find_frame_try(pool->fskp, pool->samples, pool->frame_nsamples,
+                       pool->try_first_sample, pool->try_max_nsamples,
+                       pool->try_step_nsamples, j_begin, j_end,
+                       pool->try_confidence_search_limit,
+                       pool->expect_bits_string, result);
+}
+
+static void frame_search_task(void *pv)
+{
+    frame_search_worker_t *worker = (frame_search_worker_t *)pv;
+    frame_search_pool_t *pool = worker->pool;
+    while (1) {
+        xSemaphoreTake(worker->start, portMAX_DELAY);
+        if (pool->quit) {
+            break;
+        }
+        search_part(pool, worker->index, &worker->result);
+        xSemaphoreGive(pool->done);
+    }
+    xSemaphoreGive(pool->done);
+    vTaskDelete(NULL);
+}
+
+frame_search_pool_t *frame_search_pool_create(const frame_search_cfg_t *config)
+{
+    if (config->nworkers <= 0) {
+        return NULL;
+    }
+    frame_search_pool_t *pool = calloc(1, sizeof(frame_search_pool_t));
+    if (pool == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: frame_search_pool_t");
+        return NULL;
+    }
+    pool->nslots = config->nworkers;
+    pool->workers = calloc(pool->nslots, sizeof(frame_search_worker_t));
+    pool->done = xSemaphoreCreateCounting(pool->nslots, 0);
+    if (pool->workers == NULL || pool->done == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: frame_search workers");
+        frame_search_pool_destroy(pool);
+        return NULL;
+    }
+    for (int i = 0; i < config->nworkers; i++) {
+        frame_search_worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i + 1;
+        worker->start = xSemaphoreCreateBinary();
+        if (worker->start == NULL) {
+            ESP_LOGE(TAG, "Out of memory allocating: frame_search semaphore");
+            frame_search_pool_destroy(pool);
+            return NULL;
+        }
+        int core = (config->task_core + i) % portNUM_PROCESSORS;
+        if (xTaskCreatePinnedToCore(frame_search_task, "frame_search", config->task_stack,
+                                    worker, config->task_prio, NULL, core) != pdPASS) {
+            ESP_LOGE(TAG, "Error creating frame_search task");
+            frame_search_pool_destroy(pool);
+            return NULL;
+        }
+        pool->nworkers++;
+    }
+    ESP_LOGI(TAG, "%d frame search workers, first on core %d prio %d",
+             pool->nworkers, config->task_core, config->task_prio);
+    return pool;
+}
+
+void frame_search_pool_destroy(frame_search_pool_t *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    pool->quit = true;
+    for (int i = 0; i < pool->nworkers; i++) {
+        xSemaphoreGive(pool->workers[i].start);
+    }
+    for (int i = 0; i < pool->nworkers; i++) {
+        xSemaphoreTake(pool->done, portMAX_DELAY);
+    }
+    for (int i = 0; pool->workers != NULL && i < pool->nslots; i++) {
+        if (pool->workers[i].start != NULL) {
+            vSemaphoreDelete(pool->workers[i].start);
+        }
+    }
+    if (pool->done != NULL) {
+        vSemaphoreDelete(pool->done);
+    }
+    free(pool->workers);
+    free(pool);
+}
+
+float frame_search_find_frame(frame_search_pool_t *pool, fsk_plan *fskp,
+                              fsk_sample_t *samples, unsigned int frame_nsamples,
+                              unsigned int try_first_sample,
+                              unsigned int try_max_nsamples,
+                              unsigned int try_step_nsamples,
+                              float try_confidence_search_limit,
+                              const char *expect_bits_string,
+                              unsigned long long *bits_outp,
+                              float *ampl_outp,
+                              unsigned int *frame_start_outp)
+{
+    unsigned int ntries = fsk_find_frame_ntries(try_first_sample, try_max_nsamples,
+                                                try_step_nsamples);
+    int nparts = pool != NULL ? pool->nworkers + 1 : 1;
+    while (nparts > 1 && ntries < nparts * FRAME_SEARCH_MIN_TRIES_PER_TASK) {
+        nparts--;
+    }
+    // the FFT analyzer works in fskp->fftin and can't run concurrently
+    if (nparts == 1 || fskp->analyzer == FSK_ANALYZER_FFT) {
+        return fsk_find_frame(fskp, samples, frame_nsamples, try_first_sample,
+                              try_max_nsamples, try_step_nsamples,
+                              try_confidence_search_limit, expect_bits_string,
+                              bits_outp, ampl_outp, frame_start_outp);
+    }
+
+    pool->fskp = fskp;
+    pool->samples = samples;
+    pool->frame_nsamples = frame_nsamples;
+    pool->try_first_sample = try_first_sample;
+    pool->try_max_nsamples = try_max_nsamples;
+    pool->try_step_nsamples = try_step_nsamples;
+    pool->try_confidence_search_limit = try_confidence_search_limit;
+    pool->expect_bits_string = expect_bits_string;
+    pool->ntries = ntries;
+    pool->nparts = nparts;
+
+    for (int i = 0; i < nparts - 1; i++) {
+        xSemaphoreGive(pool->workers[i].start);
+    }
+    fsk_frame_candidate best;
+    search_part(pool, 0, &best);
+    for (int i = 0; i < nparts - 1; i++) {
+        xSemaphoreTake(pool->done, portMAX_DELAY);
+    }
+    for (int i = 0; i < nparts - 1; i++) {
+        fsk_frame_candidate_merge(&best, &pool->workers[i].result);
+    }
+
+    *bits_outp = best.bits;
+    *ampl_outp = best.ampl;
+    *frame_start_outp = best.frame_start;
+    return best.confidence;
+}
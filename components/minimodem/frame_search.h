@@ -0,0 +1,50 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_FRAME_SEARCH_H
+#define CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_FRAME_SEARCH_H
+
+#include "fsk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Worker pool that splits the trial offsets of one fsk_find_frame() search
+ * between the calling task and nworkers helper tasks.  The caller scans the
+ * first (most likely) share itself, the helpers the rest, and the parts are
+ * merged in scan order, so the result is the same as fsk_find_frame()'s.
+ */
+typedef struct frame_search_pool frame_search_pool_t;
+
+typedef struct
+{
+    int nworkers;       /*!< Helper tasks, 0 searches on the caller only */
+    int task_stack;     /*!< Helper task stack size */
+    int task_core;      /*!< Core of the first helper, further ones alternate */
+    int task_prio;      /*!< Helper task priority (based on freeRTOS priority) */
+} frame_search_cfg_t;
+
+frame_search_pool_t *frame_search_pool_create(const frame_search_cfg_t *config);
+
+void frame_search_pool_destroy(frame_search_pool_t *pool);
+
+/* same as fsk_find_frame(), pool may be NULL */
+float frame_search_find_frame(frame_search_pool_t *pool, fsk_plan *fskp,
+                              fsk_sample_t *samples, unsigned int frame_nsamples,
+                              unsigned int try_first_sample,
+                              unsigned int try_max_nsamples,
+                              unsigned int try_step_nsamples,
+                              float try_confidence_search_limit,
+                              const char *expect_bits_string,
+                              unsigned long long *bits_outp,
+                              float *ampl_outp,
+                              unsigned int *frame_start_outp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_FRAME_SEARCH_H
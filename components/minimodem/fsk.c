@@ -28,6 +28,50 @@
 #include <assert.h>
 
 #include "fsk.h"
+#include "minimodem_config.h"
+
+static inline float
+goertzel_coeff(fsk_plan *fskp, unsigned int band)
+{
+    return 2.0f * cosf(2.0f * (float)M_PI * (float)band / (float)fskp->fftsize);
+}
+
+static void
+set_goertzel_coeffs(fsk_plan *fskp)
+{
+    unsigned int k;
+    for (k = 0; k < fskp->ntones; k++) {
+        fskp->goertzel_coeff[k] = goertzel_coeff(fskp, fskp->b_tones[k]);
+#ifdef FSK_FIXED_POINT
+        fskp->goertzel_coeff_q14[k] = lrintf(fskp->goertzel_coeff[k] * 16384.0f);
+#endif
+    }
+}
+
+#ifdef FSK_FIXED_POINT
+// cos/sin of 0 is +1.0, which Q15 can't hold; saturate it
+static inline fsk_twiddle_t
+to_twiddle(float v)
+{
+    long q = lrintf(v * 32768.0f);
+    return q > INT16_MAX ? INT16_MAX : q;
+}
+#else
+# define to_twiddle(v) (v)
+#endif
+
+/*
+ * Sliding-DFT accumulator type and sample * twiddle product.  In the fixed
+ * point build each product is rounded the same way when the sample enters
+ * and when it leaves the window, so the integer sums never drift.
+ */
+#ifdef FSK_FIXED_POINT
+typedef int32_t fsk_acc_t;
+# define twiddle_mul(x, w)   (((int32_t)(x) * (w)) >> 15)
+#else
+typedef float fsk_acc_t;
+# define twiddle_mul(x, w)   ((x) * (w))
+#endif
 
 fsk_plan *
 fsk_plan_new(
@@ -37,13 +81,34 @@ fsk_plan_new(
     float filter_bw
 )
 {
+    const float f_tones[2] = {f_space, f_mark};
+    return fsk_plan_new_tones(sample_rate, f_tones, 2, filter_bw);
+}
+
+fsk_plan *
+fsk_plan_new_tones(
+    float sample_rate,
+    const float *f_tones,
+    unsigned int ntones,
+    float filter_bw
+)
+{
+    if (ntones < 2 || ntones > FSK_MAX_TONES || (ntones & (ntones - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
     fsk_plan *fskp = malloc(sizeof(fsk_plan));
     if (!fskp)
         return NULL;
 
     fskp->sample_rate = sample_rate;
-    fskp->f_mark = f_mark;
-    fskp->f_space = f_space;
+    fskp->f_mark = f_tones[1];
+    fskp->f_space = f_tones[0];
+    fskp->ntones = ntones;
+    fskp->bits_per_symbol = 0;
+    while ((1u << fskp->bits_per_symbol) < ntones)
+        fskp->bits_per_symbol++;
 
 #ifdef USE_FFT
     fskp->band_width = filter_bw;
@@ -52,17 +117,21 @@ fsk_plan_new(
     fskp->fftsize = (sample_rate + fft_half_bw) / fskp->band_width;
     fskp->nbands = fskp->fftsize / 2 + 1;
 
-    fskp->b_mark = (f_mark + fft_half_bw) / fskp->band_width;
-    fskp->b_space = (f_space + fft_half_bw) / fskp->band_width;
-    if (fskp->b_mark >= fskp->nbands || fskp->b_space >= fskp->nbands) {
-        fprintf(stderr, "b_mark=%u or b_space=%u is invalid (nbands=%u)\n",
-                fskp->b_mark, fskp->b_space, fskp->nbands);
-        free(fskp);
-        errno = EINVAL;
-        return NULL;
+    unsigned int k;
+    for (k = 0; k < ntones; k++) {
+        fskp->b_tones[k] = (f_tones[k] + fft_half_bw) / fskp->band_width;
+        if (fskp->b_tones[k] >= fskp->nbands) {
+            fprintf(stderr, "b_tones[%u]=%u is invalid (nbands=%u)\n",
+                    k, fskp->b_tones[k], fskp->nbands);
+            free(fskp);
+            errno = EINVAL;
+            return NULL;
+        }
     }
-    debug_log("### b_mark=%u b_space=%u fftsize=%d\n",
-              fskp->b_mark, fskp->b_space, fskp->fftsize);
+    fskp->b_mark = fskp->b_tones[1];
+    fskp->b_space = fskp->b_tones[0];
+    debug_log("### b_mark=%u b_space=%u ntones=%u fftsize=%d\n",
+              fskp->b_mark, fskp->b_space, ntones, fskp->fftsize);
 
 
     // FIXME:
@@ -90,6 +159,34 @@ fsk_plan_new(
     }
 #endif
 
+    fskp->analyzer = FSK_ANALYZER_DEFAULT;
+    set_goertzel_coeffs(fskp);
+
+    fskp->dft_cos = malloc(fskp->fftsize * sizeof(fsk_twiddle_t));
+    fskp->dft_sin = malloc(fskp->fftsize * sizeof(fsk_twiddle_t));
+    if (!fskp->dft_cos || !fskp->dft_sin) {
+        fprintf(stderr, "fsk_plan_new: out of memory\n");
+        free(fskp->dft_cos);
+        free(fskp->dft_sin);
+        fftwf_destroy_plan(fskp->fftplan);
+        fftwf_free(fskp->fftin);
+        fftwf_free(fskp->fftout);
+        free(fskp);
+        errno = ENOMEM;
+        return NULL;
+    }
+    int i;
+    for (i = 0; i < fskp->fftsize; i++) {
+        fskp->dft_cos[i] = to_twiddle(cosf(2.0f * (float)M_PI * i / fskp->fftsize));
+        fskp->dft_sin[i] = to_twiddle(sinf(2.0f * (float)M_PI * i / fskp->fftsize));
+    }
+    fskp->track_samples = NULL;
+    fskp->track_nstarts = 0;
+    fskp->track_size = 0;
+    fskp->track_bit_nsamples = 0;
+    for (k = 0; k < FSK_MAX_TONES; k++)
+        fskp->track_mag[k] = NULL;
+
     return fskp;
 }
 
@@ -99,6 +196,11 @@ fsk_plan_destroy(fsk_plan *fskp)
     fftwf_free(fskp->fftin);
     fftwf_free(fskp->fftout);
     fftwf_destroy_plan(fskp->fftplan);
+    free(fskp->dft_cos);
+    free(fskp->dft_sin);
+    unsigned int k;
+    for (k = 0; k < FSK_MAX_TONES; k++)
+        free(fskp->track_mag[k]);
     free(fskp);
 }
 
@@ -111,12 +213,98 @@ band_mag(fftwf_complex *const cplx, unsigned int band, float scalar)
     return mag;
 }
 
+/* copy samples into the (float) FFT input buffer */
 static void
-fsk_bit_analyze(fsk_plan *fskp, float *samples, unsigned int bit_nsamples,
-                unsigned int *bit_outp,
-                float *bit_signal_mag_outp,
-                float *bit_noise_mag_outp
-)
+load_fftin(fsk_plan *fskp, const fsk_sample_t *samples, unsigned int nsamples)
+{
+#ifdef FSK_FIXED_POINT
+    unsigned int i;
+    for (i = 0; i < nsamples; i++)
+        fskp->fftin[i] = samples[i] / 32768.0f;
+#else
+    memcpy(fskp->fftin, samples, nsamples * sizeof(float));
+#endif
+}
+
+#ifdef FSK_FIXED_POINT
+
+/*
+ * Squared magnitudes of the b_tones[k] and b_tones[k+1] bins of the
+ * fftsize-point DFT of samples[0..nsamples), in (int16 sample units)^2.
+ * Integer version of goertzel_tone_pair() below, with the recurrence
+ * coefficients in Q14.
+ */
+static void
+goertzel_tone_pair_q15(fsk_plan *fskp, const fsk_sample_t *samples,
+                       unsigned int nsamples, unsigned int k,
+                       fsk_bin_t *pw_mark_outp, fsk_bin_t *pw_space_outp)
+{
+    const int32_t cm = fskp->goertzel_coeff_q14[k];
+    const int32_t cs = fskp->goertzel_coeff_q14[k + 1];
+    int32_t m1 = 0, m2 = 0;
+    int32_t s1 = 0, s2 = 0;
+    unsigned int i;
+    for (i = 0; i < nsamples; i++) {
+        int32_t x = samples[i];
+        int32_t m0 = x + (int32_t)(((int64_t)cm * m1) >> 14) - m2;
+        int32_t s0 = x + (int32_t)(((int64_t)cs * s1) >> 14) - s2;
+        m2 = m1;
+        m1 = m0;
+        s2 = s1;
+        s1 = s0;
+    }
+    int64_t pm = (int64_t)m1 * m1 + (int64_t)m2 * m2
+        - (((int64_t)m1 * m2 * cm) >> 14);
+    int64_t ps = (int64_t)s1 * s1 + (int64_t)s2 * s2
+        - (((int64_t)s1 * s2 * cs) >> 14);
+    *pw_mark_outp = pm > 0 ? pm : 0;
+    *pw_space_outp = ps > 0 ? ps : 0;
+}
+
+/* bin magnitude for the confidence estimate, on the float path's scale */
+static inline float
+bin_mag(fsk_bin_t pw, float magscalar)
+{
+    return sqrtf((float)pw) * (magscalar / 32768.0f);
+}
+
+#else
+
+/*
+ * Magnitudes of the b_tones[k] and b_tones[k+1] bins of the fftsize-point
+ * DFT of samples[0..nsamples) (zero padded), i.e. the same values band_mag()
+ * reads from the FFT output, computed with two Goertzel recurrences in one
+ * pass.  A BFSK plan has just the one pair.
+ */
+static void
+goertzel_tone_pair(fsk_plan *fskp, const float *samples, unsigned int nsamples,
+                   unsigned int k, float magscalar,
+                   float *mag_mark_outp, float *mag_space_outp)
+{
+    const float cm = fskp->goertzel_coeff[k];
+    const float cs = fskp->goertzel_coeff[k + 1];
+    float m1 = 0.0f, m2 = 0.0f;
+    float s1 = 0.0f, s2 = 0.0f;
+    unsigned int i;
+    for (i = 0; i < nsamples; i++) {
+        float x = samples[i];
+        float m0 = x + cm * m1 - m2;
+        float s0 = x + cs * s1 - s2;
+        m2 = m1;
+        m1 = m0;
+        s2 = s1;
+        s1 = s0;
+    }
+    float pm = m1 * m1 + m2 * m2 - cm * m1 * m2;
+    float ps = s1 * s1 + s2 * s2 - cs * s1 * s2;
+    // rounding can take a (near) zero power slightly negative
+    *mag_mark_outp = (pm > 0.0f ? sqrtf(pm) : 0.0f) * magscalar;
+    *mag_space_outp = (ps > 0.0f ? sqrtf(ps) : 0.0f) * magscalar;
+}
+
+static void
+fft_tones(fsk_plan *fskp, const float *samples, unsigned int bit_nsamples,
+          float magscalar, float *mags_outp)
 {
     // FIXME: Fast and loose ... don't bzero fftin, just assume its only ever
     // been used for bit_nsamples so the remainder is still zeroed.  Sketchy.
@@ -124,9 +312,7 @@ fsk_bit_analyze(fsk_plan *fskp, float *samples, unsigned int bit_nsamples,
     // unsigned int pa_nchannels = 1;	// FIXME
     // bzero(fskp->fftin, (fskp->fftsize * sizeof(float) * pa_nchannels));
 
-    memcpy(fskp->fftin, samples, bit_nsamples * sizeof(float));
-
-    float magscalar = 2.0f / (float)bit_nsamples;
+    load_fftin(fskp, samples, bit_nsamples);
 
 #if 0
     //// apodization window
@@ -151,111 +337,105 @@ fsk_bit_analyze(fsk_plan *fskp, float *samples, unsigned int bit_nsamples,
 #endif
 
     fftwf_execute(fskp->fftplan);
-    float mag_mark = band_mag(fskp->fftout, fskp->b_mark, magscalar);
-    float mag_space = band_mag(fskp->fftout, fskp->b_space, magscalar);
-    // mark==1, space==0
-    if (mag_mark > mag_space) {
-        *bit_outp = 1;
-        *bit_signal_mag_outp = mag_mark;
-        *bit_noise_mag_outp = mag_space;
-    } else {
-        *bit_outp = 0;
-        *bit_signal_mag_outp = mag_space;
-        *bit_noise_mag_outp = mag_mark;
-    }
-    debug_log("\t%.2f  %.2f  %s  bit=%u sig=%.2f noise=%.2f\n",
-              mag_mark, mag_space,
-              mag_mark > mag_space ? "mark      " : "     space",
-              *bit_outp, *bit_signal_mag_outp, *bit_noise_mag_outp);
+    unsigned int k;
+    for (k = 0; k < fskp->ntones; k++)
+        mags_outp[k] = band_mag(fskp->fftout, fskp->b_tones[k], magscalar);
 }
 
-/* returns confidence value [0.0 to INFINITY] */
-static float
-fsk_frame_analyze(fsk_plan *fskp, float *samples, float samples_per_bit,
-                  int n_bits, const char *expect_bits_string,
-                  unsigned long long *bits_outp, float *ampl_outp)
-{
-    unsigned int bit_nsamples = (float)(samples_per_bit + 0.5f);
-
-    unsigned int bit_values[64];
-    float bit_sig_mags[64];
-    float bit_noise_mags[64];
-    unsigned int bit_begin_sample;
-    int bitnum;
-
-// various deprecated noise limiter schemes:
-//#define FSK_MIN_BIT_SNR 1.4
-//#define FSK_MIN_MAGNITUDE 0.10
-//#define FSK_AVOID_TRANSIENTS	0.7
-
-    const char *expect_bits = expect_bits_string;
-
-    /* pass #1 - process and check only the "required" (1/0) expect_bits */
-    for (bitnum = 0; bitnum < n_bits; bitnum++) {
-        if (expect_bits[bitnum] == 'd')
-            continue;
-        assert(expect_bits[bitnum] == '1' || expect_bits[bitnum] == '0');
-
-        bit_begin_sample = (float)(samples_per_bit * bitnum + 0.5f);
-        debug_log(" bit# %2d @ %7u: ", bitnum, bit_begin_sample);
-        fsk_bit_analyze(fskp, samples + bit_begin_sample, bit_nsamples,
-                        &bit_values[bitnum],
-                        &bit_sig_mags[bitnum],
-                        &bit_noise_mags[bitnum]);
-
-        if ((expect_bits[bitnum] - '0') != bit_values[bitnum])
-            return 0.0; /* does not match expected; abort frame analysis. */
+#endif /* FSK_FIXED_POINT */
 
-#ifdef FSK_MIN_BIT_SNR
-        float bit_snr = bit_sig_mags[bitnum] / bit_noise_mags[bitnum];
-        if ( bit_snr < FSK_MIN_BIT_SNR )
-            return 0.0;
-#endif
-
-# ifdef FSK_MIN_MAGNITUDE
-        // Performance hack: reject frame early if sig mag isn't even half
-        // of FSK_MIN_MAGNITUDE
-        if ( bit_sig_mags[bitnum] < FSK_MIN_MAGNITUDE/2.0 )
-            return 0.0; // too weak; abort frame analysis
-# endif
+/*
+ * The symbol is the strongest tone, ties going to the lower value; the
+ * runner-up is its noise.
+ */
+static void
+fsk_bit_analyze(fsk_plan *fskp, fsk_sample_t *samples, unsigned int bit_nsamples,
+                unsigned int *bit_outp,
+                float *bit_signal_mag_outp,
+                float *bit_noise_mag_outp
+)
+{
+    float magscalar = 2.0f / (float)bit_nsamples;
+    unsigned int k, best = 0, second = 1;
+    const int tracked = fskp->track_samples && samples >= fskp->track_samples
+        && samples < fskp->track_samples + fskp->track_nstarts
+        && bit_nsamples == fskp->track_bit_nsamples;
+#ifdef FSK_FIXED_POINT
+    fsk_bin_t pw[FSK_MAX_TONES] = {0};
+
+    // the FFT analyzer isn't available on integer samples
+    if (tracked) {
+        for (k = 0; k < fskp->ntones; k++)
+            pw[k] = fskp->track_mag[k][samples - fskp->track_samples];
+    } else {
+        for (k = 0; k < fskp->ntones; k += 2)
+            goertzel_tone_pair_q15(fskp, samples, bit_nsamples, k,
+                                   &pw[k], &pw[k + 1]);
     }
 
-#ifdef FSK_AVOID_TRANSIENTS
-    // FIXME: fsk_frame_analyze shouldn't care about start/stop bits,
-    // and this really is only correct for "10dd..dd1" format frames anyway:
-    // FIXME: this is totally defective, if the checked bits weren't
-    // even calculated in pass #1 (e.g. if there are no pass #1 expect bits).
-    /* Compare strength of stop bit and start bit, to avoid detecting
-     * a transient as a start bit, as often results in a single false
-     * character when the mark "leader" tone begins.  Require that the
-     * diff between start bit and stop bit strength not be "large". */
-    float s_mag = bit_sig_mags[1]; // start bit
-    float p_mag = bit_sig_mags[n_bits-1]; // stop bit
-    if ( fabsf(s_mag-p_mag) > (s_mag * FSK_AVOID_TRANSIENTS) ) {
-    debug_log(" avoid transient\n");
-    return 0.0;
+    if (pw[1] > pw[0]) {
+        best = 1;
+        second = 0;
     }
-#endif
-
-    /* pass #2 - process only the dontcare ('d') expect_bits */
-    for (bitnum = 0; bitnum < n_bits; bitnum++) {
-        if (expect_bits[bitnum] != 'd')
-            continue;
-        bit_begin_sample = (float)(samples_per_bit * bitnum + 0.5f);
-        debug_log(" bit# %2d @ %7u: ", bitnum, bit_begin_sample);
-        fsk_bit_analyze(fskp, samples + bit_begin_sample, bit_nsamples,
-                        &bit_values[bitnum],
-                        &bit_sig_mags[bitnum],
-                        &bit_noise_mags[bitnum]);
-
-#ifdef FSK_MIN_BIT_SNR
-        float bit_snr = bit_sig_mags[bitnum] / bit_noise_mags[bitnum];
-        if ( bit_snr < FSK_MIN_BIT_SNR )
-            return 0.0;
-#endif
+    for (k = 2; k < fskp->ntones; k++) {
+        if (pw[k] > pw[best]) {
+            second = best;
+            best = k;
+        } else if (pw[k] > pw[second]) {
+            second = k;
+        }
     }
+    *bit_outp = best;
+    *bit_signal_mag_outp = bin_mag(pw[best], magscalar);
+    *bit_noise_mag_outp = bin_mag(pw[second], magscalar);
+    debug_log("\t%lld  %lld  bit=%u sig=%.2f noise=%.2f\n",
+              (long long)pw[0], (long long)pw[1],
+              *bit_outp, *bit_signal_mag_outp, *bit_noise_mag_outp);
+#else
+    float mag[FSK_MAX_TONES] = {0};
+
+    // samples inside the fsk_track_bins() table: just look the bit up
+    if (tracked) {
+        for (k = 0; k < fskp->ntones; k++)
+            mag[k] = fskp->track_mag[k][samples - fskp->track_samples];
+    } else if (fskp->analyzer == FSK_ANALYZER_GOERTZEL) {
+        for (k = 0; k < fskp->ntones; k += 2)
+            goertzel_tone_pair(fskp, samples, bit_nsamples, k, magscalar,
+                               &mag[k], &mag[k + 1]);
+    } else
+        fft_tones(fskp, samples, bit_nsamples, magscalar, mag);
+
+    if (mag[1] > mag[0]) {
+        best = 1;
+        second = 0;
+    }
+    for (k = 2; k < fskp->ntones; k++) {
+        if (mag[k] > mag[best]) {
+            second = best;
+            best = k;
+        } else if (mag[k] > mag[second]) {
+            second = k;
+        }
+    }
+    *bit_outp = best;
+    *bit_signal_mag_outp = mag[best];
+    *bit_noise_mag_outp = mag[second];
+    debug_log("\t%.2f  %.2f  bit=%u sig=%.2f noise=%.2f\n",
+              mag[0], mag[1],
+              *bit_outp, *bit_signal_mag_outp, *bit_noise_mag_outp);
+#endif
+}
 
-
+/*
+ * Confidence of a frame from the analyzed bits, and the bits as a word
+ * returns confidence value [0.0 to INFINITY]
+ */
+static inline float
+fsk_frame_confidence(fsk_plan *fskp, int n_bits, const unsigned int *bit_values,
+                     const float *bit_sig_mags, const float *bit_noise_mags,
+                     unsigned long long *bits_outp, float *ampl_outp)
+{
+    int bitnum;
 //#define CONFIDENCE_ALGO 	5
 #define CONFIDENCE_ALGO    6
 
@@ -264,8 +444,9 @@ fsk_frame_analyze(fsk_plan *fskp, float *samples, float samples_per_bit,
 #if CONFIDENCE_ALGO == 5 || CONFIDENCE_ALGO == 6
 
     float total_bit_sig = 0.0, total_bit_noise = 0.0;
-    float avg_mark_sig = 0.0, avg_space_sig = 0.0;
-    unsigned int n_mark = 0, n_space = 0;
+    // the average sig of each tone
+    float avg_tone_sig[FSK_MAX_TONES] = {0.0};
+    unsigned int n_tone[FSK_MAX_TONES] = {0};
     for (bitnum = 0; bitnum < n_bits; bitnum++) {
         // Deal with floating point data type quantization noise...
         // If total_bit_noise <= FLT_EPSILON, then assume it to be 0.0,
@@ -274,13 +455,8 @@ fsk_frame_analyze(fsk_plan *fskp, float *samples, float samples_per_bit,
         if (bit_noise_mags[bitnum] > FLT_EPSILON)
             total_bit_noise += bit_noise_mags[bitnum];
 
-        if (bit_values[bitnum] == 1) {
-            avg_mark_sig += bit_sig_mags[bitnum];
-            n_mark++;
-        } else {
-            avg_space_sig += bit_sig_mags[bitnum];
-            n_space++;
-        }
+        avg_tone_sig[bit_values[bitnum]] += bit_sig_mags[bitnum];
+        n_tone[bit_values[bitnum]]++;
     }
 
     // Compute the "frame SNR"
@@ -289,18 +465,18 @@ fsk_frame_analyze(fsk_plan *fskp, float *samples, float samples_per_bit,
     // Compute avg bit sig and noise magnitudes
     float avg_bit_sig = total_bit_sig / n_bits;
 
-    // Compute separate avg bit sig for mark and space
-    if (n_mark)
-        avg_mark_sig /= n_mark;
-    if (n_space)
-        avg_space_sig /= n_space;
+    // Compute separate avg bit sig for each tone
+    unsigned int k;
+    for (k = 0; k < fskp->ntones; k++)
+        if (n_tone[k])
+            avg_tone_sig[k] /= n_tone[k];
 
 #if CONFIDENCE_ALGO == 6
     // Compute average "divergence": bit_mag_divergence / other_bits_mag
     float divergence = 0.0;
     for (bitnum = 0; bitnum < n_bits; bitnum++) {
         float avg_bit_sig_other;
-        avg_bit_sig_other = bit_values[bitnum] ? avg_mark_sig : avg_space_sig;
+        avg_bit_sig_other = avg_tone_sig[bit_values[bitnum]];
         divergence += fabsf(bit_sig_mags[bitnum] - avg_bit_sig_other)
             / avg_bit_sig_other;
     }
@@ -430,50 +606,212 @@ fsk_frame_analyze(fsk_plan *fskp, float *samples, float samples_per_bit,
 
 
     // least significant bit first ... reverse the bits as we place them
-    // into the bits_outp word.
+    // into the bits_outp word, bits_per_symbol bits per symbol.
     *bits_outp = 0;
     for (bitnum = 0; bitnum < n_bits; bitnum++)
-        *bits_outp |= (unsigned long long)bit_values[bitnum] << bitnum;
+        *bits_outp |= (unsigned long long)bit_values[bitnum]
+            << (bitnum * fskp->bits_per_symbol);
 
     debug_log("    frame algo=%d confidence=%f ampl=%f\n",
               CONFIDENCE_ALGO, confidence, *ampl_outp);
     return confidence;
 }
 
-/* returns confidence value [0.0 to 1.0] */
-float
-fsk_find_frame(fsk_plan *fskp, float *samples, unsigned int frame_nsamples,
-               unsigned int try_first_sample,
-               unsigned int try_max_nsamples,
-               unsigned int try_step_nsamples,
-               float try_confidence_search_limit,
-               const char *expect_bits_string,
-               unsigned long long *bits_outp,
-               float *ampl_outp,
-               unsigned int *frame_start_outp
-)
+#ifdef MINIMODEM_FIXED_8N1
+
+/*
+ * fsk_frame_analyze() for frames of MINIMODEM_8N1_FRAME_NBITS symbols:
+ * prev_stop, start, data and stop. Only the values of the three framing
+ * symbols are taken from expect_bits_string, they are checked first like
+ * the generic version does. The frame length is a constant, so the loops
+ * unroll.
+ */
+static float
+fsk_frame_analyze(fsk_plan *fskp, fsk_sample_t *samples, float samples_per_bit,
+                  int n_bits, const char *expect_bits_string,
+                  unsigned long long *bits_outp, float *ampl_outp)
 {
-    int expect_n_bits = strlen(expect_bits_string);
+    static const int framing_bits[] = {0, 1, MINIMODEM_8N1_FRAME_NBITS - 1};
+    const unsigned int bit_nsamples = (float)(samples_per_bit + 0.5f);
+
+    unsigned int bit_values[MINIMODEM_8N1_FRAME_NBITS];
+    float bit_sig_mags[MINIMODEM_8N1_FRAME_NBITS];
+    float bit_noise_mags[MINIMODEM_8N1_FRAME_NBITS];
+    int i, bitnum;
+
+    assert(n_bits == MINIMODEM_8N1_FRAME_NBITS);
+
+    for (i = 0; i < 3; i++) {
+        bitnum = framing_bits[i];
+        fsk_bit_analyze(fskp, samples + (unsigned int)(samples_per_bit * bitnum + 0.5f),
+                        bit_nsamples, &bit_values[bitnum],
+                        &bit_sig_mags[bitnum], &bit_noise_mags[bitnum]);
+        if ((unsigned int)(expect_bits_string[bitnum] - '0') != bit_values[bitnum])
+            return 0.0; /* does not match expected; abort frame analysis. */
+    }
+    for (bitnum = 2; bitnum < MINIMODEM_8N1_FRAME_NBITS - 1; bitnum++) {
+        fsk_bit_analyze(fskp, samples + (unsigned int)(samples_per_bit * bitnum + 0.5f),
+                        bit_nsamples, &bit_values[bitnum],
+                        &bit_sig_mags[bitnum], &bit_noise_mags[bitnum]);
+    }
 
-    assert(expect_n_bits <= 64);    // protect fsk_frame_analyze()
+    return fsk_frame_confidence(fskp, MINIMODEM_8N1_FRAME_NBITS, bit_values,
+                                bit_sig_mags, bit_noise_mags, bits_outp, ampl_outp);
+}
 
-    float samples_per_bit = (float)frame_nsamples / expect_n_bits;
+#else
 
-    // try_step_nsamples = 1;	// pedantic TEST
+/* returns confidence value [0.0 to INFINITY] */
+static float
+fsk_frame_analyze(fsk_plan *fskp, fsk_sample_t *samples, float samples_per_bit,
+                  int n_bits, const char *expect_bits_string,
+                  unsigned long long *bits_outp, float *ampl_outp)
+{
+    unsigned int bit_nsamples = (float)(samples_per_bit + 0.5f);
+
+    unsigned int bit_values[64];
+    float bit_sig_mags[64];
+    float bit_noise_mags[64];
+    unsigned int bit_begin_sample;
+    int bitnum;
+
+// various deprecated noise limiter schemes:
+//#define FSK_MIN_BIT_SNR 1.4
+//#define FSK_MIN_MAGNITUDE 0.10
+//#define FSK_AVOID_TRANSIENTS	0.7
+
+    const char *expect_bits = expect_bits_string;
+
+    /* pass #1 - process and check only the "required" (1/0) expect_bits */
+    for (bitnum = 0; bitnum < n_bits; bitnum++) {
+        if (expect_bits[bitnum] == 'd')
+            continue;
+        assert(expect_bits[bitnum] >= '0'
+               && expect_bits[bitnum] < '0' + (int)fskp->ntones);
+
+        bit_begin_sample = (float)(samples_per_bit * bitnum + 0.5f);
+        debug_log(" bit# %2d @ %7u: ", bitnum, bit_begin_sample);
+        fsk_bit_analyze(fskp, samples + bit_begin_sample, bit_nsamples,
+                        &bit_values[bitnum],
+                        &bit_sig_mags[bitnum],
+                        &bit_noise_mags[bitnum]);
+
+        if ((expect_bits[bitnum] - '0') != bit_values[bitnum])
+            return 0.0; /* does not match expected; abort frame analysis. */
+
+#ifdef FSK_MIN_BIT_SNR
+        float bit_snr = bit_sig_mags[bitnum] / bit_noise_mags[bitnum];
+        if ( bit_snr < FSK_MIN_BIT_SNR )
+            return 0.0;
+#endif
+
+# ifdef FSK_MIN_MAGNITUDE
+        // Performance hack: reject frame early if sig mag isn't even half
+        // of FSK_MIN_MAGNITUDE
+        if ( bit_sig_mags[bitnum] < FSK_MIN_MAGNITUDE/2.0 )
+            return 0.0; // too weak; abort frame analysis
+# endif
+    }
+
+#ifdef FSK_AVOID_TRANSIENTS
+    // FIXME: fsk_frame_analyze shouldn't care about start/stop bits,
+    // and this really is only correct for "10dd..dd1" format frames anyway:
+    // FIXME: this is totally defective, if the checked bits weren't
+    // even calculated in pass #1 (e.g. if there are no pass #1 expect bits).
+    /* Compare strength of stop bit and start bit, to avoid detecting
+     * a transient as a start bit, as often results in a single false
+     * character when the mark "leader" tone begins.  Require that the
+     * diff between start bit and stop bit strength not be "large". */
+    float s_mag = bit_sig_mags[1]; // start bit
+    float p_mag = bit_sig_mags[n_bits-1]; // stop bit
+    if ( fabsf(s_mag-p_mag) > (s_mag * FSK_AVOID_TRANSIENTS) ) {
+    debug_log(" avoid transient\n");
+    return 0.0;
+    }
+#endif
+
+    /* pass #2 - process only the dontcare ('d') expect_bits */
+    for (bitnum = 0; bitnum < n_bits; bitnum++) {
+        if (expect_bits[bitnum] != 'd')
+            continue;
+        bit_begin_sample = (float)(samples_per_bit * bitnum + 0.5f);
+        debug_log(" bit# %2d @ %7u: ", bitnum, bit_begin_sample);
+        fsk_bit_analyze(fskp, samples + bit_begin_sample, bit_nsamples,
+                        &bit_values[bitnum],
+                        &bit_sig_mags[bitnum],
+                        &bit_noise_mags[bitnum]);
+
+#ifdef FSK_MIN_BIT_SNR
+        float bit_snr = bit_sig_mags[bitnum] / bit_noise_mags[bitnum];
+        if ( bit_snr < FSK_MIN_BIT_SNR )
+            return 0.0;
+#endif
+    }
+
+    return fsk_frame_confidence(fskp, n_bits, bit_values, bit_sig_mags, bit_noise_mags,
+                                bits_outp, ampl_outp);
+}
 
-    unsigned int best_t = 0;
-    float best_c = 0.0, best_a = 0.0;
-    unsigned long long best_bits = 0;
+#endif /* MINIMODEM_FIXED_8N1 */
 
-    // Scan the frame positions starting with the one try_first_sample,
-    // alternating between a step above that, a step below that, above, below,
-    // and so on, until we've scanned the whole try_max_nsamples range.
+/*
+ * fsk_find_frame() scans the frame positions starting with the one at
+ * try_first_sample, alternating between a step above that, a step below
+ * that, above, below, and so on, until it has scanned the whole
+ * try_max_nsamples range.  Trial number j of that scan is at offset
+ * try_first_sample + (j odd ? +1 : -1) * ((j + 1) / 2) * try_step_nsamples
+ * (negative offsets are skipped), and the scan ends at the first upward
+ * offset past the range.
+ */
+unsigned int
+fsk_find_frame_ntries(unsigned int try_first_sample,
+                      unsigned int try_max_nsamples,
+                      unsigned int try_step_nsamples)
+{
     int j;
     for (j = 0;; j++) {
         int up = (j % 2) ? 1 : -1;
         int t = try_first_sample + up * ((j + 1) / 2) * try_step_nsamples;
         if (t >= (int)try_max_nsamples)
-            break;
+            return j;
+    }
+}
+
+void
+fsk_frame_candidate_init(fsk_frame_candidate *cand)
+{
+    cand->confidence = 0.0;
+    cand->ampl = 0.0;
+    cand->bits = 0;
+    cand->frame_start = 0;
+    cand->search_limit_hit = 0;
+}
+
+void
+fsk_find_frame_try(fsk_plan *fskp, fsk_sample_t *samples, unsigned int frame_nsamples,
+                   unsigned int try_first_sample,
+                   unsigned int try_max_nsamples,
+                   unsigned int try_step_nsamples,
+                   unsigned int j_begin, unsigned int j_end,
+                   float try_confidence_search_limit,
+                   const char *expect_bits_string,
+                   fsk_frame_candidate *best)
+{
+#ifdef MINIMODEM_FIXED_8N1
+    const int expect_n_bits = MINIMODEM_8N1_FRAME_NBITS;
+#else
+    int expect_n_bits = strlen(expect_bits_string);
+#endif
+
+    // protect fsk_frame_analyze()
+    assert(expect_n_bits * fskp->bits_per_symbol <= 64);
+
+    float samples_per_bit = (float)frame_nsamples / expect_n_bits;
+
+    unsigned int j;
+    for (j = j_begin; j < j_end; j++) {
+        int up = (j % 2) ? 1 : -1;
+        int t = try_first_sample + up * (int)((j + 1) / 2) * (int)try_step_nsamples;
         if (t < 0)
             continue;
 
@@ -483,23 +821,60 @@ fsk_find_frame(fsk_plan *fskp, float *samples, unsigned int frame_nsamples,
         c = fsk_frame_analyze(fskp, samples + t, samples_per_bit,
                               expect_n_bits, expect_bits_string,
                               &bits_out, &ampl_out);
-        if (best_c < c) {
-            best_t = t;
-            best_c = c;
-            best_a = ampl_out;
-            best_bits = bits_out;
+        if (best->confidence < c) {
+            best->frame_start = t;
+            best->confidence = c;
+            best->ampl = ampl_out;
+            best->bits = bits_out;
             // If we find a frame with confidence > try_confidence_search_limit
             // quit searching.
-            if (best_c >= try_confidence_search_limit)
+            if (best->confidence >= try_confidence_search_limit) {
+                best->search_limit_hit = 1;
                 break;
+            }
         }
     }
+}
 
-    *bits_outp = best_bits;
-    *ampl_outp = best_a;
-    *frame_start_outp = best_t;
+void
+fsk_frame_candidate_merge(fsk_frame_candidate *best, const fsk_frame_candidate *part)
+{
+    // an earlier part that stopped the scan wins, otherwise ties go to
+    // the earlier part, exactly as in one sequential scan
+    if (best->search_limit_hit)
+        return;
+    if (best->confidence < part->confidence)
+        *best = *part;
+}
 
-    float confidence = best_c;
+/* returns confidence value [0.0 to 1.0] */
+float
+fsk_find_frame(fsk_plan *fskp, fsk_sample_t *samples, unsigned int frame_nsamples,
+               unsigned int try_first_sample,
+               unsigned int try_max_nsamples,
+               unsigned int try_step_nsamples,
+               float try_confidence_search_limit,
+               const char *expect_bits_string,
+               unsigned long long *bits_outp,
+               float *ampl_outp,
+               unsigned int *frame_start_outp
+)
+{
+    // try_step_nsamples = 1;	// pedantic TEST
+
+    fsk_frame_candidate best;
+    fsk_frame_candidate_init(&best);
+    fsk_find_frame_try(fskp, samples, frame_nsamples,
+                       try_first_sample, try_max_nsamples, try_step_nsamples,
+                       0, fsk_find_frame_ntries(try_first_sample,
+                                                try_max_nsamples, try_step_nsamples),
+                       try_confidence_search_limit, expect_bits_string, &best);
+
+    *bits_outp = best.bits;
+    *ampl_outp = best.ampl;
+    *frame_start_outp = best.frame_start;
+
+    float confidence = best.confidence;
 
     if (confidence == 0)
         return 0;
@@ -510,6 +885,8 @@ fsk_find_frame(fsk_plan *fskp, float *samples, unsigned int frame_nsamples,
     // Hmmm... we have now way to  distinguish between:
     // 		8-bit data with no start/stopbits == 8 bits
     // 		5-bit with prevstop+start+stop == 8 bits
+    int j;
+    int expect_n_bits = strlen(expect_bits_string);
     switch ( expect_n_bits ) {
       case 11:	bitchar = ( *bits_outp >> 2 ) & 0xFF;
         break;
@@ -525,7 +902,7 @@ fsk_find_frame(fsk_plan *fskp, float *samples, unsigned int frame_nsamples,
     debug_log("' datum='%c' (0x%02x)   c=%f  a=%f  t=%u\n",
         isprint(bitchar)||isspace(bitchar) ? bitchar : '.',
         bitchar,
-        confidence, best_a, best_t);
+        confidence, best.ampl, best.frame_start);
 #endif
 
     return confidence;
@@ -535,14 +912,14 @@ fsk_find_frame(fsk_plan *fskp, float *samples, unsigned int frame_nsamples,
 // #define FSK_AUTODETECT_MAX_FREQ		5000
 
 int
-fsk_detect_carrier(fsk_plan *fskp, float *samples, unsigned int nsamples,
+fsk_detect_carrier(fsk_plan *fskp, fsk_sample_t *samples, unsigned int nsamples,
                    float min_mag_threshold)
 {
     assert(nsamples <= fskp->fftsize);
 
     unsigned int pa_nchannels = 1;    // FIXME
     bzero(fskp->fftin, (fskp->fftsize * sizeof(float) * pa_nchannels));
-    memcpy(fskp->fftin, samples, nsamples * sizeof(float));
+    load_fftin(fskp, samples, nsamples);
     fftwf_execute(fskp->fftplan);
     float magscalar = 1.0f / ((float)nsamples / 2.0f);
     float max_mag = 0.0;
@@ -584,9 +961,134 @@ fsk_set_tones_by_bandshift(fsk_plan *fskp, unsigned int b_mark, int b_shift)
     assert(b_space >= 0);
     assert(b_space < fskp->nbands);
 
+    assert(fskp->ntones == 2);
     fskp->b_mark = b_mark;
     fskp->b_space = b_space;
+    fskp->b_tones[0] = b_space;
+    fskp->b_tones[1] = b_mark;
     fskp->f_mark = b_mark * fskp->band_width;
     fskp->f_space = b_space * fskp->band_width;
+    set_goertzel_coeffs(fskp);
+    fsk_track_invalidate(fskp);
+}
+
+void
+fsk_set_analyzer(fsk_plan *fskp, enum fsk_analyzer analyzer)
+{
+    fskp->analyzer = analyzer;
+}
+
+
+void
+fsk_track_invalidate(fsk_plan *fskp)
+{
+    fskp->track_samples = NULL;
+    fskp->track_nstarts = 0;
+}
+
+/*
+ * Fill track_mag[k] and track_mag[k+1] for the window starts, see
+ * fsk_track_bins().
+ */
+static void
+track_tone_pair(fsk_plan *fskp, const fsk_sample_t *samples, unsigned int nstarts,
+                unsigned int bit_nsamples, unsigned int k)
+{
+    /*
+     * The window sum W(t) = sum_{n<L} x[t+n] * e^(-j*w*(t+n)) is a difference
+     * of prefix sums, so it slides by one sample with one add and one subtract
+     * per bin.  |W(t)| equals the magnitude of the zero padded fftsize-point
+     * DFT bin of the window that fsk_bit_analyze() would compute (the e^(-j*w*t)
+     * factor only rotates the phase).  The fixed point build stores |W(t)|^2.
+     */
+    const unsigned int n = fskp->fftsize;
+    const unsigned int km = fskp->b_tones[k];
+    const unsigned int ks = fskp->b_tones[k + 1];
+    fsk_bin_t *track_m = fskp->track_mag[k];
+    fsk_bin_t *track_s = fskp->track_mag[k + 1];
+#ifndef FSK_FIXED_POINT
+    const float magscalar = 2.0f / (float)bit_nsamples;
+#endif
+    fsk_acc_t mre = 0, mim = 0, sre = 0, sim = 0;
+    // twiddle indices (k * sample) mod fftsize for the leading/trailing edge
+    unsigned int im_in = 0, is_in = 0, im_out = 0, is_out = 0;
+    unsigned int i, t;
+
+    for (i = 0; i < bit_nsamples; i++) {
+        fsk_sample_t x = samples[i];
+        mre += twiddle_mul(x, fskp->dft_cos[im_in]);
+        mim -= twiddle_mul(x, fskp->dft_sin[im_in]);
+        sre += twiddle_mul(x, fskp->dft_cos[is_in]);
+        sim -= twiddle_mul(x, fskp->dft_sin[is_in]);
+        if ((im_in += km) >= n)
+            im_in -= n;
+        if ((is_in += ks) >= n)
+            is_in -= n;
+    }
+    for (t = 0;; t++) {
+#ifdef FSK_FIXED_POINT
+        track_m[t] = (int64_t)mre * mre + (int64_t)mim * mim;
+        track_s[t] = (int64_t)sre * sre + (int64_t)sim * sim;
+#else
+        track_m[t] = sqrtf(mre * mre + mim * mim) * magscalar;
+        track_s[t] = sqrtf(sre * sre + sim * sim) * magscalar;
+#endif
+        if (t + 1 == nstarts)
+            break;
+
+        fsk_sample_t x_out = samples[t];
+        fsk_sample_t x_in = samples[t + bit_nsamples];
+        mre += twiddle_mul(x_in, fskp->dft_cos[im_in])
+            - twiddle_mul(x_out, fskp->dft_cos[im_out]);
+        mim -= twiddle_mul(x_in, fskp->dft_sin[im_in])
+            - twiddle_mul(x_out, fskp->dft_sin[im_out]);
+        sre += twiddle_mul(x_in, fskp->dft_cos[is_in])
+            - twiddle_mul(x_out, fskp->dft_cos[is_out]);
+        sim -= twiddle_mul(x_in, fskp->dft_sin[is_in])
+            - twiddle_mul(x_out, fskp->dft_sin[is_out]);
+        if ((im_in += km) >= n)
+            im_in -= n;
+        if ((is_in += ks) >= n)
+            is_in -= n;
+        if ((im_out += km) >= n)
+            im_out -= n;
+        if ((is_out += ks) >= n)
+            is_out -= n;
+    }
 }
 
+int
+fsk_track_bins(fsk_plan *fskp, const fsk_sample_t *samples, unsigned int nstarts,
+               unsigned int frame_nsamples, unsigned int n_bits)
+{
+    // must match the window length fsk_frame_analyze() will ask for
+    float samples_per_bit = (float)frame_nsamples / n_bits;
+    unsigned int bit_nsamples = (float)(samples_per_bit + 0.5f);
+    unsigned int k;
+
+    fsk_track_invalidate(fskp);
+    if (nstarts == 0)
+        return 0;
+
+    if (nstarts > fskp->track_size) {
+        int failed = 0;
+        for (k = 0; k < FSK_MAX_TONES; k++) {
+            fsk_bin_t *mag = realloc(fskp->track_mag[k], nstarts * sizeof(fsk_bin_t));
+            if (mag)
+                fskp->track_mag[k] = mag;
+            else
+                failed = 1;
+        }
+        if (failed)
+            return -1;
+        fskp->track_size = nstarts;
+    }
+
+    for (k = 0; k < fskp->ntones; k += 2)
+        track_tone_pair(fskp, samples, nstarts, bit_nsamples, k);
+
+    fskp->track_samples = samples;
+    fskp->track_nstarts = nstarts;
+    fskp->track_bit_nsamples = bit_nsamples;
+    return 0;
+}
@@ -26,6 +26,49 @@
 #include "fftw3.h"
 #endif
 
+#include <stdint.h>
+
+/*
+ * FSK_FIXED_POINT: decode straight from the int16 (Q15) input samples.
+ * The sample buffer stays int16, the Goertzel recurrence and the sliding-DFT
+ * tracker run on integers, and mark/space are decided by comparing squared
+ * magnitudes; only the per-bit magnitudes handed to the confidence estimate
+ * are converted to float.  The FFT is then only used by fsk_detect_carrier().
+ */
+// #define FSK_FIXED_POINT
+
+#ifdef FSK_FIXED_POINT
+typedef int16_t fsk_sample_t;   // Q15
+typedef int16_t fsk_twiddle_t;  // Q15
+typedef int64_t fsk_bin_t;      // squared bin magnitude, in sample units
+#else
+typedef float fsk_sample_t;
+typedef float fsk_twiddle_t;
+typedef float fsk_bin_t;        // bin magnitude, scaled by 2/bit_nsamples
+#endif
+
+/*
+ * Tone magnitude analyzer used by fsk_find_frame().  Both produce the
+ * magnitudes of the same bands (b_tones); the Goertzel analyzer just skips
+ * computing the remaining nbands-ntones bins.  The FFT plan is kept in
+ * either case because fsk_detect_carrier() needs the whole spectrum.
+ */
+enum fsk_analyzer
+{
+    FSK_ANALYZER_FFT = 0,
+    FSK_ANALYZER_GOERTZEL = 1,
+};
+
+#define FSK_ANALYZER_DEFAULT    FSK_ANALYZER_GOERTZEL
+
+/*
+ * A plan analyzes ntones tones, symbol value v being sent as tone v, so a
+ * frame symbol carries bits_per_symbol bits.  The BFSK plans of
+ * fsk_plan_new() have space and mark as tones 0 and 1.  In expect bits
+ * strings a fixed symbol is its value as a digit.
+ */
+#define FSK_MAX_TONES           4
+
 typedef struct fsk_plan fsk_plan;
 
 struct fsk_plan
@@ -34,6 +77,8 @@ struct fsk_plan
     float f_mark;
     float f_space;
     float filter_bw;
+    unsigned int ntones;
+    unsigned int bits_per_symbol;
 
 #ifdef USE_FFT
     int fftsize;
@@ -41,10 +86,27 @@ struct fsk_plan
     float band_width;
     unsigned int b_mark;
     unsigned int b_space;
+    unsigned int b_tones[FSK_MAX_TONES];
     fftwf_plan fftplan;
     float *fftin;
     fftwf_complex *fftout;
 #endif
+
+    enum fsk_analyzer analyzer;
+    // Goertzel recurrence coefficients 2*cos(2*pi*b/fftsize) for b_tones
+    float goertzel_coeff[FSK_MAX_TONES];
+#ifdef FSK_FIXED_POINT
+    int32_t goertzel_coeff_q14[FSK_MAX_TONES];
+#endif
+
+    // sliding-DFT bin tracker, see fsk_track_bins()
+    fsk_twiddle_t *dft_cos;         // cos(2*pi*i/fftsize), i < fftsize
+    fsk_twiddle_t *dft_sin;         // sin(2*pi*i/fftsize), i < fftsize
+    const fsk_sample_t *track_samples; // buffer the tracked bins belong to
+    unsigned int track_nstarts;     // number of valid window starts
+    unsigned int track_size;        // allocated length of track_mag[]
+    unsigned int track_bit_nsamples;
+    fsk_bin_t *track_mag[FSK_MAX_TONES]; // b_tones bins of window starting at t
 };
 
 fsk_plan *
@@ -55,12 +117,21 @@ fsk_plan_new(
     float filter_bw
 );
 
+/* f_tones[v] is the tone of symbol value v, ntones a power of 2 */
+fsk_plan *
+fsk_plan_new_tones(
+    float sample_rate,
+    const float *f_tones,
+    unsigned int ntones,
+    float filter_bw
+);
+
 void
 fsk_plan_destroy(fsk_plan *fskp);
 
 /* returns confidence value [0.0 to 1.0] */
 float
-fsk_find_frame(fsk_plan *fskp, float *samples, unsigned int frame_nsamples,
+fsk_find_frame(fsk_plan *fskp, fsk_sample_t *samples, unsigned int frame_nsamples,
                unsigned int try_first_sample,
                unsigned int try_max_nsamples,
                unsigned int try_step_nsamples,
@@ -71,13 +142,71 @@ fsk_find_frame(fsk_plan *fskp, float *samples, unsigned int frame_nsamples,
                unsigned int *frame_start_outp
 );
 
+/*
+ * fsk_find_frame() in pieces, for callers that split the trial offsets of
+ * one search across several tasks: fsk_find_frame_ntries() counts the trials
+ * of the scan, fsk_find_frame_try() runs trials [j_begin, j_end) of it into
+ * *best, and merging the parts' candidates in j order with
+ * fsk_frame_candidate_merge() yields exactly what fsk_find_frame() finds.
+ * Only the bin tracker and Goertzel analyzer are safe to run concurrently on
+ * one fsk_plan (the FFT analyzer shares fftin).
+ */
+typedef struct
+{
+    float confidence;
+    float ampl;
+    unsigned long long bits;
+    unsigned int frame_start;
+    int search_limit_hit;   // reached try_confidence_search_limit
+} fsk_frame_candidate;
+
+unsigned int
+fsk_find_frame_ntries(unsigned int try_first_sample,
+                      unsigned int try_max_nsamples,
+                      unsigned int try_step_nsamples);
+
+void
+fsk_frame_candidate_init(fsk_frame_candidate *cand);
+
+void
+fsk_find_frame_try(fsk_plan *fskp, fsk_sample_t *samples, unsigned int frame_nsamples,
+                   unsigned int try_first_sample,
+                   unsigned int try_max_nsamples,
+                   unsigned int try_step_nsamples,
+                   unsigned int j_begin, unsigned int j_end,
+                   float try_confidence_search_limit,
+                   const char *expect_bits_string,
+                   fsk_frame_candidate *best);
+
+void
+fsk_frame_candidate_merge(fsk_frame_candidate *best, const fsk_frame_candidate *part);
+
 int
-fsk_detect_carrier(fsk_plan *fskp, float *samples, unsigned int nsamples,
+fsk_detect_carrier(fsk_plan *fskp, fsk_sample_t *samples, unsigned int nsamples,
                    float min_mag_threshold);
 
 void
 fsk_set_tones_by_bandshift(fsk_plan *fskp, unsigned int b_mark, int b_shift);
 
+void
+fsk_set_analyzer(fsk_plan *fskp, enum fsk_analyzer analyzer);
+
+/*
+ * Precompute the tone magnitudes of every bit window starting in
+ * samples[0..nstarts), in one sliding pass over the samples.  Subsequent
+ * fsk_find_frame() calls on the same buffer (with the same frame_nsamples
+ * and n_bits) score each bit with a table lookup instead of a DFT, so every
+ * trial offset costs O(n_bits).  Must be called again whenever the buffer
+ * contents move.  Returns 0, or -1 if the table could not be allocated (the
+ * tracker is then disabled and bits are analyzed directly).
+ */
+int
+fsk_track_bins(fsk_plan *fskp, const fsk_sample_t *samples, unsigned int nstarts,
+               unsigned int frame_nsamples, unsigned int n_bits);
+
+void
+fsk_track_invalidate(fsk_plan *fskp);
+
 
 // FIXME move this?:
 // #define FSK_DEBUG
@@ -8,4 +8,38 @@
 // excluding line end character (LF)
 #define TAPEFILE_LINE_LENGTH        (29)
 
+/*
+ * Modem modes of the data on a tape. Every mode runs at 1200 baud, so the
+ * decoder keeps its bit clock when the mode changes.
+ */
+typedef enum {
+    MINIMODEM_MODE_1200 = 0,    /*!< Bell 202, 8N1, one character a frame */
+    MINIMODEM_MODE_4FSK = 1,    /*!< 4 tones, 2 bits a symbol, two characters a frame */
+} minimodem_mode_t;
+
+#define MINIMODEM_NMODES            (2)
+
+// 4-FSK tones of the symbol values 0..3 in Hz. 0 is the stop and idle tone,
+// the same as the Bell 202 mark, and the start symbol is 2, which Bell 202
+// never sends, so neither mode takes the other's frames for its own.
+#define MINIMODEM_4FSK_TONES        {1200.0f, 2200.0f, 3200.0f, 4200.0f}
+#define MINIMODEM_4FSK_START        (2)
+
+/*
+ * MINIMODEM_FIXED_8N1: build minimodem for the tape format only, 1200 baud
+ * frames of 1 start, 8 data and 1 stop symbol, decoded as ASCII. The frame
+ * length and nominal bit timing become constants, the other minimodem modes
+ * (rtty, tdd, same, callerid, uic, V.21) and their databits decoders are left
+ * out. The modes of minimodem_mode_t still work, they share the frame layout;
+ * a modem profile must keep baud=1200.
+ *
+ * Set by CONFIG_MINIMODEM_FIXED_8N1 (menuconfig, Minimodem), which also
+ * drops the other modes' sources from the build, or -DMINIMODEM_FIXED_8N1=ON
+ * of tools/minimodem_host.
+ */
+
+#define MINIMODEM_8N1_BAUD          (1200)
+// symbols fsk_find_frame() looks at: prev_stop, start, 8 data, stop
+#define MINIMODEM_8N1_FRAME_NBITS   (11)
+
 #endif //CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_MINIMODEM_CONFIG_H
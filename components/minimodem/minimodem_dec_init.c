@@ -7,21 +7,48 @@
 
 #include <unistd.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include "fsk.h"
 #include "databits.h"
+#include "frame_search.h"
+#include "tape_record.h"
 
 #include "minimodem_dec_init.h"
 
 static const char *TAG = "MINIMODEM_DECODER";
 
+#ifndef FSK_FIXED_POINT
 static float audio_sample_to_float(int16_t i);
+#endif
 
 static audio_element_err_t esp32_write_b(char *buf, int bytes, audio_element_handle_t self);
 
+static audio_element_err_t line_append(minimodem_decoder_struct *dec_str,
+                                       audio_element_handle_t self, const char *buf, size_t len);
+
+static void report_stats(minimodem_decoder_struct *dec_str);
+
+static size_t silence_nsamples(const minimodem_decoder_struct *dec_str,
+                               const fsk_sample_t *samples);
+
+static void decoder_set_mode(minimodem_decoder_struct *dec_str, minimodem_mode_t mode);
+
 audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_element_handle_t self);
 
-ssize_t samples_read(void *buf, size_t nframes, char *in_buf);
+static audio_element_err_t minimodem_decode_timed(minimodem_decoder_struct *dec_str,
+                                                  audio_element_handle_t self);
+
+ssize_t samples_read(fsk_sample_t *ring, size_t ring_size, size_t wpos, size_t nframes,
+                     char *in_buf, int16_t *decim_buf, minimodem_diversity *div,
+                     minimodem_agc *agc);
+
+static void decimator_init(void);
+
+static void diversity_reset(minimodem_diversity *div);
+static void agc_reset(minimodem_agc *agc);
+
+static float diversity_snr_db(const minimodem_diversity *div, int ch);
 //inline float audio_sample_to_float(int16_t i);
 
 static void
@@ -29,17 +56,17 @@ report_no_carrier(fsk_plan *fskp, unsigned int sample_rate,
                   float bfsk_data_rate, float frame_n_bits, unsigned int nframes_decoded,
                   size_t carrier_nsamples, float confidence_total, float amplitude_total);
 
-minimodem_decoder_struct *minimodem_receive_cfg();
-
 static int
 build_expect_bits_string(char *expect_bits_string, int bfsk_nstartbits,
                          int bfsk_n_data_bits, float bfsk_nstopbits, int invert_start_stop,
                          int use_expect_bits, unsigned long long expect_bits);
 
+#ifndef FSK_FIXED_POINT
 static float audio_sample_to_float(int16_t i)
 {
     return ((float)i) / (float)32768;
 }
+#endif
 
 static int build_expect_bits_string(char *expect_bits_string,
                                     int bfsk_nstartbits, int bfsk_n_data_bits, float bfsk_nstopbits,
@@ -95,7 +122,7 @@ audio_element_err_t minimodem_dec_buf(minimodem_decoder_struct *str, audio_eleme
                    buf_load - str->buf_part_pos);
             buf += buf_load - str->buf_part_pos;
             str->buf = str->buf_part;
-            int length = minimodem_decode(str, self);
+            int length = minimodem_decode_timed(str, self);
             if (length < 0) {
                 // return error
                 return length;
@@ -112,7 +139,7 @@ audio_element_err_t minimodem_dec_buf(minimodem_decoder_struct *str, audio_eleme
     size_t i;
     for (i = 0; i + buf_load <= len; i += buf_load) {
         str->buf = (char *)buf + i;
-        int length = minimodem_decode(str, self);
+        int length = minimodem_decode_timed(str, self);
         if (length < 0) {
             // return error
             return length;
@@ -127,10 +154,16 @@ audio_element_err_t minimodem_dec_buf(minimodem_decoder_struct *str, audio_eleme
 }
 
 minimodem_decoder_struct *minimodem_receive_cfg()
+{
+    const minimodem_profile_t profile = MINIMODEM_PROFILE_DEFAULT();
+    return minimodem_receive_cfg_profile(&profile);
+}
+
+minimodem_decoder_struct *minimodem_receive_cfg_profile(const minimodem_profile_t *profile)
 {
     float band_width = 0;
-    float bfsk_mark_f = 0;
-    float bfsk_space_f = 0;
+    float bfsk_mark_f = profile->mark;
+    float bfsk_space_f = profile->space;
     unsigned int bfsk_inverted_freqs = 0;
     int bfsk_nstartbits = -1;
     float bfsk_nstopbits = -1;
@@ -149,7 +182,7 @@ minimodem_decoder_struct *minimodem_receive_cfg()
     // fsk_confidence_threshold : signal-to-noise squelch control
     //
     // The minimum SNR-ish confidence level seen as "a signal".
-    float fsk_confidence_threshold = 1.5;
+    float fsk_confidence_threshold = profile->confidence_threshold;
 
     // fsk_confidence_search_limit : performance vs. quality
     //
@@ -158,7 +191,7 @@ minimodem_decoder_struct *minimodem_receive_cfg()
     // dramatic effect on peformance (high value yields low performance, but
     // higher decode quality, for noisy or hard-to-discern signals (Bell 103,
     // or skewed rates).
-    float fsk_confidence_search_limit = 2.3f;
+    float fsk_confidence_search_limit = profile->confidence_search_limit;
     // float fsk_confidence_search_limit = INFINITY;  /* for test */
 
     //sa_backend_t sa_backend = SA_BACKEND_SYSDEFAULT;
@@ -168,7 +201,7 @@ minimodem_decoder_struct *minimodem_receive_cfg()
 
     // if i2s_cfg.i2s_config.sample_rate = 48000;
     // then REAL sample rate = 48000*1.25 = 60000
-    sample_rate = 16000;
+    sample_rate = MINIMODEM_SAMPLE_RATE;
 
     int output_mode_binary = 0;
     int output_mode_raw_nbits = 0;
@@ -177,10 +210,17 @@ minimodem_decoder_struct *minimodem_receive_cfg()
     databits_decoder *bfsk_databits_decode;
 
     bfsk_databits_decode = databits_decode_ascii8;
-    char modem_mode[10] = "1200";
     // use "minimodem 1200 -t" to transmit data to device
 
     ////
+#ifdef MINIMODEM_FIXED_8N1
+    // profile->baud is checked to be MINIMODEM_8N1_BAUD
+    (void)output_mode_binary;
+    bfsk_data_rate = MINIMODEM_8N1_BAUD;
+    bfsk_n_data_bits = 8;
+#else
+    char modem_mode[16];
+    snprintf(modem_mode, sizeof(modem_mode), "%g", profile->baud);
     if (strncasecmp(modem_mode, "rtty", 5) == 0) {
         bfsk_databits_decode = databits_decode_baudot;
         bfsk_data_rate = 45.45;
@@ -242,6 +282,7 @@ minimodem_decoder_struct *minimodem_receive_cfg()
 
     if (output_mode_binary || output_mode_raw_nbits)
         bfsk_databits_decode = databits_decode_binary;
+#endif
 
     if (output_mode_raw_nbits) {
         bfsk_nstartbits = 0;
@@ -327,6 +368,17 @@ minimodem_decoder_struct *minimodem_receive_cfg()
         fprintf(stderr, "fsk_plan_new() failed\n");
         return NULL;
     }
+
+    // MINIMODEM_MODE_4FSK: the same frame and symbol rate, each data symbol
+    // carries 2 bits
+    const float tones_4fsk[] = MINIMODEM_4FSK_TONES;
+    fsk_plan *fskp_4fsk = fsk_plan_new_tones(sample_rate, tones_4fsk,
+                                             sizeof(tones_4fsk) / sizeof(tones_4fsk[0]), band_width);
+    if (!fskp_4fsk) {
+        fprintf(stderr, "fsk_plan_new_tones() failed\n");
+        fsk_plan_destroy(fskp);
+        return NULL;
+    }
     /*
      * Prepare the input sample buffer.  For 8-bit frames with prev/start/stop
      * we need 11 data-bits worth of samples, and we will scan through one bits
@@ -341,16 +393,26 @@ minimodem_decoder_struct *minimodem_receive_cfg()
     // FIXME EXPLAIN +1 goes with extra bit when scanning
     size_t samplebuf_size = ceilf(nsamples_per_bit) * (nbits + 1);
     samplebuf_size *= 2; // account for the half-buf filling method
-#define SAMPLE_BUF_DIVISOR 12
-#ifdef SAMPLE_BUF_DIVISOR
     // For performance, use a larger samplebuf_size than necessary
-    if (samplebuf_size < sample_rate / SAMPLE_BUF_DIVISOR)
-        samplebuf_size = sample_rate / SAMPLE_BUF_DIVISOR;
-#endif
-    float *samplebuf = heap_caps_malloc(samplebuf_size * sizeof(float), MALLOC_CAP_INTERNAL);
+    if (samplebuf_size < sample_rate / profile->sample_buf_divisor)
+        samplebuf_size = sample_rate / profile->sample_buf_divisor;
+    // twice the ring size: the upper half mirrors the lower one
+    fsk_sample_t *samplebuf = heap_caps_malloc(2 * samplebuf_size * sizeof(fsk_sample_t), MALLOC_CAP_INTERNAL);
+    if (samplebuf == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: samplebuf");
+        fsk_plan_destroy(fskp_4fsk);
+        fsk_plan_destroy(fskp);
+        return NULL;
+    }
     size_t samples_nvalid = 0;
     debug_log("samplebuf_size=%zu\n", samplebuf_size);
 
+#ifdef FSK_FIXED_POINT
+    const float silence_level = profile->silence_level * 32768.0f;
+#else
+    const float silence_level = profile->silence_level;
+#endif
+
     /*
      * Run the main loop
      */
@@ -404,6 +466,11 @@ minimodem_decoder_struct *minimodem_receive_cfg()
         expect_sync_string = expect_data_string;
     } debug_log("ess = '%s' (%lu)\n", expect_sync_string, strlen(expect_sync_string));
 
+    // prev_stop, start, 8 data symbols and stop
+    char expect_4fsk_string[16];
+    snprintf(expect_4fsk_string, sizeof(expect_4fsk_string), "0%cdddddddd0",
+             '0' + MINIMODEM_4FSK_START);
+
     //unsigned int expect_nsamples = nsamples_per_bit * expect_n_bits;
     float track_amplitude = 0.0;
     float peak_confidence = 0.0;
@@ -411,20 +478,40 @@ minimodem_decoder_struct *minimodem_receive_cfg()
     minimodem_decoder_struct *ret = heap_caps_malloc(sizeof(minimodem_decoder_struct), MALLOC_CAP_SPIRAM);
     if (ret == NULL) {
         ESP_LOGE(TAG, "Out of memory allocating: minimodem_decoder_struct");
+        free(samplebuf);
+        fsk_plan_destroy(fskp_4fsk);
+        fsk_plan_destroy(fskp);
         return NULL;
     }
-    const size_t buf_load = (samplebuf_size / 2) * 2 * sizeof(int16_t);
+    // one samples_read() worth of input frames
+    const size_t buf_load = (samplebuf_size / 2) * MINIMODEM_DECIMATION * 2 * sizeof(int16_t);
     char *buf_part = heap_caps_malloc(buf_load, MALLOC_CAP_INTERNAL);
     if (buf_part == NULL) {
         free(ret);
+        free(samplebuf);
+        fsk_plan_destroy(fskp_4fsk);
+        fsk_plan_destroy(fskp);
         ESP_LOGE(TAG, "Out of memory allocating: buf_part");
         return NULL;
     }
+    int16_t *decim_buf = heap_caps_calloc(MINIMODEM_DECIMATOR_TAPS - 1
+                                          + (samplebuf_size / 2) * MINIMODEM_DECIMATION,
+                                          sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    if (decim_buf == NULL) {
+        free(buf_part);
+        free(ret);
+        free(samplebuf);
+        fsk_plan_destroy(fskp_4fsk);
+        fsk_plan_destroy(fskp);
+        ESP_LOGE(TAG, "Out of memory allocating: decim_buf");
+        return NULL;
+    }
+    decimator_init();
     *ret =
         (minimodem_decoder_struct)
             {.advance = advance, .samplebuf_size = samplebuf_size,
-                .samplebuf = samplebuf, .samples_nvalid =
-            samples_nvalid,
+                .samplebuf = samplebuf, .samples_rpos = 0,
+                .samples_nvalid = samples_nvalid,
                 .carrier_autodetect_threshold =
                 carrier_autodetect_threshold, .sample_rate =
             sample_rate, .bfsk_data_rate =
@@ -437,6 +524,9 @@ minimodem_decoder_struct *minimodem_receive_cfg()
                 .expect_data_string = strdup(expect_data_string),
                 .expect_sync_string = strdup(expect_sync_string),
                 .fsk_confidence_threshold = fsk_confidence_threshold,
+                .analyze_nsteps = profile->analyze_nsteps,
+                .analyze_nsteps_fine = profile->analyze_nsteps_fine,
+                .silence_power = silence_level * silence_level,
                 .bfsk_n_data_bits = bfsk_n_data_bits,
                 .bfsk_nstartbits = bfsk_nstartbits,
                 .bfsk_nstopbits = bfsk_nstopbits, .bfsk_msb_first =
@@ -453,22 +543,166 @@ minimodem_decoder_struct *minimodem_receive_cfg()
             noconfidence, .bfsk_databits_decode =
             bfsk_databits_decode, .fskp = fskp,
                 .buf_part = buf_part, .buf_part_pos = 0,
-                .buf_load = buf_load
+                .buf_load = buf_load, .decim_buf = decim_buf,
+                .agc = {.max_gain = powf(10.0f, profile->agc_max_gain / 20.0f),
+                    .silence_power = profile->silence_level * profile->silence_level
+                        * 32768.0f * 32768.0f},
+                .modes = {
+                    [MINIMODEM_MODE_1200] = {.fskp = fskp,
+                        .expect_n_bits = expect_n_bits,
+                        .bfsk_n_data_bits = bfsk_n_data_bits,
+                        .chars_per_frame = 1},
+                    [MINIMODEM_MODE_4FSK] = {.fskp = fskp_4fsk,
+                        .expect_data_string = strdup(expect_4fsk_string),
+                        .expect_n_bits = strlen(expect_4fsk_string),
+                        .bfsk_n_data_bits = 16,
+                        .chars_per_frame = 2}},
+                .mode = MINIMODEM_MODE_1200, .nmodes_tried = 0,
+                .bfsk_chars_per_frame = 1,
+                .line_len = 0,
+                .bit_clock = {.nominal_nsamples_per_bit = nsamples_per_bit,
+                    .nsamples_per_bit = nsamples_per_bit},
+                .search_pool = NULL,
+                .stat_bytes_moved = 0, .stat_nsamples = 0, .stat_nskipped = 0,
+                .stat_decode_us = 0, .stat_nlines = 0,
+                .profile = *profile
             };
+    ret->modes[MINIMODEM_MODE_1200].expect_data_string = ret->expect_data_string;
+    ret->modes[MINIMODEM_MODE_1200].expect_sync_string = ret->expect_sync_string;
+    ret->modes[MINIMODEM_MODE_4FSK].expect_sync_string =
+        ret->modes[MINIMODEM_MODE_4FSK].expect_data_string;
+    diversity_reset(&ret->diversity);
+    agc_reset(&ret->agc);
     return ret;
 }
 
+static void decoder_set_mode(minimodem_decoder_struct *dec_str, minimodem_mode_t mode)
+{
+    const minimodem_decoder_mode *m = &dec_str->modes[mode];
+    dec_str->mode = mode;
+    dec_str->fskp = m->fskp;
+    dec_str->expect_data_string = m->expect_data_string;
+    dec_str->expect_sync_string = m->expect_sync_string;
+    dec_str->expect_n_bits = m->expect_n_bits;
+    dec_str->bfsk_n_data_bits = m->bfsk_n_data_bits;
+    dec_str->bfsk_chars_per_frame = m->chars_per_frame;
+}
+
+static void bit_clock_reset(minimodem_bit_clock *clock)
+{
+    clock->nsamples_per_bit = clock->nominal_nsamples_per_bit;
+    clock->phase = 0;
+    clock->locked = 0;
+    clock->nframes_on_time = 0;
+}
+
+void minimodem_receive_reset(minimodem_decoder_struct *str)
+{
+    str->advance = 0;
+    str->samples_rpos = 0;
+    str->samples_nvalid = 0;
+    str->carrier = 0;
+    str->carrier_band = -1;
+    str->track_amplitude = 0;
+    str->peak_confidence = 0;
+    str->nframes_decoded = 0;
+    str->carrier_nsamples = 0;
+    str->confidence_total = 0;
+    str->amplitude_total = 0;
+    str->noconfidence = 0;
+    for (int i = 0; i < MINIMODEM_NMODES; i++) {
+        fsk_track_invalidate(str->modes[i].fskp);
+    }
+    decoder_set_mode(str, MINIMODEM_MODE_1200);
+    str->nmodes_tried = 0;
+    str->buf_part_pos = 0;
+    memset(str->decim_buf, 0, (MINIMODEM_DECIMATOR_TAPS - 1) * sizeof(int16_t));
+    diversity_reset(&str->diversity);
+    agc_reset(&str->agc);
+    str->line_len = 0;
+    bit_clock_reset(&str->bit_clock);
+    str->stat_bytes_moved = 0;
+    str->stat_nsamples = 0;
+    str->stat_nskipped = 0;
+    str->stat_decode_us = 0;
+    str->stat_nlines = 0;
+}
+
+void minimodem_receive_destroy(minimodem_decoder_struct *str)
+{
+    if (str == NULL) {
+        return;
+    }
+    for (int i = 0; i < MINIMODEM_NMODES; i++) {
+        minimodem_decoder_mode *m = &str->modes[i];
+        if (m->expect_sync_string != m->expect_data_string) {
+            free(m->expect_sync_string);
+        }
+        free(m->expect_data_string);
+        fsk_plan_destroy(m->fskp);
+    }
+    free(str->samplebuf);
+    free(str->buf_part);
+    free(str->decim_buf);
+    free(str);
+}
+
+static void bit_clock_unlock(minimodem_bit_clock *clock)
+{
+    if (clock->locked) {
+        debug_log("### bit clock unlocked\n");
+    }
+    clock->locked = 0;
+    clock->nframes_on_time = 0;
+}
+
+/*
+ * Second order bit clock loop.  The frame search already realigns the phase
+ * on every frame; timing_error (found minus predicted frame start, in
+ * samples, positive when the frame came late) also nudges the bit period, so
+ * a tape running off speed stops showing up as a timing error at all.
+ */
+static void bit_clock_update(minimodem_bit_clock *clock, int timing_error,
+                             float frame_n_bits)
+{
+    // the prediction itself was clock->phase samples past the integer advance
+    float measured = timing_error - clock->phase;
+    float nsamples_per_bit = clock->nsamples_per_bit
+        + MINIMODEM_PLL_GAIN * measured / frame_n_bits;
+    const float max_dev = clock->nominal_nsamples_per_bit * MINIMODEM_PLL_MAX_DEVIATION;
+    if (nsamples_per_bit > clock->nominal_nsamples_per_bit + max_dev)
+        nsamples_per_bit = clock->nominal_nsamples_per_bit + max_dev;
+    else if (nsamples_per_bit < clock->nominal_nsamples_per_bit - max_dev)
+        nsamples_per_bit = clock->nominal_nsamples_per_bit - max_dev;
+    clock->nsamples_per_bit = nsamples_per_bit;
+
+    // While locked, a frame found at the edge of the window may really be
+    // further off still.  While acquiring, the fine search steps are about
+    // as wide as the window.
+    int on_time = clock->locked ? abs(timing_error) < MINIMODEM_PLL_LOCK_WINDOW
+                                : abs(timing_error) <= MINIMODEM_PLL_LOCK_WINDOW;
+    if (on_time) {
+        if (++clock->nframes_on_time >= MINIMODEM_PLL_LOCK_FRAMES && !clock->locked) {
+            clock->locked = 1;
+            debug_log("### bit clock locked, %.3f samples/bit\n", nsamples_per_bit);
+        }
+    } else {
+        bit_clock_unlock(clock);
+    }
+}
+
 // see https://github.com/kamalmostafa/minimodem/blob/bb2f34cf5148f101563aa926e201d306edbacbd3/src/minimodem.c#L1137
 audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_element_handle_t self)
 {
+#ifdef MINIMODEM_FIXED_8N1
+    const float nsamples_per_bit = (float)MINIMODEM_SAMPLE_RATE / MINIMODEM_8N1_BAUD;
+    const unsigned int expect_n_bits = MINIMODEM_8N1_FRAME_NBITS;
+#else
     const float nsamples_per_bit = dec_str->sample_rate / dec_str->bfsk_data_rate;
+    const unsigned int expect_n_bits = dec_str->expect_n_bits;
+#endif
     const int quiet_mode = 1;
-    const unsigned int bfsk_frame_n_bits = dec_str->bfsk_n_data_bits
-        + dec_str->bfsk_nstartbits + dec_str->bfsk_nstopbits;
-    const float frame_n_bits = bfsk_frame_n_bits;
-    const unsigned int frame_nsamples = nsamples_per_bit * frame_n_bits + 0.5f;
     const float fsk_frame_overscan = 0.5;
-    const unsigned int expect_nsamples = nsamples_per_bit * dec_str->expect_n_bits;
     const unsigned int nsamples_overscan = nsamples_per_bit * fsk_frame_overscan + 0.5f;
     int is_read = 0;
     size_t wr_bytes = 0;
@@ -478,10 +712,22 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
 
         debug_log("dec_str->advance=%u\n", dec_str->advance);
 
-        /* Shift the samples in samplebuf by 'dec_str->advance' samples */
+        // in symbols, the same in every mode
+        const unsigned int bits_per_symbol = dec_str->fskp->bits_per_symbol;
+#ifdef MINIMODEM_FIXED_8N1
+        // without the prev_stop symbol
+        const unsigned int bfsk_frame_n_bits = MINIMODEM_8N1_FRAME_NBITS - 1;
+#else
+        const unsigned int bfsk_frame_n_bits = dec_str->bfsk_n_data_bits / bits_per_symbol
+            + dec_str->bfsk_nstartbits + dec_str->bfsk_nstopbits;
+#endif
+        const float frame_n_bits = bfsk_frame_n_bits;
+
+        /* Consume 'dec_str->advance' samples from the samplebuf ring */
         assert(dec_str->advance <= dec_str->samplebuf_size);
         if (dec_str->advance == dec_str->samplebuf_size) {
             dec_str->samples_nvalid = 0;
+            dec_str->samples_rpos = 0;
             dec_str->advance = 0;
         }
         if (dec_str->advance) {
@@ -489,15 +735,16 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
                 fprintf(stderr, "ERROR\n");
                 return 0;
             }
-            memmove(dec_str->samplebuf, dec_str->samplebuf + dec_str->advance,
-                    (dec_str->samplebuf_size - dec_str->advance)
-                        * sizeof(float));
+            dec_str->samples_rpos += dec_str->advance;
+            if (dec_str->samples_rpos >= dec_str->samplebuf_size)
+                dec_str->samples_rpos -= dec_str->samplebuf_size;
             dec_str->samples_nvalid -= dec_str->advance;
         }
 
         if (dec_str->samples_nvalid < dec_str->samplebuf_size / 2) {
-            float *samples_readptr = dec_str->samplebuf
-                + dec_str->samples_nvalid;
+            size_t wpos = dec_str->samples_rpos + dec_str->samples_nvalid;
+            if (wpos >= dec_str->samplebuf_size)
+                wpos -= dec_str->samplebuf_size;
             size_t read_nsamples = dec_str->samplebuf_size / 2;
             /* Read more samples into samplebuf (fill it) */
             assert(read_nsamples > 0);
@@ -505,9 +752,11 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
                 dec_str->samples_nvalid + read_nsamples
                     <= dec_str->samplebuf_size);
             ssize_t r;
-            r = samples_read(samples_readptr, read_nsamples, dec_str->buf);
-            debug_log("samples_read(dec_str->samplebuf+%td, n=%zu) returns %zd\n",
-                      samples_readptr - dec_str->samplebuf, read_nsamples, r);
+            r = samples_read(dec_str->samplebuf, dec_str->samplebuf_size,
+                             wpos, read_nsamples, dec_str->buf, dec_str->decim_buf,
+                             &dec_str->diversity, &dec_str->agc);
+            debug_log("samples_read(dec_str->samplebuf+%zu, n=%zu) returns %zd\n",
+                      wpos, read_nsamples, r);
             if (r < 0) {
                 fprintf(stderr, "samples_read: error\n");
                 //ret = -1;//float dec_str->fsk_confidence_threshold
@@ -516,13 +765,30 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
             }
             is_read = 1;
             dec_str->samples_nvalid += r;
+            // every sample is written twice, once into the mirror
+            dec_str->stat_bytes_moved += r * sizeof(fsk_sample_t);
+            dec_str->stat_nsamples += r;
+            report_stats(dec_str);
         }
+        fsk_sample_t *samples = dec_str->samplebuf + dec_str->samples_rpos;
 
         if (dec_str->samples_nvalid == 0) {
             fprintf(stderr, "ERROR\n");
             return 0;
         }
 
+        /* Without carrier, skip silence (tape stopped, between recordings)
+         * in large strides instead of searching it for frames */
+        if (!dec_str->carrier && dec_str->silence_power > 0.0f) {
+            size_t nsilent = silence_nsamples(dec_str, samples);
+            if (nsilent > 0) {
+                dec_str->advance = nsilent;
+                dec_str->stat_nskipped += nsilent;
+                debug_log("@ SILENCE dec_str->advance=%u\n", dec_str->advance);
+                continue;
+            }
+        }
+
         /* Auto-detect carrier frequency */
         //static int dec_str->carrier_band = -1;
         if (dec_str->carrier_autodetect_threshold > 0.0f
@@ -534,7 +800,7 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
             for (i = 0; i + nsamples_per_scan <= dec_str->samples_nvalid; i +=
                                                                               nsamples_per_scan) {
                 dec_str->carrier_band = fsk_detect_carrier(dec_str->fskp,
-                                                           dec_str->samplebuf + i, nsamples_per_scan,
+                                                           samples + i, nsamples_per_scan,
                                                            dec_str->carrier_autodetect_threshold);
                 if (dec_str->carrier_band >= 0) {
                     fprintf(stderr, "ERROR\n");
@@ -580,6 +846,11 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
 
         debug_log("--------------------------\n");
 
+        // the frame geometry follows the tracked bit period
+        const float clock_nsamples_per_bit = dec_str->bit_clock.nsamples_per_bit;
+        const unsigned int frame_nsamples = clock_nsamples_per_bit * frame_n_bits + 0.5f;
+        const unsigned int expect_nsamples = clock_nsamples_per_bit * expect_n_bits;
+
         if (dec_str->samples_nvalid < expect_nsamples) {
             fprintf(stderr, "ERROR\n");
             return 0;
@@ -589,21 +860,25 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
         // serves two purposes
         // 1. avoids finding a non-optimal first frame
         // 2. allows us to track slightly slow signals
+        // 3. while the bit clock is locked, only the few samples around the
+        //    predicted frame start are searched
         unsigned int try_max_nsamples;
-        if (dec_str->carrier)
+        if (dec_str->bit_clock.locked)
+            try_max_nsamples = MINIMODEM_PLL_LOCK_WINDOW + 1;
+        else if (dec_str->carrier)
             try_max_nsamples = nsamples_per_bit * 0.75f + 0.5f;
         else
             try_max_nsamples = nsamples_per_bit;
         try_max_nsamples += nsamples_overscan;
 
-        // FSK_ANALYZE_NSTEPS Try 3 frame positions across the try_max_nsamples
-        // range.  Using a larger nsteps allows for more accurate tracking of
-        // fast/slow signals (at decreased performance).  Note also
-        // FSK_ANALYZE_NSTEPS_FINE below, which refines the frame
+        // analyze_nsteps: Try 3 (by default) frame positions across the
+        // try_max_nsamples range.  Using a larger nsteps allows for more
+        // accurate tracking of fast/slow signals (at decreased performance).
+        // Note also
+        // analyze_nsteps_fine below, which refines the frame
         // position upon first acquiring carrier, or if confidence falls.
-#define FSK_ANALYZE_NSTEPS        3
-        unsigned int try_step_nsamples = try_max_nsamples / FSK_ANALYZE_NSTEPS;
-        if (try_step_nsamples == 0)
+        unsigned int try_step_nsamples = try_max_nsamples / dec_str->analyze_nsteps;
+        if (try_step_nsamples == 0 || dec_str->bit_clock.locked)
             try_step_nsamples = 1;
 
         float confidence, amplitude;
@@ -617,8 +892,25 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
 
         try_confidence_search_limit = dec_str->fsk_confidence_search_limit;
         try_first_sample = dec_str->carrier ? nsamples_overscan : 0;
+        // the locked window is small enough to search exhaustively, which
+        // gives the bit clock a true timing error instead of the first
+        // good enough offset
+        if (dec_str->bit_clock.locked)
+            try_confidence_search_limit = INFINITY;
+
+        // Compute the mark/space magnitudes of every bit window the searches
+        // below can touch once, so each trial offset (coarse or fine) is
+        // scored by table lookups instead of re-analyzing overlapping bits.
+        unsigned int track_nstarts = try_max_nsamples + expect_nsamples;
+        unsigned int bit_nsamples = (float)expect_nsamples / expect_n_bits + 0.5f;
+        if (track_nstarts + bit_nsamples > dec_str->samplebuf_size)
+            track_nstarts = dec_str->samplebuf_size - bit_nsamples;
+        if (fsk_track_bins(dec_str->fskp, samples, track_nstarts,
+                           expect_nsamples, expect_n_bits) != 0) {
+            debug_log("fsk_track_bins failed, analyzing bits directly\n");
+        }
 
-        confidence = fsk_find_frame(dec_str->fskp, dec_str->samplebuf,
+        confidence = frame_search_find_frame(dec_str->search_pool, dec_str->fskp, samples,
                                     expect_nsamples, try_first_sample, try_max_nsamples,
                                     try_step_nsamples, try_confidence_search_limit,
                                     dec_str->carrier ?
@@ -634,7 +926,13 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
                 " ... do_refine_frame rescan (confidence %.3f << %.3f peak)\n",
                 confidence, dec_str->peak_confidence);
             dec_str->peak_confidence = 0;
+            // (while the bit clock is locked the search is already exhaustive
+            // over its narrow window, so there is nothing to refine)
         }
+        // until the bit clock locks, every frame gets the fine search so
+        // the timing errors fed to the clock are accurate
+        if (dec_str->carrier && !dec_str->bit_clock.locked)
+            do_refine_frame = 1;
 
         // no-confidence if amplitude drops abruptly to < 25% of the
         // dec_str->track_amplitude, which follows amplitude with hysteresis
@@ -644,7 +942,27 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
 
 #define FSK_MAX_NOCONFIDENCE_BITS    20
 
-        if (confidence <= dec_str->fsk_confidence_threshold) {
+        // a mode tried while scanning, rather than the one of the last
+        // header, must be clearly there: hiss next to a Bell 202 frame can
+        // pass for a weak 4-FSK one
+        const float confidence_threshold = dec_str->nmodes_tried ?
+                                           dec_str->fsk_confidence_search_limit :
+                                           dec_str->fsk_confidence_threshold;
+
+        if (confidence <= confidence_threshold) {
+
+            bit_clock_unlock(&dec_str->bit_clock);
+
+            // without carrier, look for the frames of the other modes in
+            // the same samples before moving on, then go back to the first
+            if (!dec_str->carrier) {
+                decoder_set_mode(dec_str, (dec_str->mode + 1) % MINIMODEM_NMODES);
+                if (++dec_str->nmodes_tried < MINIMODEM_NMODES) {
+                    dec_str->advance = 0;
+                    continue;
+                }
+            }
+            dec_str->nmodes_tried = 0;
 
             // FIXME: explain
             if (++dec_str->noconfidence > FSK_MAX_NOCONFIDENCE_BITS) {
@@ -663,6 +981,7 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
                     dec_str->amplitude_total = 0;
                     dec_str->nframes_decoded = 0;
                     dec_str->track_amplitude = 0.0;
+                    bit_clock_reset(&dec_str->bit_clock);
 
                     //if (rx_one)
                     //	break;
@@ -680,6 +999,9 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
         // Add a frame's worth of samples to the sample count
         dec_str->carrier_nsamples += frame_nsamples;
 
+        const int had_carrier = dec_str->carrier;
+        int fine_search = dec_str->bit_clock.locked;
+
         if (dec_str->carrier) {
 
             // If we already had carrier, adjust sample count +start -overscan
@@ -707,7 +1029,9 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
                 fprintf(stderr, "###\n");
 
             dec_str->carrier = 1;
+#ifndef MINIMODEM_FIXED_8N1
             dec_str->bfsk_databits_decode(0, 0, 0, 0); // reset the frame processor
+#endif
 
             do_refine_frame = 1;
             debug_log(" ... do_refine_frame rescan (acquired carrier)\n");
@@ -715,20 +1039,27 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
 
         if (do_refine_frame) {
             if (confidence < INFINITY && try_step_nsamples > 1) {
-                // FSK_ANALYZE_NSTEPS_FINE:
+                // analyze_nsteps_fine (8 by default):
                 // Scan again, but try harder to find the best frame.
                 // Since we found a valid confidence frame in the "sloppy"
                 // fsk_find_frame() call already, we're sure to find one at
                 // least as good this time.
-#define FSK_ANALYZE_NSTEPS_FINE        8
-                try_step_nsamples = try_max_nsamples / FSK_ANALYZE_NSTEPS_FINE;
+                try_step_nsamples = try_max_nsamples / dec_str->analyze_nsteps_fine;
                 if (try_step_nsamples == 0)
                     try_step_nsamples = 1;
+                // FSK_ANALYZE_FINE_EXHAUSTIVE: with the bin tracker every
+                // offset is just n_bits lookups, so the refine pass can afford
+                // to try every single sample position.
+// #define FSK_ANALYZE_FINE_EXHAUSTIVE
+#ifdef FSK_ANALYZE_FINE_EXHAUSTIVE
+                if (dec_str->fskp->track_samples)
+                    try_step_nsamples = 1;
+#endif
                 try_confidence_search_limit = INFINITY;
                 float confidence2, amplitude2;
                 unsigned long long bits2;
                 unsigned int frame_start_sample2;
-                confidence2 = fsk_find_frame(dec_str->fskp, dec_str->samplebuf,
+                confidence2 = frame_search_find_frame(dec_str->search_pool, dec_str->fskp, samples,
                                              expect_nsamples, try_first_sample, try_max_nsamples,
                                              try_step_nsamples, try_confidence_search_limit,
                                              dec_str->carrier ?
@@ -740,9 +1071,16 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
                     amplitude = amplitude2;
                     frame_start_sample = frame_start_sample2;
                 }
+                fine_search = 1;
             }
         }
 
+        // how far off the frame was from where the bit clock predicted it
+        if (had_carrier && fine_search)
+            bit_clock_update(&dec_str->bit_clock,
+                             (int)frame_start_sample - (int)try_first_sample,
+                             frame_n_bits);
+
         dec_str->track_amplitude = (dec_str->track_amplitude + amplitude) / 2;
         if (dec_str->peak_confidence < confidence)
             dec_str->peak_confidence = confidence;
@@ -754,22 +1092,42 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
         dec_str->amplitude_total += amplitude;
         dec_str->nframes_decoded++;
         dec_str->noconfidence = 0;
+        dec_str->nmodes_tried = 0;
 
         // dec_str->advance the sample stream forward past the junk before the
         // frame starts (frame_start_sample), and then past decoded frame
         // (see also NOTE about frame_n_bits and dec_str->expect_n_bits)...
         // But actually dec_str->advance just a bit less than that to allow
         // for tracking slightly fast signals, hence - nsamples_overscan.
-        dec_str->advance = frame_start_sample + frame_nsamples
-            - nsamples_overscan;
+        // The fractional part is remembered in bit_clock.phase: the next
+        // frame is predicted at nsamples_overscan + phase.
+        float exact_advance = frame_start_sample
+            + clock_nsamples_per_bit * frame_n_bits - nsamples_overscan;
+        dec_str->advance = exact_advance + 0.5f;
+        dec_str->bit_clock.phase = exact_advance - dec_str->advance;
 
         debug_log("@ nsamples_per_bit=%.3f n_data_bits=%u "
                   " frame_start=%u dec_str->advance=%u\n", nsamples_per_bit,
                   dec_str->bfsk_n_data_bits, frame_start_sample, dec_str->advance);
 
+#ifdef MINIMODEM_FIXED_8N1
+        // chop off the prev_stop and start symbols and the stop symbol
+        bits = (bits >> (2 * bits_per_symbol)) & ((1ULL << dec_str->bfsk_n_data_bits) - 1);
+        // 4-FSK data symbols are Gray coded, neighbouring tones differ in
+        // one bit
+        if (bits_per_symbol == 2)
+            bits ^= (bits >> 1) & 0x5555555555555555ULL;
+
+        // ASCII, a byte per character
+        char dataoutbuf[8];
+        unsigned int dataout_nbytes;
+        for (dataout_nbytes = 0; dataout_nbytes < dec_str->bfsk_chars_per_frame; dataout_nbytes++) {
+            dataoutbuf[dataout_nbytes] = bits >> (8 * dataout_nbytes);
+        }
+#else
         // chop off the prev_stop bit
         if (dec_str->bfsk_nstopbits != 0.0f)
-            bits = bits >> 1;
+            bits = bits >> bits_per_symbol;
 
         /*
          * Send the raw data frame bits to the backend frame processor
@@ -777,17 +1135,23 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
          */
 
         // chop off framing bits
-        bits = bit_window(bits, dec_str->bfsk_nstartbits,
+        bits = bit_window(bits, dec_str->bfsk_nstartbits * bits_per_symbol,
                           dec_str->bfsk_n_data_bits);
+        // 4-FSK data symbols are Gray coded, neighbouring tones differ in
+        // one bit
+        if (bits_per_symbol == 2)
+            bits ^= (bits >> 1) & 0x5555555555555555ULL;
         if (dec_str->bfsk_msb_first) {
             bits = bit_reverse(bits, dec_str->bfsk_n_data_bits);
         } debug_log("Input: %08x%08x - Databits: %u - Shift: %i\n",
                     (unsigned int)(bits >> 32), (unsigned int)bits,
                     dec_str->bfsk_n_data_bits, dec_str->bfsk_nstartbits);
 
-        unsigned int dataout_size = 4096;
-        char dataoutbuf[4096];
+        // a frame decodes to a single character with the ascii and baudot
+        // decoders, per bfsk_n_data_bits / bfsk_chars_per_frame bits
+        char dataoutbuf[8];
         unsigned int dataout_nbytes = 0;
+        const unsigned int char_n_bits = dec_str->bfsk_n_data_bits / dec_str->bfsk_chars_per_frame;
 
         // suppress printing of dec_str->bfsk_sync_byte bytes
         if (dec_str->bfsk_do_rx_sync) {
@@ -796,30 +1160,86 @@ audio_element_err_t minimodem_decode(minimodem_decoder_struct *dec_str, audio_el
             }
         }
 
-        dataout_nbytes += dec_str->bfsk_databits_decode(
-            dataoutbuf + dataout_nbytes, dataout_size - dataout_nbytes,
-            bits, (int)dec_str->bfsk_n_data_bits);
+        for (unsigned int c = 0; c < dec_str->bfsk_chars_per_frame; c++) {
+            dataout_nbytes += dec_str->bfsk_databits_decode(
+                dataoutbuf + dataout_nbytes, sizeof(dataoutbuf) - dataout_nbytes,
+                bit_window(bits, c * char_n_bits, char_n_bits), char_n_bits);
+        }
+#endif
 
         if (dataout_nbytes == 0) {
             continue;
         }
 
         /*
-         * Print the output buffer to stdout
+         * Add to the current line, which is written out once complete
          */
         // https://github.com/kamalmostafa/minimodem/blob/bb2f34cf5148f101563aa926e201d306edbacbd3/src/minimodem.c#L1451
 //		if (write(1, dataoutbuf, dataout_nbytes) < 0)
 //			perror("write");
-        audio_element_err_t ret = esp32_write_b(dataoutbuf, dataout_nbytes, self);
+        audio_element_err_t ret = line_append(dec_str, self, dataoutbuf, dataout_nbytes);
         if (ret < 0) {
             // return error code
             return ret;
         }
-        wr_bytes += dataout_nbytes;
+        wr_bytes += ret;
+    }
+    return wr_bytes;
+}
+
+/**
+ * Append decoded characters to the current line, writing the line out with
+ * its '\n' when it is complete. CRs are dropped. A tape header line switches
+ * to its modem mode instead of being written out.
+ * @return bytes written out or a negative audio_element_err_t
+ */
+static audio_element_err_t line_append(minimodem_decoder_struct *dec_str,
+                                       audio_element_handle_t self, const char *buf, size_t len)
+{
+    audio_element_err_t wr_bytes = 0;
+    for (size_t i = 0; i < len; i++) {
+        char ch = buf[i];
+        if (ch == '\r') {
+            continue;
+        }
+        dec_str->line[dec_str->line_len++] = ch;
+        if (ch == '\n') {
+            minimodem_mode_t mode;
+            dec_str->line[dec_str->line_len - 1] = '\0';
+            const int header = tape_record_parse_header(dec_str->line, &mode) == ESP_OK;
+            dec_str->line[dec_str->line_len - 1] = '\n';
+            if (header) {
+                if (mode != dec_str->mode) {
+                    ESP_LOGI(TAG, "tape header: modem mode %d", mode);
+                    decoder_set_mode(dec_str, mode);
+                }
+                dec_str->line_len = 0;
+                continue;
+            }
+            audio_element_err_t ret = esp32_write_b(dec_str->line, dec_str->line_len, self);
+            dec_str->line_len = 0;
+            if (ret < 0) {
+                return ret;
+            }
+            wr_bytes += ret;
+            dec_str->stat_nlines++;
+        } else if (dec_str->line_len >= MINIMODEM_LINE_MAX_LENGTH - 1) {
+            // no room left for the '\n', this is not a record
+            dec_str->line_len = 0;
+        }
     }
     return wr_bytes;
 }
 
+static audio_element_err_t minimodem_decode_timed(minimodem_decoder_struct *dec_str,
+                                                  audio_element_handle_t self)
+{
+    int64_t start_us = esp_timer_get_time();
+    audio_element_err_t ret = minimodem_decode(dec_str, self);
+    dec_str->stat_decode_us += esp_timer_get_time() - start_us;
+    return ret;
+}
+
 static audio_element_err_t esp32_write_b(char *buf, int bytes, audio_element_handle_t self)
 {
     audio_element_err_t ret = audio_element_output(self, buf, bytes);
@@ -829,25 +1249,310 @@ static audio_element_err_t esp32_write_b(char *buf, int bytes, audio_element_han
     return ret;
 }
 
-// input is 16bit Little endian stereo (S16LE)
-// and output is float mono
-ssize_t samples_read(void *buf, size_t nframes, char *in_buf)
+// Seconds of decoded audio between two decoder stats reports
+#define MINIMODEM_STATS_INTERVAL_SECONDS 10
+
+static void report_stats(minimodem_decoder_struct *dec_str)
 {
-    typedef int16_t __attribute((__may_alias__)) int16_t_m_a;
-    int16_t_m_a *tmp_buf = (int16_t_m_a *)in_buf;
-    //const int val = (nframes * 2 * sizeof(int16_t));
+    const size_t interval_nsamples = dec_str->sample_rate * MINIMODEM_STATS_INTERVAL_SECONDS;
+    if (dec_str->stat_nsamples < interval_nsamples)
+        return;
+    const float seconds = (float)dec_str->stat_nsamples / dec_str->sample_rate;
+    ESP_LOGI(TAG, "samplebuf bytes moved/s=%.0f",
+             (double)(dec_str->stat_bytes_moved / seconds));
+    const minimodem_diversity *div = &dec_str->diversity;
+    ESP_LOGI(TAG, "track snr L=%.1f dB R=%.1f dB, %s",
+             (double)diversity_snr_db(div, 0), (double)diversity_snr_db(div, 1),
+             div->track < 0 ? "mixed" : div->track == 0 ? "left only" : "right only");
+    minimodem_agc *agc = &dec_str->agc;
+    if (agc->stat_nchunks && agc->max_gain > 1.0f)
+        ESP_LOGI(TAG, "agc gain=%.1f dB (%.1f..%.1f dB)",
+                 (double)(20.0f * log10f(agc->stat_gain_sum / agc->stat_nchunks)),
+                 (double)(20.0f * log10f(agc->stat_gain_min)),
+                 (double)(20.0f * log10f(agc->stat_gain_max)));
+    agc->stat_gain_sum = 0;
+    agc->stat_gain_min = INFINITY;
+    agc->stat_gain_max = 0;
+    agc->stat_nchunks = 0;
+    if (dec_str->stat_nskipped)
+        ESP_LOGI(TAG, "skipped as silence=%.0f%%",
+                 (double)(100.0f * dec_str->stat_nskipped / dec_str->stat_nsamples));
+    if (dec_str->stat_nlines)
+        ESP_LOGI(TAG, "decode time/line=%lld us (%u lines)",
+                 (long long)(dec_str->stat_decode_us / dec_str->stat_nlines),
+                 dec_str->stat_nlines);
+    dec_str->stat_bytes_moved = 0;
+    dec_str->stat_nsamples = 0;
+    dec_str->stat_nskipped = 0;
+    dec_str->stat_decode_us = 0;
+    dec_str->stat_nlines = 0;
+}
+
+// Samples at the start of the window that can be skipped as silence, whole
+// MINIMODEM_SILENCE_CHUNKs. A chunk's power is taken about its mean, so the
+// DC offset of the ADC does not count. Half a chunk before the first loud
+// one is kept, so the frame search starts just ahead of the leader tone.
+// Silence leaves the AGC gain as it is (see agc_run()), so the limit is
+// that of the input times the current gain.
+static size_t silence_nsamples(const minimodem_decoder_struct *dec_str,
+                               const fsk_sample_t *samples)
+{
+    const size_t nchunks = dec_str->samples_nvalid / MINIMODEM_SILENCE_CHUNK;
+    const float gain = dec_str->agc.gain / 256.0f;
+    const float limit = dec_str->silence_power * MINIMODEM_SILENCE_CHUNK * gain * gain;
+    size_t c;
+    for (c = 0; c < nchunks; c++) {
+        const fsk_sample_t *x = samples + c * MINIMODEM_SILENCE_CHUNK;
+        float sum = 0, sum_sq = 0;
+        for (int i = 0; i < MINIMODEM_SILENCE_CHUNK; i++) {
+            sum += x[i];
+            sum_sq += (float)x[i] * x[i];
+        }
+        if (sum_sq - sum * sum / MINIMODEM_SILENCE_CHUNK >= limit)
+            break;
+    }
+    return c > 0 ? c * MINIMODEM_SILENCE_CHUNK - MINIMODEM_SILENCE_CHUNK / 2 : 0;
+}
+
+// Q15 low-pass FIR of the decimator, shared by all decoder instances
+static int16_t decim_coeffs[MINIMODEM_DECIMATOR_TAPS];
+
+// Hamming windowed sinc with a cutoff of 0.4 / MINIMODEM_DECIMATION cycles
+// per input sample, 0.8 * output Nyquist (6.4 kHz at 48 kHz in): flat over
+// the FSK tones, and everything that would alias onto them is well in the
+// stop band.  The taps are normalized to unity DC gain.
+static void decimator_init(void)
+{
+    const float fc = 0.4f / MINIMODEM_DECIMATION;   // cycles per input sample
+    const float mid = (MINIMODEM_DECIMATOR_TAPS - 1) / 2.0f;
+    float h[MINIMODEM_DECIMATOR_TAPS];
+    float sum = 0;
+    int i;
+    for (i = 0; i < MINIMODEM_DECIMATOR_TAPS; i++) {
+        float x = i - mid;
+        float w = 0.54f - 0.46f * cosf(2.0f * (float)M_PI * i / (MINIMODEM_DECIMATOR_TAPS - 1));
+        h[i] = w * (x == 0 ? 2.0f * fc : sinf(2.0f * (float)M_PI * fc * x) / ((float)M_PI * x));
+        sum += h[i];
+    }
+    for (i = 0; i < MINIMODEM_DECIMATOR_TAPS; i++)
+        decim_coeffs[i] = lrintf(h[i] / sum * 32768.0f);
+}
+
+static void diversity_reset(minimodem_diversity *div)
+{
+    *div = (minimodem_diversity) {.track = -1, .weight = {1 << 14, 1 << 14}};
+}
+
+// output signal to noise ratio of the downmix with weights w
+static float diversity_combined_snr(const float signal[2], const float noise[2], float cross,
+                                    const float w[2])
+{
+    float s = w[0] * w[0] * signal[0] + w[1] * w[1] * signal[1] + 2.0f * w[0] * w[1] * cross;
+    float n = w[0] * w[0] * noise[0] + w[1] * w[1] * noise[1];
+    return s > 0.0f ? s / n : 0.0f;
+}
+
+// Fold the sums of a block of nframes (the second difference sums of
+// nframes - 2) into the track statistics and choose the downmix for the
+// next block. The tracks carry the same signal plus their own hiss, so the
+// covariance is what their signals share. The hiss is taken as white: the
+// second difference passes 6 times its power, but at most 1.5% of a 4.2 kHz
+// tone at 48 kHz. Of maximal-ratio weights (in phase tracks add up) and
+// either track alone (an azimuth error puts the tracks out of phase and
+// mixing them cancels tones), the one with the best output SNR is used.
+static void diversity_update(minimodem_diversity *div, size_t nframes, const int64_t sum[2],
+                             const int64_t sum_sq[2], int64_t sum_lr, const int64_t diff_sq[2])
+{
+    const float k = MINIMODEM_DIVERSITY_SMOOTHING;
+    float signal[2];
+    float noise[2];
+    int ch;
+
+    if (nframes < 3)
+        return;
+    for (ch = 0; ch < 2; ch++) {
+        float mean = (float)sum[ch] / nframes;
+        float power = (float)sum_sq[ch] / nframes - mean * mean;
+        div->mean[ch] += k * (mean - div->mean[ch]);
+        div->power[ch] += k * (power - div->power[ch]);
+        div->noise[ch] += k * ((float)diff_sq[ch] / (nframes - 2) / 6.0f - div->noise[ch]);
+        // at least the rounding noise of the samples
+        noise[ch] = div->noise[ch] > 1.0f ? div->noise[ch] : 1.0f;
+        signal[ch] = div->power[ch] > noise[ch] ? div->power[ch] - noise[ch] : 0.0f;
+    }
+    float cross = (float)sum_lr / nframes - (float)sum[0] / nframes * sum[1] / nframes;
+    div->cross += k * (cross - div->cross);
+
+    if (signal[0] < noise[0] * MINIMODEM_DIVERSITY_MIN_SNR
+        && signal[1] < noise[1] * MINIMODEM_DIVERSITY_MIN_SNR) {
+        // hiss only, whose level either track alone would raise; the
+        // statistics keep running, a weak track needs them most then
+        div->track = -1;
+        div->weight[0] = 1 << 14;
+        div->weight[1] = 1 << 14;
+        return;
+    }
+
+    // candidates: maximal ratio, left only, right only. Tracks of opposite
+    // polarity come out worse mixed than alone.
+    const float w[3][2] = {
+        {sqrtf(signal[0]) / noise[0], sqrtf(signal[1]) / noise[1]},
+        {1.0f, 0.0f},
+        {0.0f, 1.0f},
+    };
+    float snr[3];
+    int best = 0;
+    for (int c = 0; c < 3; c++) {
+        snr[c] = diversity_combined_snr(signal, noise, div->cross, w[c]);
+        if (snr[c] > snr[best])
+            best = c;
+    }
+    // switching between the tracks shifts the signal's phase, which costs
+    // a frame, so only for a clearly better choice
+    const int current = div->track + 1;
+    if (snr[best] < snr[current] * MINIMODEM_DIVERSITY_HYSTERESIS)
+        best = current;
+    div->track = best - 1;
+
+    const float norm = fabsf(w[best][0]) + fabsf(w[best][1]);
+    div->weight[0] = lrintf(w[best][0] / norm * 32768.0f);
+    div->weight[1] = lrintf(w[best][1] / norm * 32768.0f);
+}
 
+// signal to noise ratio of a track within the decimator's pass band
+static float diversity_snr_db(const minimodem_diversity *div, int ch)
+{
+    // the hiss estimate covers the whole input band, the decimator keeps
+    // 2 * 0.4 / MINIMODEM_DECIMATION of it
+    float noise = (div->noise[ch] > 1.0f ? div->noise[ch] : 1.0f) * (0.8f / MINIMODEM_DECIMATION);
+    // at least the rounding noise of the samples, like the noise: hiss only
+    // gives a low or negative SNR rather than none
+    float signal = div->power[ch] - div->noise[ch] > 1.0f ? div->power[ch] - div->noise[ch] : 1.0f;
+    return 10.0f * log10f(signal / noise);
+}
+
+static void agc_reset(minimodem_agc *agc)
+{
+    // the first chunk that is not silence sets the level
+    agc->level = 0;
+    agc->gain = 1 << 8;
+    agc->stat_gain_sum = 0;
+    agc->stat_gain_min = INFINITY;
+    agc->stat_gain_max = 0;
+    agc->stat_nchunks = 0;
+}
+
+// Track the level of n decimated samples and return the Q8 gain for them.
+// The level follows a louder chunk at once and a quieter one with
+// MINIMODEM_AGC_RELEASE_S, so the gain drops before the chunk could clip and
+// a frame sees it change by a few percent at most. It never goes below 1:
+// what the AGC is for is a quiet deck, a loud one is leveled at the ADC.
+// Silence leaves the gain as it is: switching it for hiss at the silence
+// level would turn the hiss into something like frames, and the gain is
+// right when the tape starts again.
+static int32_t agc_run(minimodem_agc *agc, const int32_t *x, size_t n)
+{
+    const float target = MINIMODEM_AGC_TARGET * 32768.0f;
+    const float release = (float)n / (MINIMODEM_SAMPLE_RATE * MINIMODEM_AGC_RELEASE_S);
+    int64_t sum = 0, sum_sq = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += x[i];
+        sum_sq += (int64_t)x[i] * x[i];
+    }
+    // about the mean, so the DC offset of the ADC does not count
+    const float power = ((float)sum_sq - (float)sum * sum / n) / n;
+    if (power < agc->silence_power)
+        return agc->gain;
+    const float rms = sqrtf(power);
+    if (rms > agc->level)
+        agc->level = rms;
+    else
+        agc->level += release * (rms - agc->level);
+    float gain = agc->level < target ? target / agc->level : 1.0f;
+    if (gain > agc->max_gain)
+        gain = agc->max_gain;
+    agc->gain = lrintf(gain * 256.0f);
+
+    agc->stat_gain_sum += gain;
+    if (gain < agc->stat_gain_min)
+        agc->stat_gain_min = gain;
+    if (gain > agc->stat_gain_max)
+        agc->stat_gain_max = gain;
+    agc->stat_nchunks++;
+    return agc->gain;
+}
 
-    //if (val != (nframes * 2 * sizeof(int16_t))) {
-    //	fprintf(stderr, "samples_read error!\n");
-    //	exit(-1);
-    //	return -1;
-    //}
-    float *out_fl = buf;
-    for (size_t i = 0; i < nframes; ++i) {
-        out_fl[i] = audio_sample_to_float(
-            ((int32_t)tmp_buf[i * 2] + tmp_buf[i * 2 + 1]) / 2);
+// input is 16bit Little endian stereo (S16LE) at MINIMODEM_DECIMATION times
+// the decoder rate, nframes * MINIMODEM_DECIMATION frames of it. The tracks
+// are mixed with the weights div chose from the previous blocks, the output
+// is leveled by agc in chunks of MINIMODEM_AGC_CHUNK.
+// Output is nframes of mono fsk_sample_t (float, or int16 with
+// FSK_FIXED_POINT), written into the mirrored samplebuf ring starting at wpos.
+ssize_t samples_read(fsk_sample_t *ring, size_t ring_size, size_t wpos, size_t nframes,
+                     char *in_buf, int16_t *decim_buf, minimodem_diversity *div,
+                     minimodem_agc *agc)
+{
+    typedef int16_t __attribute((__may_alias__)) int16_t_m_a;
+    int16_t_m_a *tmp_buf = (int16_t_m_a *)in_buf;
+    const size_t in_nframes = nframes * MINIMODEM_DECIMATION;
+    int16_t *mono = decim_buf + MINIMODEM_DECIMATOR_TAPS - 1;
+    const int32_t w_l = div->weight[0];
+    const int32_t w_r = div->weight[1];
+    int64_t sum[2] = {0, 0}, sum_sq[2] = {0, 0}, sum_lr = 0, diff_sq[2] = {0, 0};
+
+    // downmix after the history kept from the previous call; the weights
+    // add up to at most 1.0, so the mix cannot overflow
+    for (size_t i = 0; i < in_nframes; ++i) {
+        const int32_t l = tmp_buf[i * 2];
+        const int32_t r = tmp_buf[i * 2 + 1];
+        mono[i] = (w_l * l + w_r * r + (1 << 14)) >> 15;
+        sum[0] += l;
+        sum[1] += r;
+        sum_sq[0] += l * l;
+        sum_sq[1] += r * r;
+        sum_lr += l * r;
+        if (i >= 2) {
+            const int32_t d_l = l - 2 * tmp_buf[(i - 1) * 2] + tmp_buf[(i - 2) * 2];
+            const int32_t d_r = r - 2 * tmp_buf[(i - 1) * 2 + 1] + tmp_buf[(i - 2) * 2 + 1];
+            diff_sq[0] += (int64_t)d_l * d_l;
+            diff_sq[1] += (int64_t)d_r * d_r;
+        }
+    }
+    diversity_update(div, in_nframes, sum, sum_sq, sum_lr, diff_sq);
+
+    // only every MINIMODEM_DECIMATION-th output of the filter is computed
+    const int16_t *x = decim_buf;
+    int32_t chunk[MINIMODEM_AGC_CHUNK];
+    for (size_t i = 0; i < nframes; i += MINIMODEM_AGC_CHUNK) {
+        const size_t n = nframes - i < MINIMODEM_AGC_CHUNK ? nframes - i : MINIMODEM_AGC_CHUNK;
+        for (size_t j = 0; j < n; ++j, x += MINIMODEM_DECIMATION) {
+            int32_t acc = 1 << 14;
+            for (int k = 0; k < MINIMODEM_DECIMATOR_TAPS; k++)
+                acc += (int32_t)decim_coeffs[k] * x[k];
+            chunk[j] = acc >> 15;
+        }
+        // the gain is at most 40 dB (see minimodem_profile_check()), so
+        // this cannot overflow
+        const int32_t gain = agc_run(agc, chunk, n);
+        for (size_t j = 0; j < n; ++j) {
+            int32_t acc = (chunk[j] * gain + (1 << 7)) >> 8;
+            if (acc > INT16_MAX)
+                acc = INT16_MAX;
+            else if (acc < INT16_MIN)
+                acc = INT16_MIN;
+#ifdef FSK_FIXED_POINT
+            fsk_sample_t sample = acc;
+#else
+            fsk_sample_t sample = audio_sample_to_float(acc);
+#endif
+            ring[wpos] = sample;
+            ring[wpos + ring_size] = sample;
+            if (++wpos == ring_size)
+                wpos = 0;
+        }
     }
+    memmove(decim_buf, decim_buf + in_nframes,
+            (MINIMODEM_DECIMATOR_TAPS - 1) * sizeof(int16_t));
 
     return nframes;
 }
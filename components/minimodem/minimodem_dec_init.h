@@ -4,6 +4,8 @@
 #include "databits.h"
 #include "audio_element.h"
 #include "fsk.h"
+#include "minimodem_config.h"
+#include "minimodem_profile.h"
 #include <stddef.h>
 #include <ctype.h>
 
@@ -11,11 +13,105 @@
 extern "C" {
 #endif
 
+// The decoder takes the i2s stream directly (S16LE stereo at
+// MINIMODEM_DECIMATION * sample_rate) and downmixes and decimates it
+// itself with a MINIMODEM_DECIMATOR_TAPS low-pass FIR.
+#define MINIMODEM_SAMPLE_RATE       (16000)
+#define MINIMODEM_DECIMATION        (3)
+#define MINIMODEM_DECIMATOR_TAPS    (24)
+
+// Diversity combining of the two tape tracks (see diversity_update()):
+// fraction of each samples_read() block folded into the track statistics,
+// how much better another choice of tracks must be to replace the current
+// one, and the signal to hiss ratio (over the whole input band) below which
+// a track counts as hiss only
+#define MINIMODEM_DIVERSITY_SMOOTHING   (0.25f)
+#define MINIMODEM_DIVERSITY_HYSTERESIS  (1.25f)
+#define MINIMODEM_DIVERSITY_MIN_SNR     (0.25f)
+
+// Automatic gain control of the decimated signal (see agc_run()): samples
+// per gain step, the RMS level (fraction of full scale) quieter signals are
+// brought up to and the time constant of the gain rising after the level
+// falls. The gain falls at once, before a louder chunk is written out.
+#define MINIMODEM_AGC_CHUNK         (32)
+#define MINIMODEM_AGC_TARGET        (0.125f)
+#define MINIMODEM_AGC_RELEASE_S     (0.5f)
+
+// Bit clock tracking (see bit_clock_update()): fraction of each frame's
+// timing error folded into the bit period, allowed bit period deviation from
+// nominal, +-samples searched around the predicted frame start while locked,
+// and consecutive on-time frames needed to lock
+#define MINIMODEM_PLL_GAIN              (0.25f)
+#define MINIMODEM_PLL_MAX_DEVIATION     (0.08f)
+#define MINIMODEM_PLL_LOCK_WINDOW       (2)
+#define MINIMODEM_PLL_LOCK_FRAMES       (4)
+
+// Without carrier the window is first checked in chunks of
+// MINIMODEM_SILENCE_CHUNK samples, and the chunks quieter than the profile's
+// silence_level (at the input, before the AGC) are skipped without a frame
+// search
+#define MINIMODEM_SILENCE_CHUNK     (32)
+
+// Decoded bytes are collected into lines of up to MINIMODEM_LINE_MAX_LENGTH - 1
+// characters (a tape record is 29) and each line is written out with its '\n'
+// in a single audio_element_output() call. Longer lines are dropped.
+#define MINIMODEM_LINE_MAX_LENGTH   (64)
+
+// Statistics of the left [0] and right [1] track, in input sample units
+typedef struct
+{
+    float mean[2];
+    float power[2];         // mean square about the mean, signal plus noise
+    float noise[2];         // hiss, from the energy above the FSK tones
+    float cross;            // covariance of the tracks, what their signals share
+    int track;              // -1 mixes both tracks, else the only one used
+    int32_t weight[2];      // Q15 downmix weights, |left| + |right| = 1.0
+} minimodem_diversity;
+
+// Gain control state, in int16 sample units
+typedef struct
+{
+    float level;            // tracked RMS of the decimated signal
+    float max_gain;         // from the profile, 1 keeps the signal as recorded
+    float silence_power;    // mean square below which the level is left as it is
+    int32_t gain;           // Q8 gain of the last chunk
+    // gain applied since the last stats report, per chunk
+    float stat_gain_sum;
+    float stat_gain_min;
+    float stat_gain_max;
+    size_t stat_nchunks;
+} minimodem_agc;
+
+typedef struct
+{
+    float nominal_nsamples_per_bit;
+    float nsamples_per_bit;         // tracked bit period
+    float phase;                    // fractional samples of the last advance
+    int locked;
+    unsigned int nframes_on_time;   // consecutive frames within the window
+} minimodem_bit_clock;
+
+// What changes with the modem mode, see minimodem_config.h. Frames have the
+// same number of symbols in every mode, bfsk_n_data_bits is in bits.
+typedef struct
+{
+    fsk_plan *fskp;
+    char *expect_data_string;
+    char *expect_sync_string;
+    unsigned int expect_n_bits;
+    unsigned int bfsk_n_data_bits;
+    unsigned int chars_per_frame;
+} minimodem_decoder_mode;
+
 typedef struct
 {
     unsigned int advance;
+    // samplebuf is a ring of samplebuf_size samples, mirrored into
+    // samplebuf[samplebuf_size .. 2*samplebuf_size) so that any window
+    // starting at samples_rpos can be read contiguously
     size_t samplebuf_size;
-    float *samplebuf;
+    fsk_sample_t *samplebuf;
+    size_t samples_rpos;
     size_t samples_nvalid;
     float carrier_autodetect_threshold;
     unsigned int sample_rate;
@@ -27,7 +123,14 @@ typedef struct
     char *expect_data_string;
     char *expect_sync_string;
     float fsk_confidence_threshold;
+    // frame offsets tried per bit by the search and its refining pass
+    unsigned int analyze_nsteps;
+    unsigned int analyze_nsteps_fine;
+    // mean square of a sample below which a chunk counts as silence, in
+    // fsk_sample_t units; 0 never skips
+    float silence_power;
     unsigned int bfsk_n_data_bits;
+    unsigned int bfsk_chars_per_frame;
     int bfsk_nstartbits;
     float bfsk_nstopbits;
     int bfsk_msb_first;
@@ -44,15 +147,51 @@ typedef struct
     unsigned int noconfidence;
     databits_decoder *bfsk_databits_decode;
     fsk_plan *fskp;
+    // the settings above of each mode, the current one is copied to them
+    minimodem_decoder_mode modes[MINIMODEM_NMODES];
+    minimodem_mode_t mode;
+    // modes tried on the current samples without finding carrier
+    unsigned int nmodes_tried;
     char *buf;
     char *buf_part;
     size_t buf_part_pos;
     // size of buf_part
     size_t buf_load;
+    // decimator input: MINIMODEM_DECIMATOR_TAPS - 1 mono samples of history
+    // followed by the downmixed frames of the current buf
+    int16_t *decim_buf;
+    minimodem_diversity diversity;
+    minimodem_agc agc;
+    // the line being assembled, see MINIMODEM_LINE_MAX_LENGTH
+    char line[MINIMODEM_LINE_MAX_LENGTH];
+    size_t line_len;
+    minimodem_bit_clock bit_clock;
+    // optional helper tasks for fsk_find_frame(), see frame_search.h
+    struct frame_search_pool *search_pool;
+    // bytes of sample data copied inside samplebuf and samples consumed,
+    // since the last stats report
+    size_t stat_bytes_moved;
+    size_t stat_nsamples;
+    // of those, skipped as silence
+    size_t stat_nskipped;
+    // time spent in minimodem_decode() and lines it output, likewise
+    int64_t stat_decode_us;
+    unsigned int stat_nlines;
+    // what the decoder was configured with
+    minimodem_profile_t profile;
 } minimodem_decoder_struct;
 
+// minimodem_receive_cfg_profile() with MINIMODEM_PROFILE_DEFAULT()
 minimodem_decoder_struct *minimodem_receive_cfg();
 
+minimodem_decoder_struct *minimodem_receive_cfg_profile(const minimodem_profile_t *profile);
+
+// back to the state of a new decoder, for the next stream
+void minimodem_receive_reset(minimodem_decoder_struct *str);
+
+// frees str and everything it holds, the search_pool is the caller's
+void minimodem_receive_destroy(minimodem_decoder_struct *str);
+
 audio_element_err_t minimodem_dec_buf(minimodem_decoder_struct *str,
                          audio_element_handle_t self, unsigned char *buf, size_t len);
 
@@ -4,6 +4,7 @@
 #include "audio_mem.h"
 #include "audio_element.h"
 #include "minimodem_decoder.h"
+#include "frame_search.h"
 #include "audio_error.h"
 
 static const char *TAG = "MINIMODEM_DECODER";
@@ -11,11 +12,20 @@ static const char *TAG = "MINIMODEM_DECODER";
 typedef struct minimodem_encoder
 {
     minimodem_decoder_struct *minimodem_str;
+    // minimodem_str was made by minimodem_decoder_init()
+    bool own_str;
 } minimodem_decoder_t;
 
 static esp_err_t _minimodem_decoder_destroy(audio_element_handle_t self)
 {
     minimodem_decoder_t *minimodem_dec = (minimodem_decoder_t *)audio_element_getdata(self);
+    if (minimodem_dec->minimodem_str) {
+        frame_search_pool_destroy(minimodem_dec->minimodem_str->search_pool);
+        minimodem_dec->minimodem_str->search_pool = NULL;
+        if (minimodem_dec->own_str) {
+            minimodem_receive_destroy(minimodem_dec->minimodem_str);
+        }
+    }
     audio_free(minimodem_dec);
     return ESP_OK;
 }
@@ -74,11 +84,28 @@ audio_element_handle_t minimodem_decoder_init(minimodem_decoder_cfg_t *config)
         cfg.out_rb_size = config->out_rb_size;
 
         minimodem_dec->minimodem_str = config->minimodem_str;
+        if (minimodem_dec->minimodem_str == NULL) {
+            minimodem_dec->minimodem_str = minimodem_receive_cfg();
+            minimodem_dec->own_str = true;
+        }
+        if (minimodem_dec->minimodem_str && config->search_workers > 0) {
+            frame_search_cfg_t search_cfg = {
+                .nworkers = config->search_workers,
+                .task_stack = config->search_task_stack,
+                .task_core = config->search_task_core,
+                .task_prio = config->search_task_prio,
+            };
+            // without the pool every search just runs on the decoder task
+            minimodem_dec->minimodem_str->search_pool = frame_search_pool_create(&search_cfg);
+        }
     }
 
     cfg.tag = "minimodem_dec";
     audio_element_handle_t el = audio_element_init(&cfg);
     AUDIO_MEM_CHECK(TAG, el, {
+        if (minimodem_dec->own_str) {
+            minimodem_receive_destroy(minimodem_dec->minimodem_str);
+        }
         audio_free(minimodem_dec);
         return NULL;
     });
@@ -86,3 +113,17 @@ audio_element_handle_t minimodem_decoder_init(minimodem_decoder_cfg_t *config)
     ESP_LOGD(TAG, "minimodem_encoder_init");
     return el;
 }
+
+esp_err_t minimodem_decoder_get_bit_clock(audio_element_handle_t self, bool *locked, float *speed_ratio)
+{
+    minimodem_decoder_t *minimodem_dec = (minimodem_decoder_t *)audio_element_getdata(self);
+    if (minimodem_dec == NULL || minimodem_dec->minimodem_str == NULL) {
+        return ESP_FAIL;
+    }
+    // read unsynchronized from the decoder task: a torn value only affects
+    // one status report
+    minimodem_bit_clock *clock = &minimodem_dec->minimodem_str->bit_clock;
+    *locked = clock->locked != 0;
+    *speed_ratio = clock->nominal_nsamples_per_bit / clock->nsamples_per_bit;
+    return ESP_OK;
+}
@@ -20,13 +20,25 @@ typedef struct
     int task_core;      /*!< Task running in core (0 or 1) */
     int task_prio;      /*!< Task priority (based on freeRTOS priority) */
     bool stack_in_ext;   /*!< Try to allocate stack in external memory */
-    minimodem_decoder_struct *minimodem_str;  /*!< Minimodem struct */
+    minimodem_decoder_struct *minimodem_str;  /*!< Minimodem struct, stays the caller's; NULL for an own minimodem_receive_cfg() one */
+    int search_workers;     /*!< Extra frame search tasks, 0 to search on the decoder task only */
+    int search_task_stack;  /*!< Frame search task stack size */
+    int search_task_core;   /*!< Core of the first frame search task, further ones alternate */
+    int search_task_prio;   /*!< Frame search task priority (based on freeRTOS priority) */
 } minimodem_decoder_cfg_t;
 
-#define MINIMODEM_DECODER_TASK_STACK          (8 * 1024)
+// no per-frame output buffer on the stack any more, lines are assembled in
+// minimodem_decoder_struct
+#define MINIMODEM_DECODER_TASK_STACK          (5 * 1024)
 #define MINIMODEM_DECODER_TASK_CORE           (0)
 #define MINIMODEM_DECODER_TASK_PRIO           (5)
 #define MINIMODEM_DECODER_RINGBUFFER_SIZE     (8 * 1024)
+// the frame search helpers default to the playback core, below the playback
+// elements' priority so they only take otherwise idle time there
+#define MINIMODEM_SEARCH_WORKERS              (0)
+#define MINIMODEM_SEARCH_TASK_STACK           (3 * 1024)
+#define MINIMODEM_SEARCH_TASK_CORE            (1)
+#define MINIMODEM_SEARCH_TASK_PRIO            (5)
 
 #define DEFAULT_MINIMODEM_DECODER_CONFIG() {\
     .out_rb_size        = MINIMODEM_DECODER_RINGBUFFER_SIZE,\
@@ -34,7 +46,11 @@ typedef struct
     .task_core          = MINIMODEM_DECODER_TASK_CORE,\
     .task_prio          = MINIMODEM_DECODER_TASK_PRIO,\
     .stack_in_ext       = false,\
-    .minimodem_str      = minimodem_receive_cfg(), \
+    .minimodem_str      = NULL,\
+    .search_workers     = MINIMODEM_SEARCH_WORKERS,\
+    .search_task_stack  = MINIMODEM_SEARCH_TASK_STACK,\
+    .search_task_core   = MINIMODEM_SEARCH_TASK_CORE,\
+    .search_task_prio   = MINIMODEM_SEARCH_TASK_PRIO,\
 }
 
 /**
@@ -46,6 +62,18 @@ typedef struct
  */
 audio_element_handle_t minimodem_decoder_init(minimodem_decoder_cfg_t *config);
 
+/**
+ * @brief      Get the state of the decoder's bit clock
+ *
+ * @param      self         The minimodem decoder element
+ * @param      locked       Set to true while the bit clock is locked to the carrier
+ * @param      speed_ratio  Set to the tracked tape speed relative to nominal
+ *                          (below 1.0 when the tape runs slow)
+ *
+ * @return     ESP_OK or ESP_FAIL if the element has no decoder state
+ */
+esp_err_t minimodem_decoder_get_bit_clock(audio_element_handle_t self, bool *locked, float *speed_ratio);
+
 #ifdef __cplusplus
 }
 #endif
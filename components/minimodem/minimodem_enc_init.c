@@ -39,6 +39,7 @@
 
 #include "audio_element.h"
 #include "minimodem_enc_init.h"
+#include "tape_record.h"
 
 
 static size_t fsk_transmit_frame(unsigned int bits, unsigned int n_data_bits,
@@ -48,6 +49,9 @@ static size_t fsk_transmit_frame(unsigned int bits, unsigned int n_data_bits,
 
 static size_t fsk_transmit_char(minimodem_struct *s, audio_element_handle_t self, char buf);
 
+static size_t fsk_transmit_symbols(minimodem_struct *s, audio_element_handle_t self,
+		unsigned int bits, size_t bit_nsamples);
+
 
 /*
  * rudimentary BFSK transmitter
@@ -95,6 +99,53 @@ static size_t fsk_transmit_frame(unsigned int bits, unsigned int n_data_bits,
     return out_len;
 }
 
+/*
+ * 4-FSK frame: the start symbol, n_data_bits / bits_per_symbol Gray coded
+ * data symbols, least significant first, and the stop symbol 0
+ */
+static size_t fsk_transmit_symbols(minimodem_struct *s, audio_element_handle_t self,
+		unsigned int bits, size_t bit_nsamples) {
+    const unsigned int mask = (1u << s->bits_per_symbol) - 1;
+    size_t out_len = simpleaudio_tone(s->tones[MINIMODEM_4FSK_START],
+                                      bit_nsamples * s->bfsk_nstartbits, self, s->sample_rate);
+    if (out_len == 0) {
+        return 0;
+    }
+    for (int i = 0; i < s->n_data_bits; i += s->bits_per_symbol) {
+        unsigned int symbol = (bits >> i) & mask;
+        symbol ^= symbol >> 1;
+        size_t audio_len = simpleaudio_tone(s->tones[symbol], bit_nsamples, self, s->sample_rate);
+        if (audio_len == 0) {
+            return 0;
+        }
+        out_len += audio_len;
+    }
+    size_t audio_len = simpleaudio_tone(s->tones[0], bit_nsamples * s->bfsk_nstopbits,
+                                        self, s->sample_rate);
+    if (audio_len == 0) {
+        return 0;
+    }
+    return out_len + audio_len;
+}
+
+/*
+ * Send chars_per_frame characters of buf in a frame, an odd last one
+ * padded with a CR, which the decoder drops
+ */
+static size_t fsk_transmit_chars(minimodem_struct *s, audio_element_handle_t self,
+                                 const char *buf, size_t len)
+{
+    const size_t bit_nsamples = s->sample_rate / s->data_rate + 0.5f;
+    const int char_n_bits = s->n_data_bits / s->chars_per_frame;
+    unsigned int bits = 0;
+    for (int c = 0; c < s->chars_per_frame; c++) {
+        unsigned int char_bits[2];
+        s->encode(char_bits, c < len ? buf[c] : '\r');
+        bits |= char_bits[0] << (c * char_n_bits);
+    }
+    return fsk_transmit_symbols(s, self, bits, bit_nsamples);
+}
+
 static size_t fsk_transmit_char(minimodem_struct *s, audio_element_handle_t self,
                                 char buf)
 {
@@ -158,16 +209,34 @@ size_t fsk_transmit_buf(minimodem_struct *s, audio_element_handle_t self,
     size_t out_len = 0;
     int pause_seconds = 0;
 
-    // check for pause record
+    // check for pause record, binary records are never one
     // 0001A_03_b3488ae07e_000M_0481
-    if (buf[23] == 'M') {
+    if (buf[0] != TAPE_RECORD_MARKER && buf[23] == 'M') {
         sscanf(buf + 20, "%03dM_%*04d\n", &pause_seconds);
     }
 
     if (pause_seconds > 0) {
+        const size_t bit_nsamples = s->sample_rate / s->data_rate + 0.5f;
+        const size_t leader_nsamples = s->pause_leader_bits * bit_nsamples;
         for (int i = 0; i < pause_seconds; ++i) {
-            // produce 1 second of silence
-            size_t audio_len = simpleaudio_tone(0, s->sample_rate, self, s->sample_rate);
+            // produce 1 second of silence, the leader takes the end of the last
+            size_t nsamples = s->sample_rate - (i == pause_seconds - 1 ? leader_nsamples : 0);
+            size_t audio_len = simpleaudio_tone(0, nsamples, self, s->sample_rate);
+            if (audio_len == 0) {
+                return 0;
+            }
+            out_len += audio_len;
+        }
+        if (leader_nsamples > 0) {
+            size_t audio_len = simpleaudio_tone(s->bfsk_mark_f, leader_nsamples, self, s->sample_rate);
+            if (audio_len == 0) {
+                return 0;
+            }
+            out_len += audio_len;
+        }
+    } else if (s->chars_per_frame > 1) {
+        for (size_t i = 0; i < len; i += s->chars_per_frame) {
+            size_t audio_len = fsk_transmit_chars(s, self, buf + i, len - i);
             if (audio_len == 0) {
                 return 0;
             }
@@ -186,13 +255,31 @@ size_t fsk_transmit_buf(minimodem_struct *s, audio_element_handle_t self,
     return out_len;
 }
 
+uint32_t fsk_transmit_line_ms(const minimodem_struct *s)
+{
+    const int chars_per_frame = s->chars_per_frame > 0 ? s->chars_per_frame : 1;
+    const int bits_per_symbol = s->bits_per_symbol > 0 ? s->bits_per_symbol : 1;
+    const float frame_nbits = s->bfsk_nstartbits + s->n_data_bits / bits_per_symbol
+                              + s->bfsk_nstopbits;
+    const int nframes = (TAPEFILE_LINE_LENGTH + chars_per_frame) / chars_per_frame;
+    return frame_nbits * nframes * 1000 / s->data_rate;
+}
 
 minimodem_struct minimodem_transmit_cfg(void) {
-	char *modem_mode = NULL;
+	return minimodem_transmit_cfg_mode(MINIMODEM_MODE_1200);
+}
+
+minimodem_struct minimodem_transmit_cfg_mode(minimodem_mode_t mode) {
+	const minimodem_profile_t profile = MINIMODEM_PROFILE_DEFAULT();
+	return minimodem_transmit_cfg_profile(mode, &profile);
+}
+
+minimodem_struct minimodem_transmit_cfg_profile(minimodem_mode_t mode, const minimodem_profile_t *profile) {
+	char modem_mode[16];
 	int TX_mode = 1;
 	float band_width = 0;
-	float bfsk_mark_f = 0;
-	float bfsk_space_f = 0;
+	float bfsk_mark_f = profile->mark;
+	float bfsk_space_f = profile->space;
 	unsigned int bfsk_inverted_freqs = 0;
 	int bfsk_nstartbits = -1;
 	float bfsk_nstopbits = -1;
@@ -203,8 +290,8 @@ minimodem_struct minimodem_transmit_cfg(void) {
 	int invert_start_stop = 0;
 	int autodetect_shift;
 	float carrier_autodetect_threshold = 0.0;
-	float fsk_confidence_threshold = 1.5;
-	float fsk_confidence_search_limit = 2.3f;
+	float fsk_confidence_threshold = profile->confidence_threshold;
+	float fsk_confidence_search_limit = profile->confidence_search_limit;
 	unsigned int sample_rate;
 	float tx_amplitude = 1.0;
 	unsigned int tx_sin_table_len = 4096;
@@ -231,7 +318,7 @@ minimodem_struct minimodem_transmit_cfg(void) {
 	 callerid       Bell202 CID 1200 bps
 	 uic{-train,-ground}       UIC-751-3 Train/Ground 600 bps
 	 */
-	modem_mode = "1200";
+	snprintf(modem_mode, sizeof(modem_mode), "%g", profile->baud);
 
 	/*
 	 -R, --samplerate {rate}
@@ -246,6 +333,14 @@ minimodem_struct minimodem_transmit_cfg(void) {
 
 	minimodem_struct mm = { .sample_rate = 0 }; // return this if error
 
+#ifdef MINIMODEM_FIXED_8N1
+	// profile->baud is checked to be MINIMODEM_8N1_BAUD
+	(void)modem_mode;
+	(void)TX_mode;
+	(void)carrier_autodetect_threshold;
+	bfsk_data_rate = MINIMODEM_8N1_BAUD;
+	bfsk_n_data_bits = 8;
+#else
 	if (strncasecmp(modem_mode, "rtty", 5) == 0) {
 		//bfsk_databits_decode = databits_decode_baudot;
 		bfsk_databits_encode = databits_encode_baudot;
@@ -310,6 +405,7 @@ minimodem_struct minimodem_transmit_cfg(void) {
 		if (bfsk_n_data_bits == 0)
 			bfsk_n_data_bits = 8;
 	}
+#endif
 	if (bfsk_data_rate == 0.0f)
 		return mm;
 
@@ -398,6 +494,28 @@ minimodem_struct minimodem_transmit_cfg(void) {
 	{
 		simpleaudio_tone_init(tx_sin_table_len, tx_amplitude);
 
+		if (mode == MINIMODEM_MODE_4FSK) {
+			// the same frame in symbols, each data symbol carries 2 bits
+			return (minimodem_struct )
+			{
+				.data_rate = bfsk_data_rate,
+				.sample_rate = sample_rate,
+				.bfsk_mark_f = bfsk_mark_f,
+				.bfsk_space_f = bfsk_space_f,
+				.n_data_bits = 2 * bfsk_n_data_bits,
+				.bfsk_nstartbits = bfsk_nstartbits,
+				.bfsk_nstopbits = bfsk_nstopbits,
+				.tx_leader_bits_len = tx_leader_bits_len,
+				.tx_trailer_bits_len = tx_trailer_bits_len,
+				.encode = bfsk_databits_encode,
+				.txcarrier = txcarrier,
+				.bits_per_symbol = 2,
+				.chars_per_frame = 2,
+				.tones = MINIMODEM_4FSK_TONES,
+				.pause_leader_bits = tx_leader_bits_len,
+			};
+		}
+
 		return (minimodem_struct )
 		{
 			.data_rate = bfsk_data_rate,
@@ -415,6 +533,8 @@ minimodem_struct minimodem_transmit_cfg(void) {
 			.tx_trailer_bits_len = tx_trailer_bits_len,
 			.encode =	bfsk_databits_encode,
 			.txcarrier = txcarrier,
+			.bits_per_symbol = 1,
+			.chars_per_frame = 1,
 		};
 	}
 	return mm;
@@ -1,8 +1,12 @@
 #ifndef _MINIMODEM_ENC_INIT_H_
 #define _MINIMODEM_ENC_INIT_H_
 
+#include <stdint.h>
+
 #include "databits.h"
 #include "audio_element.h"
+#include "minimodem_config.h"
+#include "minimodem_profile.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +29,13 @@ typedef struct
 	int tx_trailer_bits_len;
 	databits_encoder *encode;
 	int txcarrier;
+	// MINIMODEM_MODE_4FSK: symbols of bits_per_symbol bits sent as tones[],
+	// n_data_bits is then in bits and holds chars_per_frame characters
+	int bits_per_symbol;
+	int chars_per_frame;
+	float tones[4];
+	// bits of leader tone ending a pause, for the header after it
+	int pause_leader_bits;
 } minimodem_struct;
 
 size_t fsk_transmit_buf
@@ -35,8 +46,16 @@ size_t fsk_transmit_buf
     size_t len
 );
 
+// time a line of TAPEFILE_LINE_LENGTH + 1 characters takes on tape in ms
+uint32_t fsk_transmit_line_ms(const minimodem_struct *s);
+
 minimodem_struct minimodem_transmit_cfg(void);
 
+minimodem_struct minimodem_transmit_cfg_mode(minimodem_mode_t mode);
+
+// baud rate and MINIMODEM_MODE_1200 tones of profile, see minimodem_profile.h
+minimodem_struct minimodem_transmit_cfg_profile(minimodem_mode_t mode, const minimodem_profile_t *profile);
+
 #ifdef __cplusplus
 }
 #endif
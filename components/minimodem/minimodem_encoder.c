@@ -1,4 +1,6 @@
 
+#include <string.h>
+
 #include "esp_log.h"
 #include "audio_mem.h"
 #include "audio_element.h"
@@ -6,23 +8,49 @@
 
 #include "minimodem_encoder.h"
 #include "minimodem_config.h"
+#include "tape_record.h"
+#include "tape_fec.h"
 
 static const char *TAG = "MINIMODEM_ENCODER";
 
 typedef struct minimodem_encoder
 {
-    minimodem_struct minimodem_str;
+    minimodem_struct minimodem_str;             // MINIMODEM_MODE_1200, for headers
+    minimodem_struct data_str;                  // modem_mode, for the records
+    minimodem_mode_t modem_mode;
+    bool binary_records;
+    uint32_t record_ms;                         // time one line takes on tape
+    int ncopies;                                // lines sent per side file line
+    char last_line[TAPEFILE_LINE_LENGTH + 1];
+    int nrepeat;                                // copies of last_line read so far
+    int nheader_slots;                          // lines still to be replaced by the header
+    int fec_data_records;
+    tape_fec_encoder_t *fec;
 } minimodem_encoder_t;
 
 static esp_err_t _minimodem_encoder_destroy(audio_element_handle_t self)
 {
     minimodem_encoder_t *minimodem_enc = (minimodem_encoder_t *)audio_element_getdata(self);
+    tape_fec_encoder_destroy(minimodem_enc->fec);
     audio_free(minimodem_enc);
     return ESP_OK;
 }
 static esp_err_t _minimodem_encoder_open(audio_element_handle_t self)
 {
+    minimodem_encoder_t *minimodem_enc = (minimodem_encoder_t *)audio_element_getdata(self);
     ESP_LOGD(TAG, "_minimodem_encoder_open");
+    minimodem_enc->last_line[0] = 0;
+    minimodem_enc->nrepeat = 0;
+    minimodem_enc->nheader_slots = minimodem_enc->modem_mode != MINIMODEM_MODE_1200 ?
+                                   minimodem_enc->ncopies : 0;
+    if (minimodem_enc->binary_records && minimodem_enc->fec_data_records > 0) {
+        tape_fec_encoder_destroy(minimodem_enc->fec);
+        minimodem_enc->fec = tape_fec_encoder_create(minimodem_enc->fec_data_records,
+                                                     TAPE_FEC_SLOTS_PER_SECOND * minimodem_enc->ncopies);
+        if (minimodem_enc->fec == NULL) {
+            return ESP_FAIL;
+        }
+    }
     return ESP_OK;
 }
 
@@ -36,26 +64,190 @@ static esp_err_t _minimodem_encoder_close(audio_element_handle_t self)
     return ESP_OK;
 }
 
+// 0001A_03_b3488ae07e_000M_0481 is a pause line, binary records are never one
+static bool minimodem_encoder_is_pause(const char *line)
+{
+    return line[0] != TAPE_RECORD_MARKER && line[23] == 'M';
+}
+
+/**
+ * Count the copies of a side file line, the side file repeats each
+ * second's line
+ */
+static void minimodem_encoder_read_line(minimodem_encoder_t *minimodem_enc, const char *buf)
+{
+    char line[TAPEFILE_LINE_LENGTH + 1];
+
+    memcpy(line, buf, TAPEFILE_LINE_LENGTH);
+    line[TAPEFILE_LINE_LENGTH] = 0;
+    if (strcmp(line, minimodem_enc->last_line) == 0) {
+        minimodem_enc->nrepeat++;
+    } else {
+        strcpy(minimodem_enc->last_line, line);
+        minimodem_enc->nrepeat = 0;
+    }
+}
+
+/**
+ * Convert a side file line to a binary record for its copy-th line on
+ * tape, each gets its own sub-second offset. Pause lines are left alone,
+ * they are sent as silence.
+ */
+static esp_err_t minimodem_encoder_make_record(minimodem_encoder_t *minimodem_enc, const char *buf,
+                                               int copy, char *record)
+{
+    char line[TAPEFILE_LINE_LENGTH + 1];
+    tape_record_t rec;
+
+    memcpy(line, buf, TAPEFILE_LINE_LENGTH);
+    line[TAPEFILE_LINE_LENGTH] = 0;
+    if (tape_record_parse(line, &rec) != ESP_OK
+        || (rec.type == TAPE_RECORD_MUTE && rec.playtime_ms > 0)) {
+        return ESP_FAIL;
+    }
+    const uint32_t offset_ms = (minimodem_enc->nrepeat * minimodem_enc->ncopies + copy)
+                               * minimodem_enc->record_ms;
+    if (rec.type == TAPE_RECORD_PLAY && offset_ms < 1000) {
+        rec.playtime_ms += offset_ms;
+        rec.total_ms += offset_ms;
+    }
+    if (tape_record_encode(&rec, record, TAPEFILE_LINE_LENGTH + 1) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    record[TAPEFILE_LINE_LENGTH] = '\n';
+    return ESP_OK;
+}
+
+/**
+ * Send a line in modem_mode. After a pause, and at the start, the first
+ * ncopies lines are replaced by a header sent in MINIMODEM_MODE_1200, which
+ * takes as long.
+ *
+ * @return bytes of audio, 0 for a replaced line, -1 if the output failed
+ */
+static int minimodem_encoder_send(audio_element_handle_t self, minimodem_encoder_t *minimodem_enc,
+                                  char *line, size_t len)
+{
+    minimodem_struct *str = &minimodem_enc->data_str;
+    char header[TAPEFILE_LINE_LENGTH + 1];
+
+    if (minimodem_encoder_is_pause(line)) {
+        if (minimodem_enc->modem_mode != MINIMODEM_MODE_1200) {
+            minimodem_enc->nheader_slots = minimodem_enc->ncopies;
+        }
+    } else if (minimodem_enc->nheader_slots > 0) {
+        if (minimodem_enc->nheader_slots-- < minimodem_enc->ncopies) {
+            return 0;
+        }
+        // the header's tape and audio ids are those of the last side file line
+        tape_record_t rec;
+        if (tape_record_parse(minimodem_enc->last_line, &rec) != ESP_OK
+            || tape_record_encode_header(&rec, minimodem_enc->modem_mode, header,
+                                         sizeof(header)) != ESP_OK) {
+            ESP_LOGW(TAG, "no header for: %s", minimodem_enc->last_line);
+            return 0;
+        }
+        ESP_LOGI(TAG, "header: modem mode %d", minimodem_enc->modem_mode);
+        header[TAPEFILE_LINE_LENGTH] = '\n';
+        line = header;
+        len = sizeof(header);
+        str = &minimodem_enc->minimodem_str;
+    }
+    const size_t out_len = fsk_transmit_buf(str, self, line, len);
+    return out_len > 0 ? (int)out_len : -1;
+}
+
+/**
+ * Send the side file through the FEC encoder, which reads up to a block
+ * ahead
+ */
+static audio_element_err_t minimodem_encoder_process_fec(audio_element_handle_t self,
+                                                         minimodem_encoder_t *minimodem_enc,
+                                                         char *in_buffer)
+{
+    const int wanted_size = TAPEFILE_LINE_LENGTH + 1; // +1 line end character
+    char line[TAPEFILE_LINE_LENGTH + 2];
+    int r_size = wanted_size;
+    int out_len = 0;
+
+    while (out_len == 0) {
+        while (!tape_fec_encoder_pop(minimodem_enc->fec, line)) {
+            if (r_size <= 0) {
+                // end of the side file and all of it sent
+                return r_size;
+            }
+            r_size = audio_element_input(self, in_buffer, wanted_size);
+            if (r_size == wanted_size) {
+                in_buffer[TAPEFILE_LINE_LENGTH] = 0;
+                minimodem_encoder_read_line(minimodem_enc, in_buffer);
+                // a pause line is sent once whatever the modem mode
+                const int ncopies = minimodem_encoder_is_pause(in_buffer) ? 1 : minimodem_enc->ncopies;
+                for (int i = 0; i < ncopies; i++) {
+                    tape_fec_encoder_push(minimodem_enc->fec, in_buffer);
+                }
+            } else if (r_size > 0) {
+                ESP_LOGW(TAG, "process: not enough data %d", r_size);
+                return AEL_IO_FAIL;
+            } else {
+                // flush the last block
+                tape_fec_encoder_push(minimodem_enc->fec, NULL);
+            }
+        }
+
+        ESP_LOGI(TAG, "process: %s", line);
+        const size_t len = strlen(line);
+        line[len] = '\n';
+        out_len = minimodem_encoder_send(self, minimodem_enc, line, len + 1);
+        if (out_len < 0) {
+            return AEL_IO_FAIL;
+        }
+    }
+    if (out_len > 0) {
+        audio_element_update_byte_pos(self, out_len);
+    }
+    return out_len;
+}
+
 static audio_element_err_t _minimodem_encoder_process(audio_element_handle_t self, char *in_buffer, int in_len)
 {
     minimodem_encoder_t *minimodem_enc = (minimodem_encoder_t *)audio_element_getdata(self);
 
-    // consume input data line by line
+    if (minimodem_enc->fec) {
+        return minimodem_encoder_process_fec(self, minimodem_enc, in_buffer);
+    }
+
+    // consume input data line by line, until one is sent: all the copies of
+    // a line can fall on header slots that are skipped
     const int wanted_size = TAPEFILE_LINE_LENGTH + 1; // +1 line end character
-    int r_size = audio_element_input(self, in_buffer, wanted_size);
-    int out_len = r_size;
-    if (r_size == wanted_size) {
+    int out_len = 0;
+    while (out_len == 0) {
+        int r_size = audio_element_input(self, in_buffer, wanted_size);
+        if (r_size != wanted_size) {
+            if (r_size > 0) {
+                ESP_LOGW(TAG, "process: not enough data %d", r_size);
+                return AEL_IO_FAIL;
+            }
+            // end of the side file
+            return r_size;
+        }
         ESP_LOGI(TAG, "process: %29s", in_buffer);
-        out_len = fsk_transmit_buf(&minimodem_enc->minimodem_str, self, in_buffer, wanted_size);
-        //audio_element_update_byte_pos(self, nbytes);
-        //out_len = audio_element_output(self, in_buffer, r_size);
-        if (out_len > 0) {
-            audio_element_update_byte_pos(self, out_len);
+        minimodem_encoder_read_line(minimodem_enc, in_buffer);
+        const int ncopies = minimodem_encoder_is_pause(in_buffer) ? 1 : minimodem_enc->ncopies;
+        for (int i = 0; i < ncopies; i++) {
+            char record[TAPEFILE_LINE_LENGTH + 1];
+            char *line = in_buffer;
+            if (minimodem_enc->binary_records
+                && minimodem_encoder_make_record(minimodem_enc, in_buffer, i, record) == ESP_OK) {
+                line = record;
+            }
+            int len = minimodem_encoder_send(self, minimodem_enc, line, wanted_size);
+            if (len < 0) {
+                return AEL_IO_FAIL;
+            }
+            out_len += len;
         }
-    } else if (r_size > 0) {
-        ESP_LOGW(TAG, "process: not enough data %d", r_size);
-        out_len = AEL_IO_FAIL;
     }
+    audio_element_update_byte_pos(self, out_len);
 
     return out_len;
 }
@@ -80,6 +272,21 @@ audio_element_handle_t minimodem_encoder_init(minimodem_encoder_cfg_t *config)
         cfg.out_rb_size = config->out_rb_size;
 
         minimodem_enc->minimodem_str = config->minimodem_str;
+        minimodem_enc->modem_mode = config->modem_mode;
+        minimodem_enc->binary_records = config->binary_records;
+        minimodem_enc->fec_data_records = config->fec_data_records;
+    }
+    minimodem_enc->data_str = minimodem_enc->minimodem_str;
+    if (config && minimodem_enc->modem_mode != MINIMODEM_MODE_1200) {
+        minimodem_enc->data_str = minimodem_transmit_cfg_profile(minimodem_enc->modem_mode, &config->profile);
+    }
+    // a faster mode sends each line more often, so the side file still
+    // takes the same time on tape
+    minimodem_enc->ncopies = 1;
+    if (minimodem_enc->minimodem_str.data_rate > 0 && minimodem_enc->data_str.data_rate > 0) {
+        minimodem_enc->record_ms = fsk_transmit_line_ms(&minimodem_enc->data_str);
+        minimodem_enc->ncopies = fsk_transmit_line_ms(&minimodem_enc->minimodem_str)
+                                 / minimodem_enc->record_ms;
     }
 
     cfg.tag = "minimodem_enc";
@@ -5,6 +5,7 @@
 #include "audio_element.h"
 
 #include "minimodem_enc_init.h"
+#include "tape_fec.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,6 +21,11 @@ typedef struct {
     int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
     bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
     minimodem_struct        minimodem_str;  /*!< Minimodem struct */ 
+    minimodem_mode_t        modem_mode;     /*!< Modem mode of the records, announced by a header in minimodem_str's */
+    minimodem_profile_t     profile;        /*!< Baud rate and tones of the records, minimodem_str should match */
+    bool                    binary_records; /*!< Send side file lines as binary records, see tape_record.h;
+                                                 false sends them as ASCII lines, which every decoder reads */
+    int                     fec_data_records; /*!< Seconds per FEC block of binary records, 0 for none, see tape_fec.h */
 } minimodem_encoder_cfg_t;
 
 #define MINIMODEM_ENCODER_TASK_STACK          (3 * 1024)
@@ -43,6 +49,10 @@ typedef struct {
     .task_prio          = MINIMODEM_ENCODER_TASK_PRIO,\
     .stack_in_ext       = true,\
 	.minimodem_str      = minimodem_transmit_cfg(), \
+    .modem_mode         = MINIMODEM_MODE_1200,\
+    .profile            = MINIMODEM_PROFILE_DEFAULT(),\
+    .binary_records     = false,\
+    .fec_data_records   = 0,\
 }
 
 //.minimodem_str      = minimodem_transmit_cfg(4, (char*[]){"minimodem", "300", "-R", "48000"}),
@@ -0,0 +1,210 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "minimodem_config.h"
+#include "minimodem_profile.h"
+
+static const char *TAG = "MINIMODEM_PROFILE";
+
+// bell202 tones sit well inside the 6400 Hz decimator cutoff
+#define PROFILE_MIN_BAUD        (100)
+#define PROFILE_MAX_BAUD        (2400)
+#define PROFILE_MIN_TONE        (300)
+#define PROFILE_MAX_TONE        (6000)
+#define PROFILE_MIN_SHIFT       (200)
+#define PROFILE_MAX_DIVISOR     (64)
+#define PROFILE_MAX_NSTEPS      (32)
+// -20 dBFS, a quiet tape still plays well above it
+#define PROFILE_MAX_SILENCE     (0.1f)
+#define PROFILE_MAX_AGC_GAIN    (40)
+
+typedef enum {
+    FIELD_FLOAT,
+    FIELD_UINT,
+} field_type_t;
+
+typedef struct {
+    const char *key;
+    field_type_t type;
+    size_t offset;
+} profile_field_t;
+
+static const profile_field_t fields[] = {
+        {"baud",                    FIELD_FLOAT, offsetof(minimodem_profile_t, baud)},
+        {"mark",                    FIELD_FLOAT, offsetof(minimodem_profile_t, mark)},
+        {"space",                   FIELD_FLOAT, offsetof(minimodem_profile_t, space)},
+        {"confidence_threshold",    FIELD_FLOAT, offsetof(minimodem_profile_t, confidence_threshold)},
+        {"confidence_search_limit", FIELD_FLOAT, offsetof(minimodem_profile_t, confidence_search_limit)},
+        {"sample_buf_divisor",      FIELD_UINT,  offsetof(minimodem_profile_t, sample_buf_divisor)},
+        {"analyze_nsteps",          FIELD_UINT,  offsetof(minimodem_profile_t, analyze_nsteps)},
+        {"analyze_nsteps_fine",     FIELD_UINT,  offsetof(minimodem_profile_t, analyze_nsteps_fine)},
+        {"silence_level",           FIELD_FLOAT, offsetof(minimodem_profile_t, silence_level)},
+        {"agc_max_gain",            FIELD_FLOAT, offsetof(minimodem_profile_t, agc_max_gain)},
+};
+
+#define NFIELDS (sizeof(fields) / sizeof(fields[0]))
+
+esp_err_t minimodem_profile_set(minimodem_profile_t *profile, const char *key, const char *value)
+{
+    for (size_t i = 0; i < NFIELDS; i++) {
+        if (strcmp(fields[i].key, key) != 0) {
+            continue;
+        }
+        char *end;
+        void *field = (char *)profile + fields[i].offset;
+        if (fields[i].type == FIELD_FLOAT) {
+            float v = strtof(value, &end);
+            if (end == value || *end != '\0' || !isfinite(v)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            *(float *)field = v;
+        } else {
+            long v = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || v < 0) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            *(unsigned int *)field = (unsigned int)v;
+        }
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+static char *trim(char *s)
+{
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+esp_err_t minimodem_profile_parse(const char *text, minimodem_profile_t *profile)
+{
+    minimodem_profile_t parsed = *profile;
+    char line[64];
+    int line_no = 0;
+
+    while (*text != '\0') {
+        size_t len = strcspn(text, "\n");
+        line_no++;
+        if (len >= sizeof(line)) {
+            ESP_LOGE(TAG, "Line %d too long", line_no);
+            return ESP_FAIL;
+        }
+        memcpy(line, text, len);
+        line[len] = '\0';
+        text += len + (text[len] == '\n');
+
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char *key = trim(line);
+        if (*key == '\0') {
+            continue;
+        }
+        char *eq = strchr(key, '=');
+        if (eq == NULL) {
+            ESP_LOGE(TAG, "Line %d: expected key=value", line_no);
+            return ESP_FAIL;
+        }
+        *eq = '\0';
+        key = trim(key);
+        char *value = trim(eq + 1);
+        if (minimodem_profile_set(&parsed, key, value) != ESP_OK) {
+            ESP_LOGE(TAG, "Line %d: bad %s=%s", line_no, key, value);
+            return ESP_FAIL;
+        }
+    }
+    if (minimodem_profile_check(&parsed) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *profile = parsed;
+    return ESP_OK;
+}
+
+esp_err_t minimodem_profile_check(const minimodem_profile_t *profile)
+{
+    if (profile->baud < PROFILE_MIN_BAUD || profile->baud > PROFILE_MAX_BAUD) {
+        ESP_LOGE(TAG, "baud %.1f out of %d..%d", profile->baud, PROFILE_MIN_BAUD, PROFILE_MAX_BAUD);
+        return ESP_ERR_INVALID_ARG;
+    }
+#ifdef MINIMODEM_FIXED_8N1
+    if (profile->baud != MINIMODEM_8N1_BAUD) {
+        ESP_LOGE(TAG, "Built for baud %d only", MINIMODEM_8N1_BAUD);
+        return ESP_ERR_INVALID_ARG;
+    }
+#endif
+    if (profile->mark < PROFILE_MIN_TONE || profile->mark > PROFILE_MAX_TONE
+        || profile->space < PROFILE_MIN_TONE || profile->space > PROFILE_MAX_TONE) {
+        ESP_LOGE(TAG, "Tones must be within %d..%d Hz", PROFILE_MIN_TONE, PROFILE_MAX_TONE);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fabsf(profile->mark - profile->space) < PROFILE_MIN_SHIFT) {
+        ESP_LOGE(TAG, "Mark and space must be at least %d Hz apart", PROFILE_MIN_SHIFT);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (profile->confidence_threshold <= 0
+        || profile->confidence_search_limit < profile->confidence_threshold) {
+        ESP_LOGE(TAG, "Need 0 < confidence_threshold <= confidence_search_limit");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (profile->sample_buf_divisor < 1 || profile->sample_buf_divisor > PROFILE_MAX_DIVISOR) {
+        ESP_LOGE(TAG, "sample_buf_divisor out of 1..%d", PROFILE_MAX_DIVISOR);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (profile->analyze_nsteps < 1 || profile->analyze_nsteps > PROFILE_MAX_NSTEPS
+        || profile->analyze_nsteps_fine < 1 || profile->analyze_nsteps_fine > PROFILE_MAX_NSTEPS) {
+        ESP_LOGE(TAG, "analyze_nsteps and analyze_nsteps_fine out of 1..%d", PROFILE_MAX_NSTEPS);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (profile->silence_level < 0 || profile->silence_level > PROFILE_MAX_SILENCE) {
+        ESP_LOGE(TAG, "silence_level out of 0..%g", PROFILE_MAX_SILENCE);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (profile->agc_max_gain < 0 || profile->agc_max_gain > PROFILE_MAX_AGC_GAIN) {
+        ESP_LOGE(TAG, "agc_max_gain out of 0..%d dB", PROFILE_MAX_AGC_GAIN);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+int minimodem_profile_format(const minimodem_profile_t *profile, char *buf, size_t size)
+{
+    int len = 0;
+    for (size_t i = 0; i < NFIELDS; i++) {
+        const void *field = (const char *)profile + fields[i].offset;
+        const size_t pos = (size_t)len < size ? (size_t)len : size;
+        if (fields[i].type == FIELD_FLOAT) {
+            len += snprintf(buf + pos, size - pos, "%s=%g\n", fields[i].key, *(const float *)field);
+        } else {
+            len += snprintf(buf + pos, size - pos, "%s=%u\n", fields[i].key, *(const unsigned int *)field);
+        }
+    }
+    return len;
+}
+
+bool minimodem_profile_equal(const minimodem_profile_t *a, const minimodem_profile_t *b)
+{
+    return a->baud == b->baud
+           && a->mark == b->mark
+           && a->space == b->space
+           && a->confidence_threshold == b->confidence_threshold
+           && a->confidence_search_limit == b->confidence_search_limit
+           && a->sample_buf_divisor == b->sample_buf_divisor
+           && a->analyze_nsteps == b->analyze_nsteps
+           && a->analyze_nsteps_fine == b->analyze_nsteps_fine
+           && a->silence_level == b->silence_level
+           && a->agc_max_gain == b->agc_max_gain;
+}
@@ -0,0 +1,99 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_MINIMODEM_PROFILE_H
+#define CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_MINIMODEM_PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Modem parameters that can be tuned per deck without rebuilding, see
+ * minimodem_receive_cfg_profile() and minimodem_transmit_cfg_profile().
+ *
+ * As text a profile is one "key=value" per line, '#' starts a comment. The
+ * keys are the field names below, e.g.
+ *
+ *   baud=1200
+ *   confidence_search_limit=2.0
+ *
+ * The baud rate and tones are those of MINIMODEM_MODE_1200. The 4-FSK mode
+ * keeps its tones and runs at the same baud rate. A line takes
+ * 30 * 10 / baud seconds, so at another rate than 1200 the tape no longer
+ * runs in step with the side file's 4 lines per second.
+ */
+typedef struct {
+    float baud;
+    float mark;                     /*!< Hz */
+    float space;                    /*!< Hz */
+    float confidence_threshold;     /*!< Lowest frame confidence taken as a signal */
+    float confidence_search_limit;  /*!< Frame search stops at this confidence */
+    unsigned int sample_buf_divisor; /*!< Sample buffer of at least sample rate / divisor samples */
+    unsigned int analyze_nsteps;    /*!< Frame offsets tried per bit */
+    unsigned int analyze_nsteps_fine; /*!< Offsets of the refining search */
+    float silence_level;            /*!< RMS, fraction of full scale, below which audio without
+                                         carrier is skipped unsearched; 0 searches everything */
+    float agc_max_gain;             /*!< dB the decoder may amplify a quiet tape by; 0 keeps the
+                                         level as recorded */
+} minimodem_profile_t;
+
+#define MINIMODEM_PROFILE_DEFAULT() {\
+    .baud                       = 1200,\
+    .mark                       = 1200,\
+    .space                      = 2200,\
+    .confidence_threshold       = 1.5f,\
+    .confidence_search_limit    = 2.3f,\
+    .sample_buf_divisor         = 12,\
+    .analyze_nsteps             = 3,\
+    .analyze_nsteps_fine        = 8,\
+    .silence_level              = 0.003f,\
+    .agc_max_gain               = 30,\
+}
+
+// longest text of minimodem_profile_format()
+#define MINIMODEM_PROFILE_TEXT_SIZE (256)
+
+/**
+ * Set a field by its key
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND for an unknown key, ESP_ERR_INVALID_ARG
+ *         if value is not a number
+ */
+esp_err_t minimodem_profile_set(minimodem_profile_t *profile, const char *key, const char *value);
+
+/**
+ * Set the fields given in text, the others keep their values. Nothing is
+ * changed on error.
+ *
+ * @return ESP_OK, ESP_FAIL for a malformed line or unknown key,
+ *         ESP_ERR_INVALID_ARG if the result fails minimodem_profile_check()
+ */
+esp_err_t minimodem_profile_parse(const char *text, minimodem_profile_t *profile);
+
+/**
+ * @return ESP_OK if the decoder and encoder can run with profile,
+ *         ESP_ERR_INVALID_ARG otherwise
+ */
+esp_err_t minimodem_profile_check(const minimodem_profile_t *profile);
+
+/**
+ * Write profile as text, every field on its own line
+ *
+ * @return length of the text, see snprintf()
+ */
+int minimodem_profile_format(const minimodem_profile_t *profile, char *buf, size_t size);
+
+bool minimodem_profile_equal(const minimodem_profile_t *a, const minimodem_profile_t *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_MINIMODEM_PROFILE_H
@@ -0,0 +1,220 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+#include "tape_combine.h"
+
+static const char *TAG = "TAPE_COMBINE";
+
+struct tape_combine {
+    // copies of the current ASCII record and their vote
+    char copies[TAPE_COMBINE_MAX_COPIES][TAPEFILE_LINE_LENGTH + 1];
+    int ncopies;
+    char vote[TAPEFILE_LINE_LENGTH + 1];
+    bool settled;
+    bool output;
+    uint32_t first_ms;
+    // last binary record output
+    tape_record_t last_binary;
+    bool have_binary;
+    unsigned int ncorrected;
+    unsigned int nmerged;
+};
+
+static int distance(const char *a, const char *b)
+{
+    int n = 0;
+    for (int i = 0; i < TAPEFILE_LINE_LENGTH; i++) {
+        n += a[i] != b[i];
+    }
+    return n;
+}
+
+static int votes_for(const tape_combine_t *comb, int pos, char c)
+{
+    int votes = 0;
+    for (int i = 0; i < comb->ncopies; i++) {
+        votes += comb->copies[i][pos] == c;
+    }
+    return votes;
+}
+
+/**
+ * Vote each character over the copies, sets settled when every character has
+ * at least two votes and more than any other
+ */
+static void update_vote(tape_combine_t *comb)
+{
+    comb->settled = true;
+    for (int pos = 0; pos < TAPEFILE_LINE_LENGTH; pos++) {
+        char best = comb->copies[0][pos];
+        int best_votes = votes_for(comb, pos, best);
+        for (int i = 1; i < comb->ncopies; i++) {
+            const int votes = votes_for(comb, pos, comb->copies[i][pos]);
+            if (votes > best_votes) {
+                best = comb->copies[i][pos];
+                best_votes = votes;
+            }
+        }
+        int other_votes = 0;
+        for (int i = 0; i < comb->ncopies; i++) {
+            if (comb->copies[i][pos] != best) {
+                const int votes = votes_for(comb, pos, comb->copies[i][pos]);
+                other_votes = votes > other_votes ? votes : other_votes;
+            }
+        }
+        comb->vote[pos] = best;
+        if (best_votes < 2 || best_votes == other_votes) {
+            comb->settled = false;
+        }
+    }
+    comb->vote[TAPEFILE_LINE_LENGTH] = 0;
+}
+
+/**
+ * Distance of line to the play line one second after the vote, so a copy of
+ * the next second is not taken for a copy with errors
+ */
+static int next_second_distance(const tape_combine_t *comb, const char *line)
+{
+    tape_record_t rec;
+    char next[TAPEFILE_LINE_LENGTH + 1];
+
+    if (tape_record_parse(comb->vote, &rec) != ESP_OK || rec.type != TAPE_RECORD_PLAY) {
+        return TAPEFILE_LINE_LENGTH + 1;
+    }
+    rec.playtime_ms += 1000;
+    rec.total_ms += 1000;
+    if (tape_record_format(&rec, next, sizeof(next)) != TAPEFILE_LINE_LENGTH) {
+        return TAPEFILE_LINE_LENGTH + 1;
+    }
+    return distance(line, next);
+}
+
+static void output_group(tape_combine_t *comb, uint32_t now_ms, tape_combine_line_t *out, int *nout)
+{
+    if (comb->ncopies == 0 || comb->output) {
+        return;
+    }
+    tape_combine_line_t *o = &out[(*nout)++];
+    memcpy(o->line, comb->vote, sizeof(o->line));
+    o->late_ms = now_ms - comb->first_ms;
+    if (strcmp(comb->vote, comb->copies[0]) != 0) {
+        ESP_LOGD(TAG, "corrected %s to %s", comb->copies[0], comb->vote);
+        comb->ncorrected++;
+    }
+    comb->nmerged += comb->ncopies - 1;
+    comb->output = true;
+}
+
+static bool same_second(const tape_record_t *a, const tape_record_t *b)
+{
+    return a->type == b->type && a->side == b->side && a->track_num == b->track_num
+           && a->total_ms / 1000 == b->total_ms / 1000
+           && strcmp(a->tape_id, b->tape_id) == 0 && strcmp(a->audio_id, b->audio_id) == 0;
+}
+
+tape_combine_t *tape_combine_create(void)
+{
+    tape_combine_t *comb = calloc(1, sizeof(tape_combine_t));
+    if (comb == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: tape_combine_t");
+    }
+    return comb;
+}
+
+void tape_combine_destroy(tape_combine_t *comb)
+{
+    free(comb);
+}
+
+void tape_combine_reset(tape_combine_t *comb)
+{
+    comb->ncopies = 0;
+    comb->have_binary = false;
+}
+
+esp_err_t tape_combine_push(tape_combine_t *comb, const char *line, uint32_t now_ms,
+                            tape_combine_line_t *out, int *nout)
+{
+    tape_record_t rec;
+
+    *nout = 0;
+    if (strlen(line) != TAPEFILE_LINE_LENGTH) {
+        // lost or extra characters, no use for voting
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (line[0] == TAPE_RECORD_MARKER) {
+        const esp_err_t err = tape_record_parse(line, &rec);
+        if (err == ESP_ERR_INVALID_CRC) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        output_group(comb, now_ms, out, nout);
+        comb->ncopies = 0;
+        if (err != ESP_OK) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (comb->have_binary && same_second(&comb->last_binary, &rec)) {
+            comb->nmerged++;
+            return ESP_OK;
+        }
+        comb->last_binary = rec;
+        comb->have_binary = true;
+        tape_combine_line_t *o = &out[(*nout)++];
+        memcpy(o->line, line, sizeof(o->line));
+        o->late_ms = 0;
+        return ESP_OK;
+    }
+
+    if (comb->ncopies > 0 && comb->ncopies < TAPE_COMBINE_MAX_COPIES) {
+        const int d = distance(line, comb->vote);
+        if (d <= TAPE_COMBINE_MAX_ERRORS && d <= next_second_distance(comb, line)) {
+            memcpy(comb->copies[comb->ncopies++], line, TAPEFILE_LINE_LENGTH + 1);
+            if (comb->output) {
+                comb->nmerged++;
+                return ESP_OK;
+            }
+            update_vote(comb);
+            if (comb->settled) {
+                output_group(comb, now_ms, out, nout);
+            }
+            return ESP_OK;
+        }
+    }
+
+    output_group(comb, now_ms, out, nout);
+    memcpy(comb->copies[0], line, TAPEFILE_LINE_LENGTH + 1);
+    comb->ncopies = 1;
+    comb->output = false;
+    comb->first_ms = now_ms;
+    comb->have_binary = false;
+    update_vote(comb);
+    if (tape_record_parse(line, &rec) == ESP_OK && rec.type == TAPE_RECORD_MUTE) {
+        // sent once
+        output_group(comb, now_ms, out, nout);
+    }
+    return ESP_OK;
+}
+
+void tape_combine_flush(tape_combine_t *comb, uint32_t now_ms, tape_combine_line_t *out, int *nout)
+{
+    *nout = 0;
+    output_group(comb, now_ms, out, nout);
+}
+
+void tape_combine_get_stats(const tape_combine_t *comb, unsigned int *ncorrected,
+                            unsigned int *nmerged)
+{
+    if (ncorrected) {
+        *ncorrected = comb->ncorrected;
+    }
+    if (nmerged) {
+        *nmerged = comb->nmerged;
+    }
+}
@@ -0,0 +1,83 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_COMBINE_H
+#define CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_COMBINE_H
+
+#include "tape_record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Combines the copies of each second's record into one.
+ *
+ * The side file has every play line several times in a row. Decoded ASCII
+ * lines of record length are collected into a group while they are closer to
+ * the group's vote than to the line of the following second, and the group
+ * is output once, as a per-character majority vote of its copies (ties go to
+ * the earlier copy). A group is output as soon as every character has at
+ * least two votes and a clear lead, otherwise when the next group starts.
+ * Mute lines are sent once and are output right away.
+ *
+ * Binary records carry a CRC instead, so the first good copy of a second is
+ * output and the others are dropped. Anything else (FEC slots, corrupted
+ * binary records, lines of the wrong length) is left to the caller.
+ */
+#define TAPE_COMBINE_MAX_COPIES     (8)
+// more differing characters than this start a new group
+#define TAPE_COMBINE_MAX_ERRORS     (4)
+// a push outputs at most the previous group and the new line's
+#define TAPE_COMBINE_MAX_OUT        (2)
+
+typedef struct tape_combine tape_combine_t;
+
+typedef struct {
+    char line[TAPEFILE_LINE_LENGTH + 1];
+    uint32_t late_ms;           /*!< Time since the first copy arrived */
+} tape_combine_line_t;
+
+tape_combine_t *tape_combine_create(void);
+
+void tape_combine_destroy(tape_combine_t *comb);
+
+/**
+ * Forget the current group, e.g. when the tape stops
+ */
+void tape_combine_reset(tape_combine_t *comb);
+
+/**
+ * Feed a decoded line, without the line end.
+ *
+ * @param now_ms    Arrival time of the line, for late_ms
+ * @param out       Room for TAPE_COMBINE_MAX_OUT lines
+ * @param nout      Set to the number of lines in out, to be handled before
+ *                  the line itself if ESP_ERR_NOT_FOUND is returned
+ * @return ESP_OK if the line was taken, ESP_ERR_NOT_FOUND if it is not a
+ *         replicated record and should be handled as it is
+ */
+esp_err_t tape_combine_push(tape_combine_t *comb, const char *line, uint32_t now_ms,
+                            tape_combine_line_t *out, int *nout);
+
+/**
+ * Output the current group if it has not been, e.g. at the end of a
+ * recording
+ *
+ * @param out       Room for TAPE_COMBINE_MAX_OUT lines
+ */
+void tape_combine_flush(tape_combine_t *comb, uint32_t now_ms, tape_combine_line_t *out, int *nout);
+
+/**
+ * @param ncorrected    Records output differently from their first copy
+ * @param nmerged       Copies dropped as part of a record already output
+ */
+void tape_combine_get_stats(const tape_combine_t *comb, unsigned int *ncorrected,
+                            unsigned int *nmerged);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_COMBINE_H
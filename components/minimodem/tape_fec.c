@@ -0,0 +1,520 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+#include "tape_fec.h"
+
+static const char *TAG = "TAPE_FEC";
+
+typedef char tape_fec_line_t[TAPEFILE_LINE_LENGTH + 1];
+
+struct tape_fec_encoder {
+    int ndata;
+    int slots_per_second;
+    // the block being collected
+    tape_record_t block[TAPE_FEC_MAX_DATA];
+    int nblock;
+    // copies of the current second's line seen so far
+    tape_fec_line_t group_line;
+    int ngroup;
+    // lines ready to send, a FIFO
+    tape_fec_line_t *queue;
+    int queue_size;
+    int queue_head;
+    int queue_len;
+};
+
+struct tape_fec_decoder {
+    // current block
+    bool active;
+    unsigned int start;
+    int ndata;
+    int nslots;
+    uint64_t received;
+    uint32_t output;
+    uint8_t payload[TAPE_FEC_MAX_SLOTS][TAPE_FEC_PAYLOAD_SIZE];
+    // scratch for the erasure decoder
+    uint8_t matrix[TAPE_FEC_MAX_DATA][2 * TAPE_FEC_MAX_DATA];
+    unsigned int nrecovered;
+    unsigned int nlost;
+};
+
+/*
+ * GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1
+ */
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+static bool gf_ready;
+
+static void gf_init(void)
+{
+    if (gf_ready) {
+        return;
+    }
+    unsigned int x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= 0x11d;
+        }
+    }
+    for (int i = 255; i < 512; i++) {
+        gf_exp[i] = gf_exp[i - 255];
+    }
+    gf_ready = true;
+}
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    return (a && b) ? gf_exp[gf_log[a] + gf_log[b]] : 0;
+}
+
+static inline uint8_t gf_inv(uint8_t a)
+{
+    return gf_exp[255 - gf_log[a]];
+}
+
+/**
+ * Generator coefficient of data slot j in parity slot p. Any square
+ * submatrix of a Cauchy matrix is invertible, which makes the code MDS.
+ */
+static inline uint8_t cauchy(int ndata, int p, int j)
+{
+    return gf_inv((uint8_t)((ndata + p) ^ j));
+}
+
+/**
+ * Position of a slot on tape, in slots from the start of the block
+ */
+static int slot_order(int slot, int ndata, int slots_per_second)
+{
+    if (slot < ndata) {
+        return slot * slots_per_second;
+    }
+    const int p = slot - ndata;
+    return (p / (slots_per_second - 1)) * slots_per_second + 1 + p % (slots_per_second - 1);
+}
+
+static int popcount64(uint64_t v)
+{
+    int n = 0;
+    for (; v; v &= v - 1) {
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Encoder
+ */
+
+static tape_fec_line_t *queue_add(tape_fec_encoder_t *enc)
+{
+    if (enc->queue_len == enc->queue_size) {
+        // cannot happen, the queue holds a block and a second more
+        ESP_LOGE(TAG, "queue overflow");
+        return NULL;
+    }
+    const int tail = (enc->queue_head + enc->queue_len) % enc->queue_size;
+    enc->queue_len++;
+    return &enc->queue[tail];
+}
+
+/**
+ * Queue a line outside of the FEC blocks, as a binary record if it is one
+ */
+static void queue_plain(tape_fec_encoder_t *enc, const char *line, int copy)
+{
+    tape_fec_line_t *out = queue_add(enc);
+    tape_record_t rec;
+
+    if (out == NULL) {
+        return;
+    }
+    if (tape_record_parse(line, &rec) == ESP_OK
+        && !(rec.type == TAPE_RECORD_MUTE && rec.playtime_ms > 0)) {
+        if (rec.type == TAPE_RECORD_PLAY) {
+            const uint32_t offset_ms = copy * 1000 / enc->slots_per_second;
+            rec.playtime_ms += offset_ms;
+            rec.total_ms += offset_ms;
+        }
+        if (tape_record_encode(&rec, *out, sizeof(*out)) == ESP_OK) {
+            return;
+        }
+    }
+    // pause lines are sent as silence by fsk_transmit_buf()
+    snprintf(*out, sizeof(*out), "%s", line);
+}
+
+static void queue_slot(tape_fec_encoder_t *enc, uint8_t *data, int slot)
+{
+    tape_fec_line_t *out = queue_add(enc);
+    if (out != NULL) {
+        data[5] = slot;
+        tape_record_pack(data, *out);
+    }
+}
+
+static void flush_block(tape_fec_encoder_t *enc)
+{
+    const int ndata = enc->nblock;
+    const int spp = enc->slots_per_second - 1;
+    uint8_t payload[TAPE_FEC_MAX_DATA][TAPE_FEC_PAYLOAD_SIZE];
+    uint8_t data[TAPE_RECORD_BINARY_SIZE];
+
+    if (ndata == 0) {
+        return;
+    }
+    for (int j = 0; j < ndata; j++) {
+        uint8_t bytes[TAPE_RECORD_BINARY_SIZE];
+        tape_record_to_bytes(&enc->block[j], bytes);
+        memcpy(payload[j], bytes + 1, 10);
+        payload[j][10] = enc->block[j].playtime_ms >> 16;
+        payload[j][11] = enc->block[j].playtime_ms >> 8;
+        payload[j][12] = enc->block[j].playtime_ms;
+    }
+
+    const unsigned int start = enc->block[0].total_ms / 1000;
+    data[0] = (TAPE_RECORD_VERSION << 4) | TAPE_RECORD_FEC;
+    data[1] = start >> 8;
+    data[2] = start;
+    data[3] = ndata;
+    data[4] = ndata * enc->slots_per_second;
+
+    for (int i = 0; i < ndata; i++) {
+        memcpy(data + 6, payload[i], TAPE_FEC_PAYLOAD_SIZE);
+        queue_slot(enc, data, i);
+        for (int p = i * spp; p < (i + 1) * spp; p++) {
+            memset(data + 6, 0, TAPE_FEC_PAYLOAD_SIZE);
+            for (int j = 0; j < ndata; j++) {
+                const uint8_t c = cauchy(ndata, p, j);
+                for (int b = 0; b < TAPE_FEC_PAYLOAD_SIZE; b++) {
+                    data[6 + b] ^= gf_mul(c, payload[j][b]);
+                }
+            }
+            queue_slot(enc, data, ndata + p);
+        }
+    }
+    enc->nblock = 0;
+}
+
+static void flush_group(tape_fec_encoder_t *enc)
+{
+    for (int i = 0; i < enc->ngroup; i++) {
+        queue_plain(enc, enc->group_line, i);
+    }
+    enc->ngroup = 0;
+}
+
+/**
+ * Whether a line can be a data record: a play record whose times fit the
+ * slot fields
+ */
+static bool fec_record(const char *line, tape_record_t *rec)
+{
+    uint8_t bytes[TAPE_RECORD_BINARY_SIZE];
+    return tape_record_parse(line, rec) == ESP_OK
+           && rec->type == TAPE_RECORD_PLAY
+           && rec->playtime_ms < (1 << 24)
+           && rec->total_ms % 1000 == 0
+           && rec->total_ms / 1000 <= 0xffff
+           && tape_record_to_bytes(rec, bytes) == ESP_OK;
+}
+
+static void add_second(tape_fec_encoder_t *enc)
+{
+    tape_record_t rec;
+    fec_record(enc->group_line, &rec);
+    enc->ngroup = 0;
+
+    // the block's total times must be consecutive seconds
+    if (enc->nblock > 0 && rec.total_ms != enc->block[0].total_ms + enc->nblock * 1000) {
+        flush_block(enc);
+    }
+    enc->block[enc->nblock++] = rec;
+    if (enc->nblock == enc->ndata) {
+        flush_block(enc);
+    }
+}
+
+tape_fec_encoder_t *tape_fec_encoder_create(int ndata, int slots_per_second)
+{
+    if (ndata < 1 || ndata > TAPE_FEC_MAX_DATA || slots_per_second < 2
+        || ndata * slots_per_second > TAPE_FEC_MAX_SLOTS) {
+        ESP_LOGE(TAG, "invalid block %d x %d", ndata, slots_per_second);
+        return NULL;
+    }
+    gf_init();
+    tape_fec_encoder_t *enc = calloc(1, sizeof(tape_fec_encoder_t));
+    if (enc == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: tape_fec_encoder_t");
+        return NULL;
+    }
+    enc->ndata = ndata;
+    enc->slots_per_second = slots_per_second;
+    // a block, the unfinished second before it and a line passed through
+    enc->queue_size = (ndata + 1) * slots_per_second + 1;
+    enc->queue = calloc(enc->queue_size, sizeof(tape_fec_line_t));
+    if (enc->queue == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: tape_fec queue");
+        free(enc);
+        return NULL;
+    }
+    return enc;
+}
+
+void tape_fec_encoder_destroy(tape_fec_encoder_t *enc)
+{
+    if (enc) {
+        free(enc->queue);
+        free(enc);
+    }
+}
+
+void tape_fec_encoder_push(tape_fec_encoder_t *enc, const char *line)
+{
+    tape_record_t rec;
+
+    if (line == NULL) {
+        flush_block(enc);
+        flush_group(enc);
+        return;
+    }
+    if (enc->ngroup > 0 && strcmp(line, enc->group_line) == 0) {
+        if (++enc->ngroup == enc->slots_per_second) {
+            add_second(enc);
+        }
+        return;
+    }
+    // an unfinished second is sent as plain records, after the block
+    // before it
+    if (enc->ngroup > 0) {
+        flush_block(enc);
+        flush_group(enc);
+    }
+    if (!fec_record(line, &rec)) {
+        flush_block(enc);
+        queue_plain(enc, line, 0);
+        return;
+    }
+    snprintf(enc->group_line, sizeof(enc->group_line), "%s", line);
+    enc->ngroup = 1;
+}
+
+bool tape_fec_encoder_pop(tape_fec_encoder_t *enc, char *line)
+{
+    if (enc->queue_len == 0) {
+        return false;
+    }
+    strcpy(line, enc->queue[enc->queue_head]);
+    enc->queue_head = (enc->queue_head + 1) % enc->queue_size;
+    enc->queue_len--;
+    return true;
+}
+
+/*
+ * Decoder
+ */
+
+static void data_record(const tape_fec_decoder_t *dec, int slot, tape_record_t *rec)
+{
+    uint8_t bytes[TAPE_RECORD_BINARY_SIZE] = {0};
+    const uint8_t *payload = dec->payload[slot];
+    const uint32_t total_ms = (dec->start + slot) * 1000;
+
+    bytes[0] = (TAPE_RECORD_VERSION << 4) | TAPE_RECORD_PLAY;
+    memcpy(bytes + 1, payload, 10);
+    bytes[12] = payload[10];
+    bytes[13] = payload[11];
+    bytes[14] = payload[12];
+    bytes[15] = total_ms >> 24;
+    bytes[16] = total_ms >> 16;
+    bytes[17] = total_ms >> 8;
+    bytes[18] = total_ms;
+    tape_record_from_bytes(bytes, rec);
+}
+
+static void finish_block(tape_fec_decoder_t *dec)
+{
+    if (dec->active) {
+        dec->nlost += dec->ndata - popcount64(dec->output);
+    }
+    dec->active = false;
+}
+
+/**
+ * Solve for the missing data slots from as many received parity slots
+ */
+static void recover(tape_fec_decoder_t *dec, int current_slot, tape_fec_record_t *out, int *nout)
+{
+    const int ndata = dec->ndata;
+    const int slots_per_second = dec->nslots / ndata;
+    int missing[TAPE_FEC_MAX_DATA];
+    int rows[TAPE_FEC_MAX_DATA];
+    int nmissing = 0;
+    int nrows = 0;
+
+    for (int j = 0; j < ndata; j++) {
+        if (!(dec->received & (1ULL << j))) {
+            missing[nmissing++] = j;
+        }
+    }
+    for (int slot = ndata; slot < dec->nslots && nrows < nmissing; slot++) {
+        if (dec->received & (1ULL << slot)) {
+            rows[nrows++] = slot - ndata;
+        }
+    }
+
+    // invert the Cauchy submatrix of the missing columns, Gauss-Jordan
+    uint8_t (*m)[2 * TAPE_FEC_MAX_DATA] = dec->matrix;
+    const int n = nmissing;
+    for (int r = 0; r < n; r++) {
+        for (int k = 0; k < n; k++) {
+            m[r][k] = cauchy(ndata, rows[r], missing[k]);
+            m[r][n + k] = (r == k);
+        }
+    }
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        while (m[pivot][col] == 0) {
+            pivot++;
+        }
+        if (pivot != col) {
+            for (int k = 0; k < 2 * n; k++) {
+                uint8_t t = m[col][k];
+                m[col][k] = m[pivot][k];
+                m[pivot][k] = t;
+            }
+        }
+        const uint8_t inv = gf_inv(m[col][col]);
+        for (int k = 0; k < 2 * n; k++) {
+            m[col][k] = gf_mul(m[col][k], inv);
+        }
+        for (int r = 0; r < n; r++) {
+            const uint8_t f = m[r][col];
+            if (r != col && f) {
+                for (int k = 0; k < 2 * n; k++) {
+                    m[r][k] ^= gf_mul(f, m[col][k]);
+                }
+            }
+        }
+    }
+
+    for (int b = 0; b < TAPE_FEC_PAYLOAD_SIZE; b++) {
+        // parity minus the contribution of the received data
+        uint8_t rhs[TAPE_FEC_MAX_DATA];
+        for (int r = 0; r < n; r++) {
+            uint8_t v = dec->payload[ndata + rows[r]][b];
+            for (int j = 0; j < ndata; j++) {
+                if (dec->received & (1ULL << j)) {
+                    v ^= gf_mul(cauchy(ndata, rows[r], j), dec->payload[j][b]);
+                }
+            }
+            rhs[r] = v;
+        }
+        for (int k = 0; k < n; k++) {
+            uint8_t v = 0;
+            for (int r = 0; r < n; r++) {
+                v ^= gf_mul(m[k][n + r], rhs[r]);
+            }
+            dec->payload[missing[k]][b] = v;
+        }
+    }
+
+    const int current_order = slot_order(current_slot, ndata, slots_per_second);
+    for (int k = 0; k < n; k++) {
+        const int j = missing[k];
+        dec->received |= 1ULL << j;
+        dec->output |= 1UL << j;
+        data_record(dec, j, &out[*nout].rec);
+        out[*nout].late_ms = (current_order - slot_order(j, ndata, slots_per_second)) * 1000
+                             / slots_per_second;
+        (*nout)++;
+    }
+    dec->nrecovered += n;
+    ESP_LOGD(TAG, "block %u: recovered %d records", dec->start, n);
+}
+
+tape_fec_decoder_t *tape_fec_decoder_create(void)
+{
+    gf_init();
+    tape_fec_decoder_t *dec = calloc(1, sizeof(tape_fec_decoder_t));
+    if (dec == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: tape_fec_decoder_t");
+    }
+    return dec;
+}
+
+void tape_fec_decoder_destroy(tape_fec_decoder_t *dec)
+{
+    free(dec);
+}
+
+void tape_fec_decoder_reset(tape_fec_decoder_t *dec)
+{
+    finish_block(dec);
+}
+
+esp_err_t tape_fec_decoder_push(tape_fec_decoder_t *dec, const char *line,
+                                tape_fec_record_t *out, int *nout)
+{
+    uint8_t data[TAPE_RECORD_BINARY_SIZE];
+
+    *nout = 0;
+    if (tape_record_unpack(line, data) != ESP_OK || (data[0] & 0x0f) != TAPE_RECORD_FEC) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const unsigned int start = (data[1] << 8) | data[2];
+    const int ndata = data[3];
+    const int nslots = data[4];
+    const int slot = data[5];
+    if (ndata < 1 || ndata > TAPE_FEC_MAX_DATA || nslots > TAPE_FEC_MAX_SLOTS
+        || nslots % ndata != 0 || nslots / ndata < 2 || slot >= nslots) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (!dec->active || start != dec->start || ndata != dec->ndata || nslots != dec->nslots) {
+        finish_block(dec);
+        dec->active = true;
+        dec->start = start;
+        dec->ndata = ndata;
+        dec->nslots = nslots;
+        dec->received = 0;
+        dec->output = 0;
+    }
+    if (dec->received & (1ULL << slot)) {
+        return ESP_OK;
+    }
+    memcpy(dec->payload[slot], data + 6, TAPE_FEC_PAYLOAD_SIZE);
+    dec->received |= 1ULL << slot;
+
+    if (slot < ndata) {
+        dec->output |= 1UL << slot;
+        data_record(dec, slot, &out[*nout].rec);
+        out[*nout].late_ms = 0;
+        (*nout)++;
+    }
+    const uint32_t all = (ndata == 32) ? 0xffffffffUL : (1UL << ndata) - 1;
+    if (dec->output != all && popcount64(dec->received) >= ndata) {
+        recover(dec, slot, out, nout);
+    }
+    return ESP_OK;
+}
+
+void tape_fec_decoder_get_stats(const tape_fec_decoder_t *dec, unsigned int *nrecovered,
+                                unsigned int *nlost)
+{
+    if (nrecovered) {
+        *nrecovered = dec->nrecovered;
+    }
+    if (nlost) {
+        *nlost = dec->nlost;
+    }
+}
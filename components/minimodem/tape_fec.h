@@ -0,0 +1,117 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_FEC_H
+#define CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_FEC_H
+
+#include "tape_record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Forward error correction across binary tape records.
+ *
+ * The side file has slots_per_second identical lines for every second. With
+ * FEC the first one is sent as a data slot and the others are replaced by
+ * parity slots of a block of ndata seconds. The block is a systematic
+ * Reed-Solomon code over GF(2^8) with a Cauchy generator matrix, one
+ * codeword per payload byte position across the slots. So any ndata slots
+ * of a block, data or parity, give back all of its data records, and a
+ * dropout of up to (slots_per_second - 1) * ndata / slots_per_second
+ * seconds within a block is recovered. Each slot is as long as a line, so
+ * a side file takes the same time on tape.
+ *
+ * On tape each second is its data slot followed by slots_per_second - 1
+ * parity slots. A slot is a binary line of type TAPE_RECORD_FEC:
+ *
+ *   byte  0       version (high nibble), TAPE_RECORD_FEC (low nibble)
+ *   bytes 1..2    total seconds on tape of the block's first data record
+ *   byte  3       data slots in the block
+ *   byte  4       slots in the block
+ *   byte  5       slot index, data slots first
+ *   bytes 6..18   payload
+ *   bytes 19..20  CRC-16, see tape_record.h
+ *
+ * The payload of a data slot is bytes 1..10 of its binary record (tape id,
+ * side and track, audio id) and the play time in ms as 24 bits. The total
+ * time follows from the block's first second, so only play records of
+ * consecutive seconds go into a block; everything else is sent as a plain
+ * record between blocks.
+ */
+#define TAPE_FEC_PAYLOAD_SIZE       (13)
+#define TAPE_FEC_MAX_SLOTS          (64)
+#define TAPE_FEC_MAX_DATA           (32)
+
+#define TAPE_FEC_DATA_RECORDS       (8)     /*!< Default seconds per block */
+#define TAPE_FEC_SLOTS_PER_SECOND   (4)     /*!< Side file lines per second, see tapefile.c */
+
+typedef struct tape_fec_encoder tape_fec_encoder_t;
+typedef struct tape_fec_decoder tape_fec_decoder_t;
+
+typedef struct {
+    tape_record_t rec;
+    uint32_t late_ms;           /*!< Time on tape since the record's own slot */
+} tape_fec_record_t;
+
+/**
+ * @param ndata             Seconds per block, 1..TAPE_FEC_MAX_DATA
+ * @param slots_per_second  Side file lines per second, at least 2
+ * @return encoder, NULL if out of memory or the block would exceed
+ *         TAPE_FEC_MAX_SLOTS
+ */
+tape_fec_encoder_t *tape_fec_encoder_create(int ndata, int slots_per_second);
+
+void tape_fec_encoder_destroy(tape_fec_encoder_t *enc);
+
+/**
+ * Add the next side file line, without the line end, or NULL at the end of
+ * the side file to flush the last block.
+ */
+void tape_fec_encoder_push(tape_fec_encoder_t *enc, const char *line);
+
+/**
+ * Take the next line to send, which is TAPEFILE_LINE_LENGTH long except
+ * for pause lines passed through.
+ *
+ * @param line  At least TAPEFILE_LINE_LENGTH + 1 bytes
+ * @return false if more lines must be pushed first
+ */
+bool tape_fec_encoder_pop(tape_fec_encoder_t *enc, char *line);
+
+tape_fec_decoder_t *tape_fec_decoder_create(void);
+
+void tape_fec_decoder_destroy(tape_fec_decoder_t *dec);
+
+/**
+ * Forget the current block, e.g. when the tape stops
+ */
+void tape_fec_decoder_reset(tape_fec_decoder_t *dec);
+
+/**
+ * Feed a decoded line. Data records, received or recovered from the
+ * parity, are returned once each.
+ *
+ * @param out   Room for TAPE_FEC_MAX_DATA records
+ * @param nout  Set to the number of records in out
+ * @return ESP_OK for a FEC slot, ESP_ERR_NOT_FOUND if the line is not one
+ *         (or is corrupted) and should be handled as a record
+ */
+esp_err_t tape_fec_decoder_push(tape_fec_decoder_t *dec, const char *line,
+                                tape_fec_record_t *out, int *nout);
+
+/**
+ * @param nrecovered    Data records recovered from parity so far
+ * @param nlost         Data records of finished blocks that could not be
+ *                      recovered
+ */
+void tape_fec_decoder_get_stats(const tape_fec_decoder_t *dec, unsigned int *nrecovered,
+                                unsigned int *nlost);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_FEC_H
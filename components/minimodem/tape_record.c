@@ -0,0 +1,299 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tape_record.h"
+
+static const char base64_chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint16_t crc16_ccitt(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static int base64_value(char c)
+{
+    const char *p = strchr(base64_chars, c);
+    return (c != 0 && p != NULL) ? (int)(p - base64_chars) : -1;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*
+ * Field positions of an ASCII line, "0001A_03_b3488ae07e_0125_0481" or the
+ * mute line "0001A_03_b3488ae07e_005M_0481"
+ */
+#define ASCII_SIDE          (4)
+#define ASCII_TRACK         (6)
+#define ASCII_AUDIO_ID      (9)
+#define ASCII_PLAYTIME      (20)
+#define ASCII_MUTE_MARK     (23)
+#define ASCII_TOTAL         (25)
+
+static const uint8_t ascii_separators[] = {5, 8, 19, 24};
+
+/**
+ * @return the value of n decimal digits at s, -1 if one is not a digit
+ */
+static int parse_digits(const char *s, int n)
+{
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+        v = v * 10 + (s[i] - '0');
+    }
+    return v;
+}
+
+static bool is_hex_digit(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * Parse the fixed-width ASCII line by position, every separator and digit
+ * is checked so that a garbled line is not taken for a record
+ */
+static esp_err_t parse_ascii(const char *line, tape_record_t *rec)
+{
+    size_t len = 0;
+    while (len <= TAPEFILE_LINE_LENGTH && line[len] != 0) {
+        len++;
+    }
+    if (len != TAPEFILE_LINE_LENGTH) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < sizeof(ascii_separators); i++) {
+        if (line[ascii_separators[i]] != '_') {
+            return ESP_FAIL;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        if (line[i] <= ' ' || line[i] > '~') {
+            return ESP_FAIL;
+        }
+    }
+    if (line[ASCII_SIDE] != 'A' && line[ASCII_SIDE] != 'B') {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < 10; i++) {
+        if (!is_hex_digit(line[ASCII_AUDIO_ID + i])) {
+            return ESP_FAIL;
+        }
+    }
+
+    const int track_num = parse_digits(line + ASCII_TRACK, 2);
+    int seconds;
+    if (line[ASCII_MUTE_MARK] == 'M') {
+        seconds = parse_digits(line + ASCII_PLAYTIME, 3);
+        rec->type = TAPE_RECORD_MUTE;
+    } else {
+        seconds = parse_digits(line + ASCII_PLAYTIME, 4);
+        rec->type = TAPE_RECORD_PLAY;
+    }
+    const int total_seconds = parse_digits(line + ASCII_TOTAL, 4);
+    if (track_num < 0 || seconds < 0 || total_seconds < 0) {
+        return ESP_FAIL;
+    }
+
+    memcpy(rec->tape_id, line, 4);
+    rec->tape_id[4] = 0;
+    rec->side = line[ASCII_SIDE];
+    rec->track_num = track_num;
+    memcpy(rec->audio_id, line + ASCII_AUDIO_ID, 10);
+    rec->audio_id[10] = 0;
+    rec->playtime_ms = (uint32_t)seconds * 1000;
+    rec->total_ms = (uint32_t)total_seconds * 1000;
+    rec->binary = false;
+    return ESP_OK;
+}
+
+esp_err_t tape_record_unpack(const char *line, uint8_t *data)
+{
+    if (line[0] != TAPE_RECORD_MARKER || strlen(line) != TAPEFILE_LINE_LENGTH) {
+        return ESP_FAIL;
+    }
+    // 4 characters carry 3 bytes
+    const char *p = line + 1;
+    for (int i = 0; i < TAPE_RECORD_BINARY_SIZE; i += 3, p += 4) {
+        uint32_t v = 0;
+        for (int k = 0; k < 4; k++) {
+            int value = base64_value(p[k]);
+            if (value < 0) {
+                return ESP_FAIL;
+            }
+            v = (v << 6) | value;
+        }
+        data[i] = v >> 16;
+        data[i + 1] = v >> 8;
+        data[i + 2] = v;
+    }
+
+    const uint16_t crc = (data[19] << 8) | data[20];
+    if (crc16_ccitt(data, 19) != crc) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    if ((data[0] >> 4) != TAPE_RECORD_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+void tape_record_pack(uint8_t *data, char *buf)
+{
+    const uint16_t crc = crc16_ccitt(data, 19);
+    data[19] = crc >> 8;
+    data[20] = crc;
+
+    char *p = buf;
+    *p++ = TAPE_RECORD_MARKER;
+    for (int i = 0; i < TAPE_RECORD_BINARY_SIZE; i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        *p++ = base64_chars[(v >> 18) & 0x3f];
+        *p++ = base64_chars[(v >> 12) & 0x3f];
+        *p++ = base64_chars[(v >> 6) & 0x3f];
+        *p++ = base64_chars[v & 0x3f];
+    }
+    *p = 0;
+}
+
+esp_err_t tape_record_from_bytes(const uint8_t *data, tape_record_t *rec)
+{
+    rec->type = data[0] & 0x0f;
+    if (rec->type == TAPE_RECORD_FEC || rec->type == TAPE_RECORD_HEADER) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (rec->type != TAPE_RECORD_PLAY && rec->type != TAPE_RECORD_MUTE) {
+        return ESP_FAIL;
+    }
+    memcpy(rec->tape_id, data + 1, 4);
+    rec->tape_id[4] = 0;
+    rec->side = (data[5] & 0x80) ? 'B' : 'A';
+    rec->track_num = data[5] & 0x7f;
+    snprintf(rec->audio_id, sizeof(rec->audio_id), "%02x%02x%02x%02x%02x",
+             data[6], data[7], data[8], data[9], data[10]);
+    rec->playtime_ms = get_be32(data + 11);
+    rec->total_ms = get_be32(data + 15);
+    rec->binary = true;
+    return ESP_OK;
+}
+
+esp_err_t tape_record_parse(const char *line, tape_record_t *rec)
+{
+    uint8_t data[TAPE_RECORD_BINARY_SIZE];
+
+    if (line[0] != TAPE_RECORD_MARKER) {
+        return parse_ascii(line, rec);
+    }
+    esp_err_t err = tape_record_unpack(line, data);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return tape_record_from_bytes(data, rec);
+}
+
+esp_err_t tape_record_to_bytes(const tape_record_t *rec, uint8_t *data)
+{
+    if ((rec->side != 'A' && rec->side != 'B')
+        || rec->track_num < 0 || rec->track_num > 0x7f
+        || strlen(rec->tape_id) != 4
+        || strlen(rec->audio_id) != 10
+        || strspn(rec->audio_id, "0123456789abcdefABCDEF") != 10) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const unsigned long long audio_id = strtoull(rec->audio_id, NULL, 16);
+
+    data[0] = (TAPE_RECORD_VERSION << 4) | rec->type;
+    memcpy(data + 1, rec->tape_id, 4);
+    data[5] = (rec->side == 'B' ? 0x80 : 0) | rec->track_num;
+    for (int i = 0; i < 5; i++) {
+        data[6 + i] = audio_id >> (8 * (4 - i));
+    }
+    put_be32(data + 11, rec->playtime_ms);
+    put_be32(data + 15, rec->total_ms);
+    return ESP_OK;
+}
+
+esp_err_t tape_record_encode(const tape_record_t *rec, char *buf, size_t size)
+{
+    uint8_t data[TAPE_RECORD_BINARY_SIZE];
+
+    if (size < TAPEFILE_LINE_LENGTH + 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = tape_record_to_bytes(rec, data);
+    if (err != ESP_OK) {
+        return err;
+    }
+    tape_record_pack(data, buf);
+    return ESP_OK;
+}
+
+esp_err_t tape_record_encode_header(const tape_record_t *rec, minimodem_mode_t mode,
+                                    char *buf, size_t size)
+{
+    uint8_t data[TAPE_RECORD_BINARY_SIZE];
+
+    if (size < TAPEFILE_LINE_LENGTH + 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = tape_record_to_bytes(rec, data);
+    if (err != ESP_OK) {
+        return err;
+    }
+    data[0] = (TAPE_RECORD_VERSION << 4) | TAPE_RECORD_HEADER;
+    data[11] = mode;
+    memset(data + 12, 0, 7);
+    tape_record_pack(data, buf);
+    return ESP_OK;
+}
+
+esp_err_t tape_record_parse_header(const char *line, minimodem_mode_t *mode)
+{
+    uint8_t data[TAPE_RECORD_BINARY_SIZE];
+
+    if (tape_record_unpack(line, data) != ESP_OK
+        || (data[0] & 0x0f) != TAPE_RECORD_HEADER
+        || data[11] >= MINIMODEM_NMODES) {
+        return ESP_FAIL;
+    }
+    *mode = data[11];
+    return ESP_OK;
+}
+
+int tape_record_format(const tape_record_t *rec, char *buf, size_t size)
+{
+    if (rec->type == TAPE_RECORD_MUTE) {
+        return snprintf(buf, size, "%4s%c_%02d_%10s_%03dM_%04d",
+                        rec->tape_id, rec->side, rec->track_num, rec->audio_id,
+                        (int)(rec->playtime_ms / 1000), (int)(rec->total_ms / 1000));
+    }
+    return snprintf(buf, size, "%4s%c_%02d_%10s_%04d_%04d",
+                    rec->tape_id, rec->side, rec->track_num, rec->audio_id,
+                    (int)(rec->playtime_ms / 1000), (int)(rec->total_ms / 1000));
+}
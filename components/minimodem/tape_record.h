@@ -0,0 +1,142 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_RECORD_H
+#define CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_RECORD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "minimodem_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Tape records come in two formats:
+ *
+ * ASCII, as written to the side files and to tapes recorded by older
+ * firmware, e.g. "0001A_03_b3488ae07e_0125_0481" and the mute line
+ * "0001A_03_b3488ae07e_005M_0481".
+ *
+ * Binary, TAPE_RECORD_MARKER followed by the base64 encoded record below.
+ * It is as long as an ASCII line, so a side file takes the same time on
+ * tape whichever format the encoder sends.
+ *
+ *   byte  0       version (high nibble), type (low nibble)
+ *   bytes 1..4    tape id
+ *   byte  5       side (bit 7 set for 'B'), track number
+ *   bytes 6..10   audio id, 40 bit
+ *   bytes 11..14  play time in ms, mute time for mute records
+ *   bytes 15..18  total time on tape in ms
+ *   bytes 19..20  CRC-16/CCITT-FALSE of bytes 0..18
+ *
+ * All numbers are big endian.
+ *
+ * A tape sent in another modem mode than MINIMODEM_MODE_1200 starts with a
+ * header record, itself sent in MINIMODEM_MODE_1200, and has it again at
+ * the end of each pause. Bytes 1..10 are those of a record next to it,
+ * byte 11 is the minimodem_mode_t of the records and bytes 12..18 are 0.
+ */
+#define TAPE_RECORD_MARKER          '@'
+#define TAPE_RECORD_VERSION         (1)
+#define TAPE_RECORD_BINARY_SIZE     (21)
+
+typedef enum {
+    TAPE_RECORD_PLAY = 0,
+    TAPE_RECORD_MUTE = 1,
+    TAPE_RECORD_FEC = 2,        /*!< Forward error correction slot, see tape_fec.h */
+    TAPE_RECORD_HEADER = 3,     /*!< Modem mode of the records that follow */
+} tape_record_type_t;
+
+typedef struct {
+    tape_record_type_t type;
+    char tape_id[5];
+    char side;                  /*!< 'A' or 'B' */
+    int track_num;
+    char audio_id[11];          /*!< 10 hex digits */
+    uint32_t playtime_ms;       /*!< Position in the audio file, mute time for mute records */
+    uint32_t total_ms;          /*!< Position on the tape side */
+    bool binary;                /*!< Parsed from a binary record */
+} tape_record_t;
+
+/**
+ * Parse an ASCII or binary record, without the line end. An ASCII line is
+ * parsed by position and must have all its separators and digits.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_CRC for a corrupted binary record,
+ *         ESP_ERR_INVALID_VERSION for a binary record of a newer format,
+ *         ESP_ERR_NOT_SUPPORTED for a FEC slot or a header, ESP_FAIL if the line is
+ *         not a record
+ */
+esp_err_t tape_record_parse(const char *line, tape_record_t *rec);
+
+/**
+ * Write the binary record of rec to buf as TAPEFILE_LINE_LENGTH characters
+ * plus the terminating NUL, size must be at least TAPEFILE_LINE_LENGTH + 1.
+ *
+ * @return ESP_ERR_INVALID_ARG if a field does not fit the binary format
+ */
+esp_err_t tape_record_encode(const tape_record_t *rec, char *buf, size_t size);
+
+/**
+ * Decode the TAPE_RECORD_BINARY_SIZE bytes of a binary line and check its
+ * CRC and version, whatever its type.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_CRC, ESP_ERR_INVALID_VERSION, ESP_FAIL if
+ *         the line is not binary
+ */
+esp_err_t tape_record_unpack(const char *line, uint8_t *data);
+
+/**
+ * Fill in the CRC of data and write it to buf as a binary line of
+ * TAPEFILE_LINE_LENGTH characters plus the terminating NUL.
+ */
+void tape_record_pack(uint8_t *data, char *buf);
+
+/**
+ * Bytes 0..18 of the binary record of rec, the CRC is left to
+ * tape_record_pack()
+ *
+ * @return ESP_ERR_INVALID_ARG if a field does not fit the binary format
+ */
+esp_err_t tape_record_to_bytes(const tape_record_t *rec, uint8_t *data);
+
+/**
+ * Record from unpacked binary record bytes
+ *
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED for a FEC slot or a header, ESP_FAIL
+ *         for an unknown type
+ */
+esp_err_t tape_record_from_bytes(const uint8_t *data, tape_record_t *rec);
+
+/**
+ * Write the header announcing mode to buf as TAPEFILE_LINE_LENGTH characters
+ * plus the terminating NUL, rec is a record next to it.
+ *
+ * @return ESP_ERR_INVALID_ARG if a field does not fit the binary format
+ */
+esp_err_t tape_record_encode_header(const tape_record_t *rec, minimodem_mode_t mode,
+                                    char *buf, size_t size);
+
+/**
+ * @return ESP_OK if line is a header of a known mode, ESP_FAIL otherwise
+ */
+esp_err_t tape_record_parse_header(const char *line, minimodem_mode_t *mode);
+
+/**
+ * Write rec as an ASCII line, sub-second times are truncated.
+ *
+ * @return snprintf() result
+ */
+int tape_record_format(const tape_record_t *rec, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_RECORD_H
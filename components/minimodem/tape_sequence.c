@@ -0,0 +1,177 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+#include "tape_sequence.h"
+
+static const char *TAG = "TAPE_SEQUENCE";
+
+// fields of a record that can differ from the expected one
+#define FIELD_TAPE      (1 << 0)    // tape id and side
+#define FIELD_TRACK     (1 << 1)
+#define FIELD_AUDIO     (1 << 2)
+#define FIELD_PLAY      (1 << 3)
+#define FIELD_TOTAL     (1 << 4)
+
+typedef struct {
+    tape_record_t rec;
+    uint32_t now_ms;
+    bool valid;
+} tape_sequence_point_t;
+
+struct tape_sequence {
+    // last record acted on
+    tape_sequence_point_t last;
+    // last record checked, as it arrived
+    tape_sequence_point_t last_received;
+    // the last two records agreed, in the same track
+    bool trusted;
+    unsigned int nrepaired;
+    unsigned int nrejected;
+};
+
+static bool near(uint32_t value, uint32_t expected)
+{
+    const int32_t diff = (int32_t)(value - expected);
+    return diff >= -TAPE_SEQUENCE_TOLERANCE_MS && diff <= TAPE_SEQUENCE_TOLERANCE_MS;
+}
+
+/**
+ * Fields of rec that differ from the record expected at now_ms after p
+ */
+static int mismatched_fields(const tape_sequence_point_t *p, const tape_record_t *rec, uint32_t now_ms)
+{
+    const uint32_t elapsed = now_ms - p->now_ms;
+    int fields = 0;
+
+    if (rec->side != p->rec.side || strcmp(rec->tape_id, p->rec.tape_id) != 0) {
+        fields |= FIELD_TAPE;
+    }
+    if (rec->track_num != p->rec.track_num) {
+        fields |= FIELD_TRACK;
+    }
+    if (strcmp(rec->audio_id, p->rec.audio_id) != 0) {
+        fields |= FIELD_AUDIO;
+    }
+    if (!near(rec->total_ms, p->rec.total_ms + elapsed)) {
+        fields |= FIELD_TOTAL;
+    }
+    // the play time of a mute record is its length
+    if (rec->type == TAPE_RECORD_PLAY && p->rec.type == TAPE_RECORD_PLAY
+        && !near(rec->playtime_ms, p->rec.playtime_ms + elapsed)) {
+        fields |= FIELD_PLAY;
+    }
+    return fields;
+}
+
+/**
+ * rec can follow p, in the same track or as the start of another one
+ */
+static bool follows(const tape_sequence_point_t *p, const tape_record_t *rec, uint32_t now_ms)
+{
+    const int fields = mismatched_fields(p, rec, now_ms);
+    if (fields == 0) {
+        return true;
+    }
+    if ((fields & (FIELD_TAPE | FIELD_TOTAL)) || !(fields & FIELD_TRACK)) {
+        return false;
+    }
+    return rec->type == TAPE_RECORD_MUTE
+           || rec->playtime_ms <= now_ms - p->now_ms + TAPE_SEQUENCE_TOLERANCE_MS;
+}
+
+static void repair(const tape_sequence_point_t *p, tape_record_t *rec, uint32_t now_ms, int field)
+{
+    switch (field) {
+        case FIELD_TAPE:
+            memcpy(rec->tape_id, p->rec.tape_id, sizeof(rec->tape_id));
+            rec->side = p->rec.side;
+            break;
+        case FIELD_TRACK:
+            rec->track_num = p->rec.track_num;
+            break;
+        case FIELD_AUDIO:
+            memcpy(rec->audio_id, p->rec.audio_id, sizeof(rec->audio_id));
+            break;
+        case FIELD_PLAY:
+            // both play records, the play time keeps its distance to the total
+            rec->playtime_ms = p->rec.playtime_ms + (rec->total_ms - p->rec.total_ms);
+            break;
+        case FIELD_TOTAL:
+            if (rec->type == TAPE_RECORD_PLAY && p->rec.type == TAPE_RECORD_PLAY) {
+                rec->total_ms = p->rec.total_ms + (rec->playtime_ms - p->rec.playtime_ms);
+            } else {
+                rec->total_ms = p->rec.total_ms + (now_ms - p->now_ms);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+tape_sequence_t *tape_sequence_create(void)
+{
+    tape_sequence_t *seq = calloc(1, sizeof(tape_sequence_t));
+    if (seq == NULL) {
+        ESP_LOGE(TAG, "Out of memory allocating: tape_sequence_t");
+    }
+    return seq;
+}
+
+void tape_sequence_destroy(tape_sequence_t *seq)
+{
+    free(seq);
+}
+
+void tape_sequence_reset(tape_sequence_t *seq)
+{
+    seq->last.valid = false;
+    seq->last_received.valid = false;
+    seq->trusted = false;
+}
+
+esp_err_t tape_sequence_check(tape_sequence_t *seq, tape_record_t *rec, uint32_t now_ms, bool *repaired)
+{
+    const tape_sequence_point_t received = seq->last_received;
+    seq->last_received.rec = *rec;
+    seq->last_received.now_ms = now_ms;
+    seq->last_received.valid = true;
+    *repaired = false;
+
+    if (!seq->trusted || follows(&seq->last, rec, now_ms)) {
+        // the first record of a track has nothing to agree with yet
+        seq->trusted = seq->last.valid && mismatched_fields(&seq->last, rec, now_ms) == 0;
+    } else if (received.valid && follows(&received, rec, now_ms)) {
+        ESP_LOGI(TAG, "new sequence from %s%c_%02d_%s", rec->tape_id, rec->side, rec->track_num,
+                 rec->audio_id);
+    } else {
+        const int fields = mismatched_fields(&seq->last, rec, now_ms);
+        if (fields & (fields - 1)) {
+            seq->nrejected++;
+            return ESP_ERR_INVALID_STATE;
+        }
+        repair(&seq->last, rec, now_ms, fields);
+        *repaired = true;
+        seq->nrepaired++;
+    }
+    seq->last.rec = *rec;
+    seq->last.now_ms = now_ms;
+    seq->last.valid = true;
+    return ESP_OK;
+}
+
+void tape_sequence_get_stats(const tape_sequence_t *seq, unsigned int *nrepaired,
+                             unsigned int *nrejected)
+{
+    if (nrepaired) {
+        *nrepaired = seq->nrepaired;
+    }
+    if (nrejected) {
+        *nrejected = seq->nrejected;
+    }
+}
@@ -0,0 +1,65 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_SEQUENCE_H
+#define CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_SEQUENCE_H
+
+#include "tape_record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Checks each record against the one expected from the records before it.
+ *
+ * Within a track the tape id, side, track and audio id stay the same and the
+ * play and total times advance with the time between the records. A track
+ * change keeps the tape, side and total time going, changes the track number
+ * and starts the play time again, no later than the time since the previous
+ * record. Mute records carry the next track and only the total time is
+ * checked.
+ *
+ * A record that differs from the expected one in a single field is repaired
+ * from it, and one that differs in more is rejected. When two records in a
+ * row agree with each other but not with the expected one, e.g. after the
+ * tape was changed, the new sequence is taken instead. Nothing is repaired
+ * or rejected until two records of the same track in a row have agreed.
+ */
+// how far a time may be from the expected one, ASCII records only have
+// seconds and copies are up to a second apart
+#define TAPE_SEQUENCE_TOLERANCE_MS  (1500)
+
+typedef struct tape_sequence tape_sequence_t;
+
+tape_sequence_t *tape_sequence_create(void);
+
+void tape_sequence_destroy(tape_sequence_t *seq);
+
+/**
+ * Forget the records so far, e.g. when the tape stops
+ */
+void tape_sequence_reset(tape_sequence_t *seq);
+
+/**
+ * @param rec       Record to check, repaired in place
+ * @param now_ms    Time on tape of the record, e.g. when it arrived
+ * @param repaired  Set to true if rec was changed
+ * @return ESP_OK to act on rec, ESP_ERR_INVALID_STATE if it cannot follow
+ *         the records before it
+ */
+esp_err_t tape_sequence_check(tape_sequence_t *seq, tape_record_t *rec, uint32_t now_ms, bool *repaired);
+
+/**
+ * @param nrepaired Records repaired so far
+ * @param nrejected Records rejected so far
+ */
+void tape_sequence_get_stats(const tape_sequence_t *seq, unsigned int *nrepaired,
+                             unsigned int *nrejected);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_COMPONENTS_MINIMODEM_TAPE_SEQUENCE_H
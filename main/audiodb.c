@@ -131,6 +131,47 @@ static bool audiodb_file_exists(const char *filepath)
     return found;
 }
 
+/**
+ * Split a DB line into its columns, in place
+ * @param line HASH\tDUR\tBIT\tPATH[\tEXTRA]
+ * @return ESP_FAIL if a column is missing
+ */
+static esp_err_t audiodb_split_line(char *line, char **hash, int *duration, int *avg_bitrate, char **path)
+{
+    char *ptr = line;
+
+    // 1. Get Hash
+    char *next_tab = strchr(ptr, '\t');
+    if (!next_tab) return ESP_FAIL;
+    *next_tab = 0;
+    *hash = ptr;
+    ptr = next_tab + 1;
+
+    // 2. Get Duration
+    next_tab = strchr(ptr, '\t');
+    if (!next_tab) return ESP_FAIL;
+    *next_tab = 0;
+    *duration = atoi(ptr);
+    ptr = next_tab + 1;
+
+    // 3. Get Bitrate
+    next_tab = strchr(ptr, '\t');
+    if (!next_tab) return ESP_FAIL;
+    *next_tab = 0;
+    *avg_bitrate = atoi(ptr);
+    ptr = next_tab + 1;
+
+    // 4. Get Path
+    // It might end with newline OR tab (if extra columns exist)
+    char *path_end = ptr;
+    while (*path_end != 0 && *path_end != '\t' && *path_end != '\n' && *path_end != '\r') {
+        path_end++;
+    }
+    *path_end = 0;
+    *path = ptr;
+    return ESP_OK;
+}
+
 /**
  * Get file info from the DB
  * @param audioid input audioid (10 characters hash)
@@ -160,54 +201,23 @@ esp_err_t audiodb_file_for_id(const char *audioid, char *filepath, int *duration
 
     // read DB line by line
     while (fgets(line_buf, AUDIODB_MAX_LINE_LENGTH, fd_db) != NULL) {
-        // Parse line: HASH\tDUR\tBIT\tPATH[\tEXTRA]
-        char *ptr = line_buf;
-        
-        // 1. Get Hash
-        char *line_hash = ptr;
-        char *next_tab = strchr(ptr, '\t');
-        if (!next_tab) continue;
-        *next_tab = 0;
-        
-        if (strcmp(audioid, line_hash) == 0) {
-            // Found it! Parse the rest.
-            ptr = next_tab + 1;
-            
-            // 2. Get Duration
-            next_tab = strchr(ptr, '\t');
-            if (!next_tab) continue;
-            *next_tab = 0;
-            int line_dur = atoi(ptr);
-            ptr = next_tab + 1;
-            
-            // 3. Get Bitrate
-            next_tab = strchr(ptr, '\t');
-            if (!next_tab) continue;
-            *next_tab = 0;
-            int line_rate = atoi(ptr);
-             ptr = next_tab + 1;
-            
-            // 4. Get Path
-            char *line_path = ptr;
-            // It might end with newline OR tab (if extra columns exist)
-            char *path_end = line_path;
-            while (*path_end != 0 && *path_end != '\t' && *path_end != '\n' && *path_end != '\r') {
-                path_end++;
-            }
-            *path_end = 0;
-            
-            if (filepath != NULL) {
-                strcpy(filepath, line_path);
-            }
-            if (duration != NULL) {
-                *duration = line_dur;
-            }
-            if (avg_bitrate != NULL) {
-                *avg_bitrate = line_rate;
-            }
-            ret = ESP_OK;
-            break;
+        char *line_hash, *line_path;
+        int line_dur, line_rate;
+        if (audiodb_split_line(line_buf, &line_hash, &line_dur, &line_rate, &line_path) != ESP_OK
+            || strcmp(audioid, line_hash) != 0) {
+            continue;
+        }
+        if (filepath != NULL) {
+            strcpy(filepath, line_path);
+        }
+        if (duration != NULL) {
+            *duration = line_dur;
+        }
+        if (avg_bitrate != NULL) {
+            *avg_bitrate = line_rate;
         }
+        ret = ESP_OK;
+        break;
     }
 
     free(line_buf);
@@ -216,6 +226,57 @@ esp_err_t audiodb_file_for_id(const char *audioid, char *filepath, int *duration
     return ret;
 }
 
+/**
+ * Get the durations of several files from the DB in one pass over it
+ * @param audioids input audioids (10 characters hash)
+ * @param count number of audioids
+ * @param durations output duration in seconds of each audioid, -1 if it is not in the DB
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if an audioid is not in the DB, ESP_FAIL if the DB could not be read
+ */
+esp_err_t audiodb_durations_for_ids(const char *const *audioids, int count, int *durations)
+{
+    FILE *fd_db;
+    char *line_buf;
+    int nfound = 0;
+
+    for (int i = 0; i < count; i++) {
+        durations[i] = -1;
+    }
+
+    line_buf = malloc(AUDIODB_MAX_LINE_LENGTH);
+    if (line_buf == NULL) {
+        return ESP_FAIL;
+    }
+
+    fd_db = fopen(FILE_AUDIODB, "r");
+    if (!fd_db) {
+        ESP_LOGE(TAG, "Failed to open DB : %s", FILE_AUDIODB);
+        free(line_buf);
+        return ESP_FAIL;
+    }
+
+    // read DB line by line until all are found
+    while (nfound < count && fgets(line_buf, AUDIODB_MAX_LINE_LENGTH, fd_db) != NULL) {
+        char *line_hash, *line_path;
+        int line_dur, line_rate;
+        if (audiodb_split_line(line_buf, &line_hash, &line_dur, &line_rate, &line_path) != ESP_OK) {
+            continue;
+        }
+        // an id may be on a side more than once
+        for (int i = 0; i < count; i++) {
+            if (durations[i] < 0 && strcmp(audioids[i], line_hash) == 0) {
+                durations[i] = line_dur;
+                nfound++;
+            }
+        }
+    }
+
+    free(line_buf);
+    fclose(fd_db);
+
+    return nfound == count ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
 static void audiodb_sdcard_url_save_cb(void *user_data, char *url)
 {
     if (url == NULL) {
@@ -10,5 +10,6 @@
 esp_err_t audiodb_scan(void);
 esp_err_t audiodb_stop(void);
 esp_err_t audiodb_file_for_id(const char *audioid, char *filepath, int *duration, int *avg_bitrate);
+esp_err_t audiodb_durations_for_ids(const char *const *audioids, int count, int *durations);
 
 #endif //CASSETTEFLOW_FIRMWARE_MAIN_AUDIODB_H
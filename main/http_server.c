@@ -17,6 +17,8 @@
 #include <ctype.h>
 #include "pipeline_decode.h"
 #include "config.h"
+#include "modem_profile.h"
+#include "tape_fec.h"
 
 static const char *TAG = "cf_http_server";
 
@@ -387,6 +389,9 @@ static esp_err_t handler_uri_start(httpd_req_t *req)
     size_t buf_len;
     esp_err_t err = ESP_FAIL;
     char param_side[32] = "";
+    char param_modem[32] = "";
+    char param_records[32] = "";
+    char param_fec[32] = "";
 
     /* Read URL query string length and allocate memory for length + 1,
      * extra byte for null termination */
@@ -400,12 +405,52 @@ static esp_err_t handler_uri_start(httpd_req_t *req)
             if (httpd_query_key_value(buf, "side", param_side, sizeof(param_side)) == ESP_OK) {
                 ESP_LOGI(TAG, "Found URL query parameter => side=%s", param_side);
             }
+            if (httpd_query_key_value(buf, "modem", param_modem, sizeof(param_modem)) == ESP_OK) {
+                ESP_LOGI(TAG, "Found URL query parameter => modem=%s", param_modem);
+            }
+            if (httpd_query_key_value(buf, "records", param_records, sizeof(param_records)) == ESP_OK) {
+                ESP_LOGI(TAG, "Found URL query parameter => records=%s", param_records);
+            }
+            if (httpd_query_key_value(buf, "fec", param_fec, sizeof(param_fec)) == ESP_OK) {
+                ESP_LOGI(TAG, "Found URL query parameter => fec=%s", param_fec);
+            }
         }
         free(buf);
     }
 
+    minimodem_mode_t modem_mode;
+    if (param_modem[0] == 0 || strcmp(param_modem, "1200") == 0) {
+        modem_mode = MINIMODEM_MODE_1200;
+    } else if (strcmp(param_modem, "4fsk") == 0) {
+        modem_mode = MINIMODEM_MODE_4FSK;
+    } else {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown modem mode");
+        return ESP_OK;
+    }
+
+    // ASCII lines unless asked otherwise, older decoders read nothing else
+    bool binary_records;
+    if (param_records[0] == 0 || strcmp(param_records, "ascii") == 0) {
+        binary_records = false;
+    } else if (strcmp(param_records, "binary") == 0) {
+        binary_records = true;
+    } else {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown record format");
+        return ESP_OK;
+    }
+    int fec_data_records = binary_records ? TAPE_FEC_DATA_RECORDS : 0;
+    if (param_fec[0] != 0) {
+        char *end;
+        long value = strtol(param_fec, &end, 10);
+        if (!binary_records || *end != 0 || value < 0 || value > TAPE_FEC_MAX_DATA) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "fec needs records=binary and 0..32 seconds");
+            return ESP_OK;
+        }
+        fec_data_records = (int)value;
+    }
+
     if (strlen(param_side) == 1) {
-        err = pipeline_start_encoding(param_side[0]);
+        err = pipeline_start_encoding(param_side[0], modem_mode, binary_records, fec_data_records);
     }
 
     if (err == ESP_OK) {
@@ -614,6 +659,60 @@ static esp_err_t handler_uri_vol(httpd_req_t *req)
     return ESP_OK;
 }
 
+/**
+ * Without a query return the modem profile. With key=value pairs of
+ * minimodem_profile.h set those fields, the profile is saved and used from
+ * the next start.
+ */
+static esp_err_t handler_uri_modem(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "%s", __FUNCTION__);
+
+    esp_err_t err = ESP_OK;
+    minimodem_profile_t profile;
+    char text[MINIMODEM_PROFILE_TEXT_SIZE];
+
+    modem_profile_get(&profile);
+
+    size_t buf_len = httpd_req_get_url_query_len(req) + 1;
+    if (buf_len > 1) {
+        char *buf = malloc(buf_len);
+        if (buf == NULL) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+            return ESP_OK;
+        }
+        if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK) {
+            ESP_LOGI(TAG, "Found URL query => %s", buf);
+            char *saveptr;
+            for (char *pair = strtok_r(buf, "&", &saveptr); pair != NULL && err == ESP_OK;
+                 pair = strtok_r(NULL, "&", &saveptr)) {
+                char *value = strchr(pair, '=');
+                if (value == NULL) {
+                    err = ESP_ERR_INVALID_ARG;
+                    break;
+                }
+                *value++ = '\0';
+                err = minimodem_profile_set(&profile, pair, value);
+            }
+        }
+        free(buf);
+        if (err == ESP_OK) {
+            err = modem_profile_set(&profile);
+        }
+    }
+
+    if (err == ESP_OK) {
+        minimodem_profile_format(&profile, text, sizeof(text));
+        httpd_resp_set_type(req, "text/plain");
+        httpd_resp_sendstr(req, text);
+    } else if (err == ESP_FAIL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save modem profile");
+    } else {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid modem profile");
+    }
+    return ESP_OK;
+}
+
 static const httpd_uri_t uri_root = {
     .uri       = "/",
     .method    = HTTP_GET,
@@ -705,6 +804,13 @@ static const httpd_uri_t uri_vol = {
     .user_ctx  = NULL
 };
 
+static const httpd_uri_t uri_modem = {
+    .uri       = "/modem",
+    .method    = HTTP_GET,
+    .handler   = handler_uri_modem,
+    .user_ctx  = NULL
+};
+
 static httpd_handle_t start_webserver(void)
 {
     httpd_handle_t server = NULL;
@@ -731,6 +837,7 @@ static httpd_handle_t start_webserver(void)
         httpd_register_uri_handler(server, &uri_output);
         httpd_register_uri_handler(server, &uri_play);
         httpd_register_uri_handler(server, &uri_vol);
+        httpd_register_uri_handler(server, &uri_modem);
         return server;
     }
 
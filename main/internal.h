@@ -22,6 +22,9 @@ enum cf_mode
 // files with a line for tapeDB (in the same format)
 #define FILENAME_SIDE_A_TAPEDB     "/sdcard/sideA_tapedb.txt"
 #define FILENAME_SIDE_B_TAPEDB     "/sdcard/sideB_tapedb.txt"
+// run-length coded side files, see tapefile_timeline.h
+#define FILENAME_SIDE_A_TIMELINE   "/sdcard/sideA.tl"
+#define FILENAME_SIDE_B_TIMELINE   "/sdcard/sideB.tl"
 
 #define FILE_AUDIODB      "/sdcard/audiodb.txt"
 #define FILE_TAPEDB     "/sdcard/tapedb.txt"
@@ -31,4 +34,7 @@ enum cf_mode
 
 #define FILE_WIFI_CONFIG "/sdcard/wifi_config.txt"
 
+// modem parameters, key=value lines, see minimodem_profile.h
+#define FILE_MODEM_PROFILE "/sdcard/modem.txt"
+
 #endif //CASSETTEFLOW_FIRMWARE_MAIN_INTERNAL_H
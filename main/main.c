@@ -17,6 +17,7 @@
 #include "pipeline.h"
 #include "led.h"
 #include "raw_queue.h"
+#include "modem_profile.h"
 
 static const char *TAG = "cf_main";
 
@@ -194,6 +195,10 @@ void app_main(void)
     ESP_LOGI(TAG, "[1.3] Scan for new MP3 files on SD card");
     ESP_ERROR_CHECK(audiodb_scan());
 
+    ESP_LOGI(TAG, "[1.4] Load modem profile");
+    // a bad file leaves the defaults, they can be set again over http
+    modem_profile_load();
+
     ESP_LOGI(TAG, "[ 3 ] Connect to the network");
     ESP_ERROR_CHECK(network_connect());
 
@@ -0,0 +1,74 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdio.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include "modem_profile.h"
+#include "internal.h"
+
+static const char *TAG = "cf_modem_profile";
+
+static minimodem_profile_t current_profile = MINIMODEM_PROFILE_DEFAULT();
+// set from the http server task, read by the pipeline starts
+static portMUX_TYPE profile_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t modem_profile_load(void)
+{
+    char text[MINIMODEM_PROFILE_TEXT_SIZE * 2];
+    minimodem_profile_t profile = MINIMODEM_PROFILE_DEFAULT();
+
+    FILE *fd = fopen(FILE_MODEM_PROFILE, "r");
+    if (!fd) {
+        ESP_LOGI(TAG, "No %s, using the default modem profile", FILE_MODEM_PROFILE);
+        return ESP_OK;
+    }
+    size_t len = fread(text, 1, sizeof(text) - 1, fd);
+    fclose(fd);
+    text[len] = '\0';
+
+    if (minimodem_profile_parse(text, &profile) != ESP_OK) {
+        ESP_LOGE(TAG, "Error reading modem profile from %s", FILE_MODEM_PROFILE);
+        return ESP_FAIL;
+    }
+    portENTER_CRITICAL(&profile_lock);
+    current_profile = profile;
+    portEXIT_CRITICAL(&profile_lock);
+    ESP_LOGI(TAG, "Modem profile loaded from %s", FILE_MODEM_PROFILE);
+    return ESP_OK;
+}
+
+void modem_profile_get(minimodem_profile_t *profile)
+{
+    portENTER_CRITICAL(&profile_lock);
+    *profile = current_profile;
+    portEXIT_CRITICAL(&profile_lock);
+}
+
+esp_err_t modem_profile_set(const minimodem_profile_t *profile)
+{
+    char text[MINIMODEM_PROFILE_TEXT_SIZE];
+
+    if (minimodem_profile_check(profile) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    minimodem_profile_format(profile, text, sizeof(text));
+
+    FILE *fd = fopen(FILE_MODEM_PROFILE, "w");
+    if (!fd) {
+        ESP_LOGE(TAG, "Failed to open file : %s", FILE_MODEM_PROFILE);
+        return ESP_FAIL;
+    }
+    const bool written = fputs(text, fd) >= 0;
+    if (fclose(fd) != 0 || !written) {
+        ESP_LOGE(TAG, "Failed to write file : %s", FILE_MODEM_PROFILE);
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&profile_lock);
+    current_profile = *profile;
+    portEXIT_CRITICAL(&profile_lock);
+    ESP_LOGI(TAG, "Modem profile saved, applied on the next start");
+    return ESP_OK;
+}
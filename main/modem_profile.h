@@ -0,0 +1,29 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_MAIN_MODEM_PROFILE_H
+#define CASSETTEFLOW_FIRMWARE_MAIN_MODEM_PROFILE_H
+
+#include <esp_err.h>
+#include "minimodem_profile.h"
+
+/**
+ * Load FILE_MODEM_PROFILE, the defaults stay if there is none
+ * @return ESP_OK or ESP_FAIL if the file is malformed
+ */
+esp_err_t modem_profile_load(void);
+
+/**
+ * Copy of the profile the next encode or decode pipeline starts with
+ */
+void modem_profile_get(minimodem_profile_t *profile);
+
+/**
+ * Save profile to FILE_MODEM_PROFILE and use it from the next pipeline start
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if it fails minimodem_profile_check() or
+ *         ESP_FAIL if it could not be saved
+ */
+esp_err_t modem_profile_set(const minimodem_profile_t *profile);
+
+#endif //CASSETTEFLOW_FIRMWARE_MAIN_MODEM_PROFILE_H
@@ -28,6 +28,9 @@ ESP_EVENT_DEFINE_BASE(PIPELINE_EVENTS);
 
 static enum cf_mode pipeline_mode = MODE_DECODE;
 static char current_encoding_side;
+static minimodem_mode_t current_encoding_mode = MINIMODEM_MODE_1200;
+static bool current_encoding_binary = false;
+static int current_encoding_fec = 0;
 audio_event_iface_handle_t evt;
 
 static void pipeline_event_handler(void *handler_args, esp_event_base_t base, int32_t id, void *event_data)
@@ -83,7 +86,8 @@ void pipeline_handle_play(void)
             } else {
                 // check if mixtape file is present
                 if (tapefile_is_present(current_encoding_side)) {
-                    pipeline_start_encoding(current_encoding_side);
+                    pipeline_start_encoding(current_encoding_side, current_encoding_mode, current_encoding_binary,
+                                            current_encoding_fec);
                 }
             }
             break;
@@ -174,20 +178,20 @@ void pipeline_current_info_str(char *str, size_t str_len)
  * Only for MODE_ENCODE
  * @return
  */
-esp_err_t pipeline_start_encoding(const char side)
+esp_err_t pipeline_start_encoding(const char side, minimodem_mode_t modem_mode, bool binary_records,
+                                  int fec_data_records)
 {
     ESP_LOGI(TAG, "start_encoding");
 
-    char file_uri[128];
-
     current_encoding_side = side;
-
-    snprintf(file_uri, sizeof(file_uri), "file:/%s", tapefile_get_path(side));
+    current_encoding_mode = modem_mode;
+    current_encoding_binary = binary_records;
+    current_encoding_fec = fec_data_records;
 
     // switch to ENCODE mode if needed
     pipeline_set_mode(MODE_ENCODE);
 
-    return pipeline_encode_start(evt, file_uri);
+    return pipeline_encode_start(evt, side, modem_mode, binary_records, fec_data_records);
 }
 
 esp_err_t pipeline_stop(void)
@@ -215,7 +219,7 @@ esp_err_t pipeline_start_playing(const char side)
 
     current_encoding_side = side;
 
-    pipeline_playback_set_filename(tapefile_get_path(side));
+    pipeline_playback_set_side(side);
 
     pipeline_set_mode(MODE_PLAYBACK);
 
@@ -9,6 +9,7 @@
 #include "esp_event.h"
 #include "audio_pipeline.h"
 #include "internal.h"
+#include "minimodem_config.h"
 
 extern esp_event_loop_handle_t pipeline_event_loop;
 
@@ -33,7 +34,7 @@ void pipeline_handle_play(void);
 void pipeline_handle_set(void);
 void pipeline_set_mode(enum cf_mode mode);
 void pipeline_current_info_str(char *str, size_t str_len);
-esp_err_t pipeline_start_encoding(char side);
+esp_err_t pipeline_start_encoding(char side, minimodem_mode_t modem_mode, bool binary_records, int fec_data_records);
 esp_err_t pipeline_stop(void);
 esp_err_t pipeline_init(audio_event_iface_handle_t event_handle);
 esp_err_t pipeline_main(void);
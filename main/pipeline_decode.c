@@ -17,12 +17,17 @@
 #include "pipeline.h"
 #include "minimodem_config.h"
 #include "minimodem_decoder.h"
-#include "filter_line_reader.h"
+#include "tape_record.h"
+#include "tape_fec.h"
+#include "tape_combine.h"
+#include "tape_sequence.h"
 #include "audiodb.h"
 #include "raw_queue.h"
 #include "pipeline_output.h"
 #include "bt.h"
 #include "tapefile.h"
+#include "tapefile_timeline.h"
+#include "modem_profile.h"
 
 static const char *TAG = "cf_pipeline_decode";
 
@@ -47,8 +52,9 @@ static audio_element_handle_t output_stream_writer = NULL;
 static audio_element_handle_t fatfs_stream_reader = NULL,
     mp3_decoder = NULL, flac_decoder = NULL,
     equalizer = NULL, resample_for_play = NULL;
-static audio_element_handle_t i2s_stream_reader = NULL, resample_for_record = NULL, minimodem_decoder = NULL,
-    filter_line_reader = NULL;
+static audio_element_handle_t i2s_stream_reader = NULL, minimodem_decoder = NULL;
+// kept across starts, rebuilt only when the modem profile changes
+static minimodem_decoder_struct *minimodem_str = NULL;
 static audio_element_state_t el_state = AEL_STATE_STOPPED;
 // -13 dB is minimum. 0 - no gain.
 // The size of gain array should be the multiplication of NUMBER_BAND and number channels of audio stream data.
@@ -63,12 +69,17 @@ static char last_line_from_minimodem[64] = {0};
 // in microseconds
 static int64_t last_line_from_minimodem_time_us = 0;
 
-static FILE *g_mapped_file = NULL;
 static char g_mapped_side = 0;
-// We track the last read line's timestamp to optimize sequential access
-static int g_mapped_last_total_idx = -1;
+// the side file's record for each second
+static tapefile_timeline_t *g_mapped_timeline = NULL;
 
 static bool pause_decode = false;
+// records protected by forward error correction, see tape_fec.h
+static tape_fec_decoder_t *tape_fec = NULL;
+// copies of each second's record combined into one, see tape_combine.h
+static tape_combine_t *tape_combine = NULL;
+// records checked against the ones before them, see tape_sequence.h
+static tape_sequence_t *tape_sequence = NULL;
 static bool dct_mapping_enabled = false;
 static int dct_mapping_offset = 0;
 static bool g_reload_mapped_file = false;
@@ -292,6 +303,31 @@ static esp_err_t create_playback_pipeline(void)
     return ESP_OK;
 }
 
+/**
+ * Output of minimodem_decoder, the last element of the record pipeline.
+ * Every call is one line including its '\n' (see MINIMODEM_LINE_MAX_LENGTH);
+ * it is handed to the event loop as the element's uri with a position report.
+ */
+static audio_element_err_t minimodem_line_write_cb(audio_element_handle_t el, char *buf, int len,
+                                                   TickType_t wait_time, void *ctx)
+{
+    char line[MINIMODEM_LINE_MAX_LENGTH];
+    int line_length = len;
+    if (line_length > 0 && buf[line_length - 1] == '\n') {
+        line_length--;
+    }
+    if ((size_t)line_length >= sizeof(line)) {
+        line_length = sizeof(line) - 1;
+    }
+    memcpy(line, buf, line_length);
+    line[line_length] = 0;
+
+    audio_element_set_uri(el, line);
+    // send event to the main loop
+    audio_element_report_pos(el);
+    return len;
+}
+
 static esp_err_t create_record_pipeline(void)
 {
     ESP_LOGI(TAG, "%s", __FUNCTION__ );
@@ -318,24 +354,27 @@ static esp_err_t create_record_pipeline(void)
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "[2] Create resampler");
-    rsp_filter_cfg_t rsp_cfg = DEFAULT_RESAMPLE_FILTER_CONFIG();
-    rsp_cfg.src_rate = PLAYBACK_RATE;
-    rsp_cfg.src_ch = 2;
-    rsp_cfg.dest_rate = 16000;
-    rsp_cfg.dest_ch = 2;
-    rsp_cfg.mode = RESAMPLE_DECODE_MODE;
-    rsp_cfg.complexity = 0;
-    rsp_cfg.task_core = 1;
-    rsp_cfg.task_prio = 10;
-    resample_for_record = rsp_filter_init(&rsp_cfg);
-    if (resample_for_record == NULL) {
-        ESP_LOGE(TAG, "error init resampler");
-        return ESP_FAIL;
+    // minimodem_decoder decimates PLAYBACK_RATE stereo to its 16 kHz mono
+    // itself, see MINIMODEM_DECIMATION
+    ESP_LOGI(TAG, "[2] Create minimodem_decoder");
+    minimodem_profile_t profile;
+    modem_profile_get(&profile);
+    if (minimodem_str != NULL && !minimodem_profile_equal(&minimodem_str->profile, &profile)) {
+        ESP_LOGI(TAG, "modem profile changed");
+        minimodem_receive_destroy(minimodem_str);
+        minimodem_str = NULL;
+    }
+    if (minimodem_str == NULL) {
+        minimodem_str = minimodem_receive_cfg_profile(&profile);
+        if (minimodem_str == NULL) {
+            ESP_LOGE(TAG, "error init minimodem_str");
+            return ESP_FAIL;
+        }
+    } else {
+        minimodem_receive_reset(minimodem_str);
     }
-
-    ESP_LOGI(TAG, "[3] Create minimodem_decoder");
     minimodem_decoder_cfg_t minimodem_decoder_cfg = DEFAULT_MINIMODEM_DECODER_CONFIG();
+    minimodem_decoder_cfg.minimodem_str = minimodem_str;
     minimodem_decoder_cfg.task_prio = 10;
     minimodem_decoder_cfg.stack_in_ext = false; // keep minimodem's stack in internal memory
     minimodem_decoder = minimodem_decoder_init(&minimodem_decoder_cfg);
@@ -344,28 +383,18 @@ static esp_err_t create_record_pipeline(void)
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "[4] Create filter_line_reader");
-    filter_line_cfg_t line_reader_cfg = DEFAULT_FILTER_LINE_CONFIG();
-    line_reader_cfg.task_prio = 10;
-    line_reader_cfg.stack_in_ext = true;
-    filter_line_reader = filter_line_reader_init(&line_reader_cfg);
-    if (filter_line_reader == NULL) {
-        ESP_LOGE(TAG, "error init filter_line_reader");
-        return ESP_FAIL;
-    }
-
-    ESP_LOGI(TAG, "[5] Register all elements to audio pipeline");
+    ESP_LOGI(TAG, "[3] Register all elements to audio pipeline");
     audio_pipeline_register(pipeline_for_record, i2s_stream_reader, "i2s");
-    audio_pipeline_register(pipeline_for_record, resample_for_record, "resample");
     audio_pipeline_register(pipeline_for_record, minimodem_decoder, "minimodem");
 #if 0
     audio_pipeline_register(pipeline_for_record, raw_reader, "raw_read");
 #endif
-    audio_pipeline_register(pipeline_for_record, filter_line_reader, "line_reader");
 
-    ESP_LOGI(TAG, "[6] Link it together i2s_stream-->resample->minimodem-->line_reader");
-    const char *link_tag[4] = {"i2s", "resample", "minimodem", "line_reader"};
-    audio_pipeline_link(pipeline_for_record, link_tag, 4);
+    ESP_LOGI(TAG, "[4] Link it together i2s_stream-->minimodem-->line callback");
+    const char *link_tag[2] = {"i2s", "minimodem"};
+    audio_pipeline_link(pipeline_for_record, link_tag, 2);
+    // minimodem writes complete lines, they go straight to the event loop
+    audio_element_set_write_cb(minimodem_decoder, minimodem_line_write_cb, NULL);
 
     return ESP_OK;
 }
@@ -373,172 +402,58 @@ static esp_err_t create_record_pipeline(void)
 
 
 
-static esp_err_t find_mapped_line(const char side, int total_idx, char *out_line) {
-    // 1. Open/Reset file if needed
+static void close_mapped_file(void)
+{
+    tapefile_timeline_free(g_mapped_timeline);
+    g_mapped_timeline = NULL;
+}
+
+static esp_err_t find_mapped_record(const char side, int total_idx, tape_record_t *rec) {
+    // 1. Load/Reset the side file's timeline if needed
     if (g_reload_mapped_file) {
         ESP_LOGI(TAG, "Reloading mapped file requested.");
-        if (g_mapped_file != NULL) {
-            fclose(g_mapped_file);
-            g_mapped_file = NULL;
-        }
-        g_mapped_last_total_idx = -1;
+        close_mapped_file();
         g_reload_mapped_file = false;
     }
 
-    if (g_mapped_file != NULL && g_mapped_side != side) {
-        fclose(g_mapped_file);
-        g_mapped_file = NULL;
-        g_mapped_last_total_idx = -1;
+    if (g_mapped_timeline != NULL && g_mapped_side != side) {
+        close_mapped_file();
     }
 
-    if (g_mapped_file == NULL) {
-        const char *filepath = tapefile_get_path(side);
-        g_mapped_file = fopen(filepath, "r");
-        if (!g_mapped_file) {
-            ESP_LOGE(TAG, "Failed to open side file: %s", filepath);
+    if (g_mapped_timeline == NULL) {
+        g_mapped_timeline = tapefile_timeline_load(side);
+        if (!g_mapped_timeline) {
+            ESP_LOGE(TAG, "Failed to load side file: %s", tapefile_get_path(side));
             return ESP_FAIL;
         }
         g_mapped_side = side;
-        g_mapped_last_total_idx = -1;
-    }
-
-    // 2. Check if we need to rewind
-    // If we are looking for a timestamp BEFORE where we last were, we must rewind.
-    // (Unless it's the same index, in which case we might just need to re-read? 
-    //  But typically we read line-by-line. If we just read line X at T, and we want T again, 
-    //  we might be at T+1 in the file. So safely, we should rewind if total_idx <= g_mapped_last_total_idx.
-    //  However, rewinding every time for the same second (which has 4 DCT lines) is inefficient.
-    //  BUT, `g_mapped_last_total_idx` tracks the line we *just read*.
-    //  So if we read T=100. File ptr is at lines for T=101.
-    //  Next request T=100. We are ahead. We MUST rewind.
-    //  Optimization: If we have a mechanism to peek or buffer, we could avoid this. 
-    //  Given the file is small, let's try just rewind. 
-    //  Improving this: Since 1s has 4 lines, maybe we shouldn't advance blindly?
-    //  Actually, we scan UNTIL we find a match.
-    //  If we found a match for T=100, we leave the file ptr at the NEXT line.
-    //  If next request is T=100, we check the next line. 
-    //  If next line is ALSO T=100 (which it is, for audio), we match!
-    //  So we only rewind if total_idx < g_mapped_last_total_idx.
-    
-    if (total_idx < g_mapped_last_total_idx) {
-        ESP_LOGD(TAG, "Rewinding... target %d < last %d", total_idx, g_mapped_last_total_idx);
-        fseek(g_mapped_file, 0, SEEK_SET);
-        g_mapped_last_total_idx = -1;
     }
 
-    char line[128];
-    long pos_before_line;
-    
-    // 3. Scan forward
-    while (1) {
-        pos_before_line = ftell(g_mapped_file);
-        if (!fgets(line, sizeof(line), g_mapped_file)) {
-            // End of file
-            break;
-        }
-        
-        // clean line
-        line[strcspn(line, "\r\n")] = 0;
-        
-        char tape_id[5];
-        char line_side;
-        int track_num;
-        char mp3_id[11];
-        int playtime_seconds;
-        int playtime_total_seconds;
-        int mute_seconds;
-        bool match = false;
-        
-        // Check Standard Audio Line
-        if (sscanf(line, "%4s%c_%02d_%10s_%04d_%04d",
-                   tape_id, &line_side, &track_num, mp3_id, &playtime_seconds, &playtime_total_seconds) == 6) {
-             
-             if (playtime_total_seconds == total_idx) {
-                 match = true;
-             } else if (playtime_total_seconds > total_idx) {
-                 // We passed it. Target not found (or we missed it).
-                 // But wait, since we only move forward, this implies it's not here.
-                 // However, we must be careful about the "replicated 4 times" logic.
-                 // If total_idx=100. We find 101. 
-                 // Then 100 is effectively missing from the current position onwards.
-                 // Since we handle rewind at the top, if we are here, we started from <= target.
-                 // So if we see > target, we failed.
-                 // BUT: We should push back the line we just read so we don't skip it for next time?
-                 // fseek(g_mapped_file, pos_before_line, SEEK_SET);
-                 // No, if we return FAIL, caller might handle it.
-                 // But to keep state consistent, probably best to rewind one line?
-                 // Let's just break and return FAIL.
-                 // But update last_idx?
-                 g_mapped_last_total_idx = playtime_total_seconds; // we are at 101
-                 // We need to rewind this line so next call for 101 captures it!
-                 fseek(g_mapped_file, pos_before_line, SEEK_SET);
-                 return ESP_FAIL; 
-             }
-             
-             // Update our tracking
-             g_mapped_last_total_idx = playtime_total_seconds;
-        } 
-        // Check Mute Line
-        else if (sscanf(line, "%4s%c_%02d_%10s_%03dM_%04d",
-                   tape_id, &line_side, &track_num, mp3_id, &mute_seconds, &playtime_total_seconds) == 6) {
-             
-             // Mute line acts as a range [playtime_total_seconds, playtime_total_seconds + mute_seconds)
-             if (total_idx >= playtime_total_seconds && total_idx < (playtime_total_seconds + mute_seconds)) {
-                 match = true;
-             } else if (playtime_total_seconds > total_idx) {
-                 // We passed it.
-                 g_mapped_last_total_idx = playtime_total_seconds;
-                 fseek(g_mapped_file, pos_before_line, SEEK_SET);
-                 return ESP_FAIL;
-             }
-             
-             // Update tracking. 
-             // If we matched, we are conceptually "at" total_idx.
-             // If we are inside the mute range, say [100, 104), and target is 102.
-             // Next call 103. We need to match this SAME line again.
-             // So we must REWIND this line if we want to match it again!
-             // Mute lines appear only ONCE.
-             // So if we consumed it for 100, we lose it for 101, 102, 103!
-             // CRITICAL FIX: If matched MUTE line, we must rewind so next call sees it too?
-             // Or we just don't advance?
-             // If we fseek back, we just re-read it endlessly. That's fine if we increment target.
-             
-             if (match) {
-                 // For mute, the SINGLE line covers multiple seconds. 
-                 // So we must NOT consume it until we are past it.
-                 // Reset file ptr to start of this line.
-                 fseek(g_mapped_file, pos_before_line, SEEK_SET);
-                 g_mapped_last_total_idx = total_idx; // Effectively we are here
-             } else {
-                 // If we didn't match (meaning target < start of mute, which shouldn't happen if we scan sequentially? 
-                 // or target >= start+duration -> we passed it).
-                 g_mapped_last_total_idx = playtime_total_seconds + mute_seconds - 1; 
-             }
-        }
-
-        if (match) {
-            strcpy(out_line, line);
-            return ESP_OK;
-        }
-    }
-
-    return ESP_FAIL;
+    // 2. Look the record up, whichever way the tape moved
+    return tapefile_timeline_find(g_mapped_timeline, total_idx, rec);
 }
 
-/**
- * Handle line of decoded text from minimodem
- * @param line
- * @return
- */
 /**
  * Handle line of decoded text from minimodem
  * @param line
  * @param prefix prefix for raw output (e.g. "--> " for mapped lines)
+ * @param rec the record parsed from line
+ * @param parse_err tape_record_parse() result for line
  * @return
  */
-static esp_err_t pipeline_decode_handle_line_internal(const char *line, const char *prefix)
+static esp_err_t pipeline_decode_handle_parsed_line(const char *line, const char *prefix,
+                                                    const tape_record_t *parsed, esp_err_t parse_err)
 {
     const size_t line_len = strlen(line);
+    const tape_record_t rec = *parsed;
+    char ascii_line[TAPEFILE_LINE_LENGTH + 1];
+
+    // a binary record is reported as its ASCII line, so clients see the same
+    // format whichever way the tape was recorded
+    if (parse_err == ESP_OK && rec.binary) {
+        tape_record_format(&rec, ascii_line, sizeof(ascii_line));
+        line = ascii_line;
+    }
 
     raw_queue_message_t msg;
     if (prefix && prefix[0] != 0) {
@@ -556,18 +471,17 @@ static esp_err_t pipeline_decode_handle_line_internal(const char *line, const ch
         return ESP_FAIL;
     }
 
-    char tape_id[5];
-    char side;
-    int track_num;
-    char mp3_id[11];
-    int playtime_seconds;   // seconds
-    int playtime_total_seconds; // seconds
-    int mute_seconds = 0;
+    if (parse_err == ESP_ERR_INVALID_CRC) {
+        // never act on a corrupted record, one of its neighbours will do
+        ESP_LOGW(TAG, "corrupted record: %s", line);
+        return ESP_FAIL;
+    } else if (parse_err != ESP_OK) {
+        ESP_LOGE(TAG, "could not decode line");
+        return ESP_FAIL;
+    }
 
-    // Check for Mute line first
-    if (sscanf(line, "%4s%c_%02d_%10s_%03dM_%04d",
-                   tape_id, &side, &track_num, mp3_id, &mute_seconds, &playtime_total_seconds) == 6) {
-        ESP_LOGI(TAG, "Mute line detected: %s (duration %d)", line, mute_seconds);
+    if (rec.type == TAPE_RECORD_MUTE) {
+        ESP_LOGI(TAG, "Mute line detected: %s (duration %d)", line, (int)(rec.playtime_ms / 1000));
         // Stop playback if playing
         pipeline_decode_handle_no_line_data();
         return ESP_OK;
@@ -577,11 +491,10 @@ static esp_err_t pipeline_decode_handle_line_internal(const char *line, const ch
     //  As more lines of data are read from the cassette, compare the MP3 ID/time to the one currently playing.
     //  If they match (need to see how accurately this needs to be in sync, but I think within +/- 2 seconds should be fine) continue playing.
 
-    if (sscanf(line, "%4s%c_%02d_%10s_%04d_%04d",
-               tape_id, &side, &track_num, mp3_id, &playtime_seconds, &playtime_total_seconds) != 6) {
-        ESP_LOGE(TAG, "could not decode line");
-        return ESP_FAIL;
-    }
+    const char side = rec.side;
+    const char *mp3_id = rec.audio_id;
+    const int playtime_seconds = (int)(rec.playtime_ms / 1000);
+    const int playtime_total_seconds = (int)(rec.total_ms / 1000);
 
     //do not precess lines in pause state
     if (pause_decode) {
@@ -611,12 +524,14 @@ static esp_err_t pipeline_decode_handle_line_internal(const char *line, const ch
             ESP_LOGI(TAG, "Processing Dynamic Content Track ...");
             
             if (dct_mapping_enabled) {
-                char mapped_line[128];
+                tape_record_t mapped;
                 int target_time = playtime_total_seconds + dct_mapping_offset;
-                if (find_mapped_line(side, target_time, mapped_line) == ESP_OK) {
+                if (find_mapped_record(side, target_time, &mapped) == ESP_OK) {
+                    char mapped_line[TAPEFILE_LINE_LENGTH + 1];
+                    tape_record_format(&mapped, mapped_line, sizeof(mapped_line));
                     ESP_LOGI(TAG, "DCT Mapped %d to: %s", target_time, mapped_line);
-                    // Recursively handle the mapped line with prefix
-                    return pipeline_decode_handle_line_internal(mapped_line, "--> "); 
+                    // Recursively handle the mapped record with prefix
+                    return pipeline_decode_handle_parsed_line(mapped_line, "--> ", &mapped, ESP_OK);
                 } else {
                     ESP_LOGW(TAG, "DCT Mapping not found for totaltime %d", target_time);
                     // Do NOT stop playback; just ignore this DCT line and keep playing whatever is playing.
@@ -639,9 +554,11 @@ static esp_err_t pipeline_decode_handle_line_internal(const char *line, const ch
         }
     }
 
-    if (playtime_seconds > 0) {
-        ESP_LOGI(TAG, "seek to: %d, current time: %d", playtime_seconds, current_playing_audio_time_seconds);
-        fatfs_byte_pos = (int64_t)playtime_seconds * (int64_t)current_playing_audio_avg_bitrate / 8;
+    if (rec.playtime_ms > 0) {
+        ESP_LOGI(TAG, "seek to: %d.%03d, current time: %d", playtime_seconds, (int)(rec.playtime_ms % 1000),
+                 current_playing_audio_time_seconds);
+        // binary records carry the time to the ms
+        fatfs_byte_pos = (int64_t)rec.playtime_ms * (int64_t)current_playing_audio_avg_bitrate / 8000;
     }
 
     // c. If the line data MP3 ID/time does not match, then switch to the indicated MP3 file/time and start playing.
@@ -676,9 +593,92 @@ static esp_err_t pipeline_decode_handle_line_internal(const char *line, const ch
     return ESP_OK;
 }
 
+static esp_err_t pipeline_decode_handle_line_internal(const char *line, const char *prefix)
+{
+    tape_record_t rec;
+    const esp_err_t parse_err = tape_record_parse(line, &rec);
+    return pipeline_decode_handle_parsed_line(line, prefix, &rec, parse_err);
+}
+
+/**
+ * Check a record against the ones before it and handle it
+ * @param line  the record as decoded, NULL if rec was changed since
+ */
+static esp_err_t pipeline_decode_handle_record(tape_record_t *rec, const char *line, const char *prefix)
+{
+    char record_line[TAPEFILE_LINE_LENGTH + 1];
+    bool repaired = false;
+
+    if (tape_sequence != NULL
+        && tape_sequence_check(tape_sequence, rec, (uint32_t)(esp_timer_get_time() / 1000), &repaired) != ESP_OK) {
+        // a garbled line that still parses, never seek or stop for it
+        tape_record_format(rec, record_line, sizeof(record_line));
+        ESP_LOGW(TAG, "record out of sequence: %s", record_line);
+        return ESP_FAIL;
+    }
+    if (line == NULL || repaired) {
+        // rec keeps the ms, the line is only shown
+        tape_record_format(rec, record_line, sizeof(record_line));
+        line = record_line;
+    }
+    return pipeline_decode_handle_parsed_line(line, repaired ? "SEQ " : prefix, rec, ESP_OK);
+}
+
+/**
+ * Handle a record line that arrived late_ms ago
+ */
+static esp_err_t pipeline_decode_handle_record_line(const char *line, uint32_t late_ms)
+{
+    tape_fec_record_t recs[TAPE_FEC_MAX_DATA];
+    int nrecs = 0;
+    tape_record_t rec;
+
+    if (tape_fec == NULL || tape_fec_decoder_push(tape_fec, line, recs, &nrecs) != ESP_OK) {
+        if (tape_record_parse(line, &rec) != ESP_OK) {
+            // let pipeline_decode_handle_line_internal() report it
+            return pipeline_decode_handle_line_internal(line, "");
+        }
+        if (late_ms > 0 && rec.type == TAPE_RECORD_PLAY) {
+            // moved on to where the tape is now
+            rec.playtime_ms += late_ms;
+            rec.total_ms += late_ms;
+            return pipeline_decode_handle_record(&rec, NULL, "");
+        }
+        return pipeline_decode_handle_record(&rec, line, "");
+    }
+
+    // a FEC slot: handle the data records it completed, those recovered
+    // from parity moved on to where the tape is now
+    last_line_from_minimodem_time_us = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < nrecs; i++) {
+        tape_record_t *fec_rec = &recs[i].rec;
+        fec_rec->playtime_ms += recs[i].late_ms;
+        fec_rec->total_ms += recs[i].late_ms;
+        ret = pipeline_decode_handle_record(fec_rec, NULL, recs[i].late_ms ? "FEC " : "");
+    }
+    return ret;
+}
+
 static esp_err_t pipeline_decode_handle_line(const char *line)
 {
-    return pipeline_decode_handle_line_internal(line, "");
+    tape_combine_line_t out[TAPE_COMBINE_MAX_OUT];
+    int nout = 0;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    if (tape_combine != NULL) {
+        err = tape_combine_push(tape_combine, line, (uint32_t)(esp_timer_get_time() / 1000), out, &nout);
+    }
+    // a copy taken without output still shows the tape is running
+    last_line_from_minimodem_time_us = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < nout; i++) {
+        ret = pipeline_decode_handle_record_line(out[i].line, out[i].late_ms);
+    }
+    if (err == ESP_ERR_NOT_FOUND) {
+        ret = pipeline_decode_handle_record_line(line, 0);
+    }
+    return ret;
 }
 
 static esp_err_t pipeline_decode_handle_no_line_data(void)
@@ -712,6 +712,15 @@ static esp_err_t pipeline_decode_handle_no_line_data(void)
     // reset current playing info
     current_playing_audio_id[0] = 0;
     last_line_from_minimodem_time_us = 0;
+    if (tape_fec != NULL) {
+        tape_fec_decoder_reset(tape_fec);
+    }
+    if (tape_combine != NULL) {
+        tape_combine_reset(tape_combine);
+    }
+    if (tape_sequence != NULL) {
+        tape_sequence_reset(tape_sequence);
+    }
 
     return ESP_OK;
 }
@@ -727,6 +736,16 @@ esp_err_t pipeline_decode_start(audio_event_iface_handle_t evt)
     evt_playback = evt;
     pipeline_decode_unpause();
 
+    if (tape_fec == NULL) {
+        tape_fec = tape_fec_decoder_create();
+    }
+    if (tape_combine == NULL) {
+        tape_combine = tape_combine_create();
+    }
+    if (tape_sequence == NULL) {
+        tape_sequence = tape_sequence_create();
+    }
+
     err = create_playback_pipeline();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "error create_playback_pipeline");
@@ -801,10 +820,10 @@ esp_err_t pipeline_decode_event_loop(audio_event_iface_handle_t evt)
             continue;
         }
 
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *)filter_line_reader
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *)minimodem_decoder
             && msg.cmd == AEL_MSG_CMD_REPORT_POSITION) {
             // we got a text line from minimodem decoder
-            char *line = audio_element_get_uri(filter_line_reader);
+            char *line = audio_element_get_uri(minimodem_decoder);
             ESP_LOGI(TAG, "[ * ] line=%s", line);
             pipeline_decode_handle_line(line);
             continue;
@@ -848,13 +867,17 @@ esp_err_t pipeline_decode_stop(void)
     // reset current playing info
     current_playing_audio_id[0] = 0;
 
+    tape_fec_decoder_destroy(tape_fec);
+    tape_fec = NULL;
+    tape_combine_destroy(tape_combine);
+    tape_combine = NULL;
+    tape_sequence_destroy(tape_sequence);
+    tape_sequence = NULL;
+
     el_state = AEL_STATE_STOPPED;
 
     // close mapped file if open
-    if (g_mapped_file) {
-        fclose(g_mapped_file);
-        g_mapped_file = NULL;
-    }
+    close_mapped_file();
 
     return ESP_OK;
 }
@@ -867,8 +890,33 @@ void pipeline_decode_status(char *buf, size_t buf_size)
     audio_element_state_t state = audio_element_get_state(output_stream_writer);
 
     if (state == AEL_STATE_RUNNING) {
-        // returns “DECODE” and the current line record if playing
-        snprintf(buf, buf_size, "DECODE %s", last_line_from_minimodem);
+        // returns “DECODE” and the current line record if playing,
+        // followed by the bit clock lock state and tape speed ratio
+        // and the records recovered and lost by the FEC, corrected by
+        // combining their copies and repaired and rejected by the sequence
+        // check
+        bool locked = false;
+        float speed_ratio = 1.0f;
+        unsigned int nrecovered = 0;
+        unsigned int nlost = 0;
+        unsigned int ncorrected = 0;
+        unsigned int nrepaired = 0;
+        unsigned int nrejected = 0;
+        if (minimodem_decoder != NULL) {
+            minimodem_decoder_get_bit_clock(minimodem_decoder, &locked, &speed_ratio);
+        }
+        if (tape_fec != NULL) {
+            tape_fec_decoder_get_stats(tape_fec, &nrecovered, &nlost);
+        }
+        if (tape_combine != NULL) {
+            tape_combine_get_stats(tape_combine, &ncorrected, NULL);
+        }
+        if (tape_sequence != NULL) {
+            tape_sequence_get_stats(tape_sequence, &nrepaired, &nrejected);
+        }
+        snprintf(buf, buf_size, "DECODE %s LOCK %d SPEED %.3f FEC %u %u VOTE %u SEQ %u %u",
+                 last_line_from_minimodem, locked, speed_ratio, nrecovered, nlost, ncorrected,
+                 nrepaired, nrejected);
     } else {
         // If nothing is playing, returns “playback stopped”.
         snprintf(buf, buf_size, "playback stopped");
@@ -918,10 +966,8 @@ void pipeline_decode_set_dct_mapping(bool enabled, int offset)
     g_reload_mapped_file = true;
     
     // Immediate cleanup if disabling (optional as reload flag handles next access, but good for cleanliness)
-    if (!enabled && g_mapped_file) {
-        fclose(g_mapped_file);
-        g_mapped_file = NULL;
-        g_mapped_last_total_idx = -1;
+    if (!enabled && g_mapped_timeline) {
+        close_mapped_file();
         g_reload_mapped_file = false; // Already handled
     }
 }
@@ -7,12 +7,13 @@
 #include <audio_pipeline.h>
 #include <i2s_stream.h>
 #include <minimodem_encoder.h>
-#include <fatfs_stream.h>
 #include <esp_peripherals.h>
 #include <esp_event.h>
 #include "pipeline_encode.h"
 #include "pipeline.h"
 #include "tapefile.h"
+#include "tapefile_reader.h"
+#include "modem_profile.h"
 
 #define PLAYBACK_RATE       48000
 #define PLAYBACK_CHANNEL    2
@@ -22,11 +23,12 @@ static const char *TAG = "cf_pipeline_encode";
 
 static audio_pipeline_handle_t pipeline = NULL;
 //audio_element_handle_t i2s_stream_writer, mp3_decoder, fatfs_stream_reader, rsp_handle;
-static audio_element_handle_t i2s_stream_writer, minimodem_encoder, fatfs_stream_reader;
+static audio_element_handle_t i2s_stream_writer, minimodem_encoder, tapefile_reader;
 static audio_element_state_t el_state = AEL_STATE_STOPPED;
 static int64_t time_started_us = 0;
 
-esp_err_t pipeline_encode_start(audio_event_iface_handle_t evt, char *url)
+esp_err_t pipeline_encode_start(audio_event_iface_handle_t evt, const char side, minimodem_mode_t modem_mode,
+                                bool binary_records, int fec_data_records)
 {
     el_state = AEL_STATE_RUNNING;
 
@@ -56,6 +58,11 @@ esp_err_t pipeline_encode_start(audio_event_iface_handle_t evt, char *url)
 
     ESP_LOGI(TAG, "[4.2] Create minimodem encoder");
     minimodem_encoder_cfg_t minimodem_cfg = DEFAULT_MINIMODEM_ENCODER_CONFIG();
+    minimodem_cfg.modem_mode = modem_mode;
+    minimodem_cfg.binary_records = binary_records;
+    minimodem_cfg.fec_data_records = fec_data_records;
+    modem_profile_get(&minimodem_cfg.profile);
+    minimodem_cfg.minimodem_str = minimodem_transmit_cfg_profile(MINIMODEM_MODE_1200, &minimodem_cfg.profile);
     minimodem_encoder = minimodem_encoder_init(&minimodem_cfg);
 
     /* ZL38063 audio chip on board of ESP32-LyraTD-MSC does not support 44.1 kHz sampling frequency,
@@ -66,19 +73,18 @@ esp_err_t pipeline_encode_start(audio_event_iface_handle_t evt, char *url)
     //rsp_filter_cfg_t rsp_cfg = DEFAULT_RESAMPLE_FILTER_CONFIG();
     //rsp_handle = rsp_filter_init(&rsp_cfg);
 
-    ESP_LOGI(TAG, "[4.4] Create fatfs stream to read data from sdcard");
-    fatfs_stream_cfg_t fatfs_cfg = FATFS_STREAM_CFG_DEFAULT();
-    fatfs_cfg.type = AUDIO_STREAM_READER;
-    fatfs_stream_reader = fatfs_stream_init(&fatfs_cfg);
-    audio_element_set_uri(fatfs_stream_reader, url);
+    ESP_LOGI(TAG, "[4.4] Create tapefile reader to make the side file's lines");
+    tapefile_reader_cfg_t tapefile_cfg = DEFAULT_TAPEFILE_READER_CONFIG();
+    tapefile_cfg.side = side;
+    tapefile_reader = tapefile_reader_init(&tapefile_cfg);
 
     ESP_LOGI(TAG, "[4.5] Register all elements to audio pipeline");
-    audio_pipeline_register(pipeline, fatfs_stream_reader, "file");
+    audio_pipeline_register(pipeline, tapefile_reader, "file");
     audio_pipeline_register(pipeline, minimodem_encoder, "minimodem");
     //audio_pipeline_register(pipeline, rsp_handle, "filter");
     audio_pipeline_register(pipeline, i2s_stream_writer, "i2s");
 
-    ESP_LOGI(TAG, "[4.6] Link it together [sdcard]-->fatfs_stream-->minimodem-->i2s_stream-->[codec_chip]");
+    ESP_LOGI(TAG, "[4.6] Link it together [timeline]-->tapefile_reader-->minimodem-->i2s_stream-->[codec_chip]");
     const char *link_tag[3] = {"file", "minimodem", "i2s"};
     audio_pipeline_link(pipeline, &link_tag[0], 3);
 
@@ -5,7 +5,14 @@
 #ifndef CASSETTEFLOW_FIRMWARE_MAIN_PIPELINE_ENCODE_H
 #define CASSETTEFLOW_FIRMWARE_MAIN_PIPELINE_ENCODE_H
 
-esp_err_t pipeline_encode_start(audio_event_iface_handle_t evt, char *url);
+#include "minimodem_config.h"
+
+/**
+ * @param binary_records    send binary records instead of ASCII lines, see minimodem_encoder_cfg_t
+ * @param fec_data_records  seconds per FEC block of binary records, 0 for none
+ */
+esp_err_t pipeline_encode_start(audio_event_iface_handle_t evt, const char side, minimodem_mode_t modem_mode,
+                                bool binary_records, int fec_data_records);
 bool pipeline_encode_event_loop(audio_event_iface_handle_t evt);
 esp_err_t pipeline_encode_stop();
 void pipeline_encode_status(const char side, char *buf, size_t buf_size);
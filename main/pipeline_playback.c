@@ -23,6 +23,7 @@
 #include "pipeline_output.h"
 #include "bt.h"
 #include "tapefile.h"
+#include "tapefile_timeline.h"
 
 static const char *TAG = "cf_pipeline_playback";
 
@@ -58,7 +59,9 @@ static int current_playing_audio_duration = 0;
 static int current_playing_audio_avg_bitrate = 0;
 
 static esp_timer_handle_t periodic_timer = NULL;
-static FILE *fd_side_file = NULL;
+static tapefile_timeline_t *timeline = NULL;
+// where on the tape side the records are read from, as if it played
+static int64_t position_us = 0;
 static int64_t pause_time_us = 0;
 static int64_t time_started_us = 0;
 
@@ -66,7 +69,7 @@ static enum pipeline_decoder_mode current_audio_type = PIPELINE_DECODER_MP3;
 
 static audio_event_iface_handle_t evt_playback;
 
-static const char *filename = NULL;
+static char playback_side = 0;
 
 static char **make_link_tag(int *tags_number)
 {
@@ -287,51 +290,35 @@ static esp_err_t create_playback_pipeline(void)
 }
 
 /**
- * Handle line of text from file
- * @param line
+ * Handle the record the side file has for the current second
+ * @param rec
  * @return
  */
-static esp_err_t pipeline_playback_handle_line(const char *line)
+static esp_err_t pipeline_playback_handle_record(const tape_record_t *rec)
 {
-    const size_t line_len = strlen(line);
-
     raw_queue_message_t msg;
-    strcpy(msg.line, line);
+    tape_record_format(rec, msg.line, sizeof(msg.line));
     raw_queue_send(0, &msg);
 
-    if (line_len != TAPEFILE_LINE_LENGTH) {
-        ESP_LOGE(TAG, "unexpected line_len: %zu", line_len);
-        return ESP_FAIL;
-    }
+    ESP_LOGI(TAG, "[ * ] line=%s", msg.line);
 
-    char tape_id[5];
-    char side;
-    int track_num;
-    char audio_id[11];
-    int playtime_seconds;   // seconds
-    int playtime_total_seconds; // seconds
+    const char *audio_id = rec->audio_id;
+    const int playtime_seconds = (int)(rec->playtime_ms / 1000);
 
     // b. Once a line of data is processed, then start playback of the indicated MP3 file at the indicated time.
     //  As more lines of data are read from the cassette, compare the MP3 ID/time to the one currently playing.
     //  If they match (need to see how accurately this needs to be in sync, but I think within +/- 2 seconds should be fine) continue playing.
 
-    if (sscanf(line, "%4s%c_%02d_%10s_%04d_%04d",
-               tape_id, &side, &track_num, audio_id, &playtime_seconds, &playtime_total_seconds) != 6) {
-        //check for pause line
-        int pause_sec = 0;
-        if (sscanf(line, "%4s%c_%02d_%10s_%03dM_%04d",
-                   tape_id, &side, &track_num, audio_id, &pause_sec, &playtime_total_seconds) != 6) {
-            ESP_LOGE(TAG, "could not decode line");
-            return ESP_FAIL;
-        }
-        if (pause_sec > 0) {
-            ESP_LOGI(TAG, "Set pause time: %d sec", pause_sec);
-            //pause playback
-            audio_pipeline_stop(pipeline_for_play);
-            audio_pipeline_wait_for_stop(pipeline_for_play);
-            pause_time_us = (int64_t)pause_sec * 1000000;
-            return ESP_OK;
-        }
+    if (rec->type == TAPE_RECORD_MUTE) {
+        const int pause_sec = playtime_seconds;
+        ESP_LOGI(TAG, "Set pause time: %d sec", pause_sec);
+        //pause playback
+        audio_pipeline_stop(pipeline_for_play);
+        audio_pipeline_wait_for_stop(pipeline_for_play);
+        pause_time_us = (int64_t)pause_sec * 1000000;
+        // the records after the mute are read once the pause is over
+        position_us = (int64_t)(rec->total_ms + rec->playtime_ms) * 1000;
+        return ESP_OK;
     }
 
     int fatfs_byte_pos = 0; // start from the beginning by default
@@ -400,9 +387,7 @@ static esp_err_t pipeline_playback_handle_line(const char *line)
 
 static void periodic_timer_callback(void* arg)
 {
-    char line[128] = {0};
-
-    //do not read next lines in pause state
+    //do not read next records in pause state
     if (pause_time_us > 0) {
         ESP_LOGI(TAG, "[ * ] pause elapsed time %d s", (int)(pause_time_us/1000000));
         pause_time_us -= READ_TIMER_INTERVAL;
@@ -413,19 +398,16 @@ static void periodic_timer_callback(void* arg)
         audio_pipeline_run(pipeline_for_play);
     }
 
-    if (!fgets(line, 126, fd_side_file)) {
-        //can`t read any new line
-//        pipeline_playback_handle_no_line_data();
+    tape_record_t rec;
+    if (tapefile_timeline_find(timeline, (int)(position_us / 1000000), &rec) != ESP_OK) {
+        //no record past the end of the side
         pipeline_playback_stop();
-        fclose(fd_side_file);
-        fd_side_file = NULL;
+        return;
     }
-    // remove trailing newline character(s)
-    line[strcspn(line, "\r\n")] = 0;
-
-    ESP_LOGI(TAG, "[ * ] line=%s", line);
+    // a side file has each second's line several times, read one per tick
+    position_us += READ_TIMER_INTERVAL;
 
-    pipeline_playback_handle_line(line);
+    pipeline_playback_handle_record(&rec);
 }
 
 esp_err_t pipeline_playback_start(audio_event_iface_handle_t evt)
@@ -437,15 +419,16 @@ esp_err_t pipeline_playback_start(audio_event_iface_handle_t evt)
 
     evt_playback = evt;
     pause_time_us = 0;
+    position_us = 0;
 
-    if (filename == NULL) {
-        ESP_LOGE(TAG, "filename == NULL");
+    if (playback_side == 0) {
+        ESP_LOGE(TAG, "side not set");
         return ESP_FAIL;
     }
 
-    fd_side_file = fopen(filename, "r");
-    if (!fd_side_file) {
-        ESP_LOGE(TAG, "Failed to open DB : %s", FILE_TAPEDB);
+    timeline = tapefile_timeline_load(playback_side);
+    if (!timeline) {
+        ESP_LOGE(TAG, "Failed to load side file : %s", tapefile_get_path(playback_side));
         return ESP_FAIL;
     }
 
@@ -548,10 +531,8 @@ esp_err_t pipeline_playback_stop(void)
         pipeline_for_play = NULL;
     }
 
-    if (fd_side_file != NULL) {
-        fclose(fd_side_file);
-        fd_side_file = NULL;
-    }
+    tapefile_timeline_free(timeline);
+    timeline = NULL;
     //reset current audiofile id
     current_playing_audio_id[0] = 0;
 
@@ -572,9 +553,9 @@ void pipeline_playback_unpause(void)
     esp_timer_start_periodic(periodic_timer, READ_TIMER_INTERVAL);
 }
 
-void pipeline_playback_set_filename(const char *file)
+void pipeline_playback_set_side(const char side)
 {
-    filename = file;
+    playback_side = side;
 }
 
 void pipeline_playback_status(const char side, char *buf, size_t buf_size)
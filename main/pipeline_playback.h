@@ -15,6 +15,6 @@ esp_err_t pipeline_playback_event_loop(audio_event_iface_handle_t evt);
 void pipeline_playback_status(const char side, char *buf, size_t buf_size);
 void pipeline_playback_pause(void);
 void pipeline_playback_unpause(void);
-void pipeline_playback_set_filename(const char *file);
+void pipeline_playback_set_side(const char side);
 
 #endif //CASSETTEFLOW_FIRMWARE_MAIN_PIPELINE_PLAYBACK_H
@@ -3,76 +3,43 @@
 //
 
 #include <stdio.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include <esp_log.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "tapefile.h"
+#include "tapefile_timeline.h"
 #include "internal.h"
 #include "audiodb.h"
+#include "tape_record.h"
 
 static const char *TAG = "cf_tapefile";
 
-static const int replicate = 4;
-
-static esp_err_t format_line(FILE *file,
-                             const char *tape_id,
-                             const char side,
-                             int track_num,
-                             const char *mp3_id,
-                             int playtime,
-                             int playtime_total)
-{
-    //1. 4 digit Tape ID + 1 letter side 'A' or 'B'
-    //2. 2 digit track number
-    //3. Auto generate 10 digit MP3 ID associated with a MP3 file, or http url [future addition]
-    //4. 4 digit number indicating desired playtime (in seconds) of the MP3. A value of “000M”
-    //indicates that the MP3 should be loaded, but not played to allow for delay between
-    //each mp3 file.
-    //5. 4 digit number indicating the total number of seconds played so far on tape.
-    for (int i = 0; i < replicate; ++i) {
-        int written = fprintf(file, "%4s%c_%02d_%10s_%04d_%04d\n",
-                              tape_id, side, track_num, mp3_id, playtime, playtime_total);
-        if (written <= 0) {
-            return ESP_FAIL;
-        }
-    }
-    return ESP_OK;
-}
-
-static esp_err_t format_line_mute(FILE *file,
-                                  const char *tape_id,
-                                  const char side,
-                                  int track_num,
-                                  const char *mp3_id,
-                                  const int mute_seconds,
-                                  int playtime_total)
+const char *tapefile_get_path(const char side)
 {
-    //1. 4 digit Tape ID + 1 letter side 'A' or 'B'
-    //2. 2 digit track number
-    //3. Auto generate 10 digit MP3 ID associated with a MP3 file, or http url [future addition]
-    //4. 4 digit number indicating desired playtime (in seconds) of the MP3. A value of “000M”
-    //indicates that the MP3 should be loaded, but not played to allow for delay between
-    //each mp3 file.
-    //5. 4 digit number indicating the total number of seconds played so far on tape.
-    int written = fprintf(file, "%4s%c_%02d_%10s_%03dM_%04d\n",
-                          tape_id, side, track_num, mp3_id, mute_seconds, playtime_total);
-    if (written <= 0) {
-        return ESP_FAIL;
+    switch (side) {
+        case 'a':
+        case 'A':
+        default:
+            return FILENAME_SIDE_A;
+        case 'b':
+        case 'B':
+            return FILENAME_SIDE_B;
     }
-    return ESP_OK;
 }
 
-const char *tapefile_get_path(const char side)
+const char *tapefile_get_path_timeline(const char side)
 {
     switch (side) {
         case 'a':
         case 'A':
         default:
-            return FILENAME_SIDE_A;
+            return FILENAME_SIDE_A_TIMELINE;
         case 'b':
         case 'B':
-            return FILENAME_SIDE_B;
+            return FILENAME_SIDE_B_TIMELINE;
     }
 }
 
@@ -90,8 +57,35 @@ const char *tapefile_get_path_tapedb(const char side)
 }
 
 /**
- * generates the text file for side A or B to be encoded onto a 60, 90, 110, or 120
- * minute tape
+ * Write the line for the tape DB, see tapedb_file_save()
+ */
+static esp_err_t tapefile_write_tapedb(const char side, const char *tape_id, char **mp3ids, int count)
+{
+    const char *filepath = tapefile_get_path_tapedb(side);
+    FILE *fd_tapedb = fopen(filepath, "w");
+    if (!fd_tapedb) {
+        ESP_LOGE(TAG, "Failed to create file : %s", filepath);
+        return ESP_FAIL;
+    }
+    if (count > 0) {
+        fputs(tape_id, fd_tapedb);
+        fputc(side, fd_tapedb);
+        fputc('\t', fd_tapedb);
+    }
+    for (int track = 0; track < count; ++track) {
+        fputs(mp3ids[track], fd_tapedb);
+        fputc('\t', fd_tapedb);
+    }
+    esp_err_t ret = ferror(fd_tapedb) ? ESP_FAIL : ESP_OK;
+    fclose(fd_tapedb);
+    return ret;
+}
+
+/**
+ * generates side A or B to be encoded onto a 60, 90, 110, or 120 minute tape.
+ * Only its timeline is written, the lines of the side file are made from it
+ * when they are needed (see tapefile_reader.h). Nothing is written if the
+ * tracks do not fit or are not all in the DB.
  * @param side a or b (lowercase)
  * @param tape_length_minutes 60, 90, 110, or 120
  * @param data
@@ -102,27 +96,23 @@ const char *tapefile_get_path_tapedb(const char side)
 esp_err_t tapefile_create(const char side, int tape_length_minutes, char *data, int mute_time)
 {
     char *mp3id;
-    char tape_id[TAPEFILE_LINE_LENGTH + 1];
+    char tape_id[TAPEFILE_LINE_LENGTH + 1] = "";
     int mp3Count = 0;
     int timeTotal = 0;
-    FILE *fd = NULL;
-    // this file will be used to when adding to the tape DB
-    FILE *fd_tapedb = NULL;
-    const char *filepath = tapefile_get_path(side);
     esp_err_t ret = ESP_OK;
 
-    ESP_LOGI(TAG, "Creating text file for side:%c", side);
+    ESP_LOGI(TAG, "Creating side:%c", side);
 
-    fd = fopen(filepath, "w");
-    if (!fd) {
-        ESP_LOGE(TAG, "Failed to create file : %s", filepath);
-        return ESP_FAIL;
+    // one MP3 ID per comma at most
+    int max_count = 1;
+    for (const char *p = data; *p != 0; ++p) {
+        max_count += *p == ',';
     }
-
-    fd_tapedb = fopen(tapefile_get_path_tapedb(side), "w");
-    if (!fd_tapedb) {
-        ESP_LOGE(TAG, "Failed to create file : %s", filepath);
-        fclose(fd);
+    char **mp3ids = malloc(max_count * sizeof(char *));
+    int *durations = malloc(max_count * sizeof(int));
+    if (mp3ids == NULL || durations == NULL) {
+        free(mp3ids);
+        free(durations);
         return ESP_FAIL;
     }
 
@@ -134,61 +124,45 @@ esp_err_t tapefile_create(const char side, int tape_length_minutes, char *data,
         // split next data (comma separated MP3 IDs)
         mp3id = strtok(NULL, ",");
     }
-
-    if (mp3id != NULL) {
-        fputs(tape_id, fd_tapedb);
-        fputc(side, fd_tapedb);
-        fputc('\t', fd_tapedb);
+    while (mp3id != NULL) {
+        mp3ids[mp3Count++] = mp3id;
+        mp3id = strtok(NULL, ",");
     }
 
-    while ((mp3id != NULL) && (ret == ESP_OK)) {
-        int mp3_length_seconds = 0;
-        if (audiodb_file_for_id(mp3id, NULL, &mp3_length_seconds, NULL) != ESP_OK) {
-            // file not found in the DB
-            ret = ESP_ERR_NOT_FOUND;
-            continue;
-        }
-
-        // add line records to create a N second muted section before next song
-        if (mp3Count >= 1) {
-            if (format_line_mute(fd, tape_id, side, mp3Count + 1, mp3id, mute_time, timeTotal) != ESP_OK) {
-                ret = ESP_FAIL;
-                break;
-            }
-            timeTotal += mute_time;
-        }
-
-        for (int i = 0; i < mp3_length_seconds; ++i) {
-            if (format_line(fd, tape_id, side, mp3Count + 1, mp3id, i, timeTotal) != ESP_OK) {
-                ret = ESP_FAIL;
-                break;
-            }
-            timeTotal += 1;
-        }
-        if (ret != ESP_OK) {
-            continue;
-        }
-
-        // add to the tapeDB file
-        fputs(mp3id, fd_tapedb);
-        fputc('\t', fd_tapedb);
-
-        mp3Count += 1;
-        mp3id = strtok(NULL, ",");
+    // 1. all lengths from one pass over the DB
+    if (mp3Count > 0) {
+        ret = audiodb_durations_for_ids((const char *const *)mp3ids, mp3Count, durations);
     }
 
+    // 2. check total play time to fit into the tape before writing anything
     if (ret == ESP_OK) {
-        // check total play time to fit into the tape
+        for (int track = 0; track < mp3Count; ++track) {
+            timeTotal += durations[track] + (track >= 1 ? mute_time : 0);
+        }
         int tape_side_duration_seconds = tape_length_minutes * 60 / 2;
         if (timeTotal > tape_side_duration_seconds) {
+            ESP_LOGW(TAG, "Play time %d s exceeds tape side %d s", timeTotal, tape_side_duration_seconds);
             ret = ESP_ERR_INVALID_SIZE;
         }
     }
 
-    fclose(fd);
-    fclose(fd_tapedb);
+    // 3. write the timeline, the side file it replaces would shadow it
+    if (ret == ESP_OK) {
+        ret = tapefile_timeline_create(side, tape_id, mp3ids, durations, mp3Count, mute_time);
+    }
+    if (ret == ESP_OK && remove(tapefile_get_path(side)) != 0 && errno != ENOENT) {
+        ESP_LOGE(TAG, "Failed to remove file : %s, errno:%d", tapefile_get_path(side), errno);
+        ret = ESP_FAIL;
+    }
+    if (ret == ESP_OK) {
+        // this file will be used to when adding to the tape DB
+        ret = tapefile_write_tapedb(side, tape_id, mp3ids, mp3Count);
+    }
+
+    free(mp3ids);
+    free(durations);
 
-    ESP_LOGI(TAG, "File creation complete");
+    ESP_LOGI(TAG, "Side creation complete");
 
     return ret;
 }
@@ -198,7 +172,8 @@ bool tapefile_is_present(const char side)
     struct stat file_stat;
     const char *filepath = tapefile_get_path(side);
 
-    if (stat(filepath, &file_stat) == -1) {
+    // a side made by tapefile_create() has only its timeline
+    if (stat(filepath, &file_stat) == -1 && stat(tapefile_get_path_timeline(side), &file_stat) == -1) {
         ESP_LOGE(TAG, "Failed to stat file : %s", filepath);
         return false;
     }
@@ -214,18 +189,32 @@ bool tapefile_is_present(const char side)
  */
 esp_err_t tapefile_read_tapeid(const char side, char *tapeid)
 {
-    FILE *fd = NULL;
-    const char *filepath = tapefile_get_path(side);
-    esp_err_t err = ESP_OK;
+    // called for the status while the side is encoded or played, so the
+    // timeline is only read, not built
+    if (tapefile_timeline_read_tape_id(side, tapeid) == ESP_OK) {
+        return ESP_OK;
+    }
 
-    fd = fopen(filepath, "r");
+    // a side file without an up to date timeline yet
+    const char *filepath = tapefile_get_path(side);
+    FILE *fd = fopen(filepath, "r");
     if (!fd) {
         ESP_LOGE(TAG, "Failed to open file : %s", filepath);
         return ESP_FAIL;
     }
 
-    if (fscanf(fd, "%4s[AB]_", tapeid) != 1) {
+    esp_err_t err = ESP_OK;
+    char line[TAPEFILE_LINE_LENGTH + 2];
+    tape_record_t rec;
+    if (!fgets(line, sizeof(line), fd)) {
         err = ESP_FAIL;
+    } else {
+        line[strcspn(line, "\r\n")] = 0;
+        if (tape_record_parse(line, &rec) != ESP_OK) {
+            err = ESP_FAIL;
+        } else {
+            strcpy(tapeid, rec.tape_id);
+        }
     }
 
     fclose(fd);
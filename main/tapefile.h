@@ -9,8 +9,11 @@
 
 // excluding line end character(s)
 #define TAPEFILE_LINE_LENGTH        (29)
+// lines per second of playtime
+#define TAPEFILE_REPLICATE          (4)
 
 const char *tapefile_get_path(const char side);
+const char *tapefile_get_path_timeline(const char side);
 const char *tapefile_get_path_tapedb(const char side);
 esp_err_t tapefile_create(const char side, int tape_length_minutes, char *data, int mute_time);
 bool tapefile_is_present(const char side);
@@ -0,0 +1,147 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <string.h>
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_element.h"
+#include "audio_error.h"
+
+#include "tapefile.h"
+#include "tapefile_timeline.h"
+#include "tapefile_reader.h"
+
+static const char *TAG = "tapefile_reader";
+
+typedef struct
+{
+    char side;
+    tapefile_timeline_t *timeline;
+    tapefile_timeline_cursor_t cursor;
+    // the line being read, what did not fit into the last read
+    char line[TAPEFILE_LINE_LENGTH + 2];
+    int line_pos;
+    int line_length;
+} tapefile_reader_data_t;
+
+
+static esp_err_t tapefile_reader_destroy(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "tapefile_reader_destroy");
+    tapefile_reader_data_t *data = (tapefile_reader_data_t *)audio_element_getdata(self);
+    tapefile_timeline_free(data->timeline);
+    audio_free(data);
+    return ESP_OK;
+}
+
+static esp_err_t tapefile_reader_open(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "tapefile_reader_open");
+    tapefile_reader_data_t *data = (tapefile_reader_data_t *)audio_element_getdata(self);
+    if (data->timeline != NULL) {
+        // resumed after a pause
+        return ESP_OK;
+    }
+    data->timeline = tapefile_timeline_load(data->side);
+    if (data->timeline == NULL) {
+        ESP_LOGE(TAG, "No timeline for side %c", data->side);
+        return ESP_FAIL;
+    }
+    memset(&data->cursor, 0, sizeof(data->cursor));
+    data->line_pos = 0;
+    data->line_length = 0;
+    audio_element_set_byte_pos(self, 0);
+    return ESP_OK;
+}
+
+static esp_err_t tapefile_reader_close(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "tapefile_reader_close");
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        tapefile_reader_data_t *data = (tapefile_reader_data_t *)audio_element_getdata(self);
+        tapefile_timeline_free(data->timeline);
+        data->timeline = NULL;
+        audio_element_set_byte_pos(self, 0);
+        audio_element_set_total_bytes(self, 0);
+    }
+    return ESP_OK;
+}
+
+static int tapefile_reader_read(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait,
+                                void *context)
+{
+    tapefile_reader_data_t *data = (tapefile_reader_data_t *)audio_element_getdata(self);
+    int rlen = 0;
+
+    while (rlen < len) {
+        if (data->line_pos == data->line_length) {
+            data->line_length = tapefile_timeline_next_line(data->timeline, &data->cursor,
+                                                            data->line, sizeof(data->line));
+            data->line_pos = 0;
+            if (data->line_length <= 0) {
+                // past the last line
+                data->line_length = 0;
+                break;
+            }
+        }
+        int n = data->line_length - data->line_pos;
+        if (n > len - rlen) {
+            n = len - rlen;
+        }
+        memcpy(buffer + rlen, data->line + data->line_pos, n);
+        data->line_pos += n;
+        rlen += n;
+    }
+
+    if (rlen == 0) {
+        ESP_LOGW(TAG, "No more data");
+    } else {
+        audio_element_update_byte_pos(self, rlen);
+    }
+    return rlen;
+}
+
+static audio_element_err_t tapefile_reader_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    int w_size;
+    if (r_size > 0) {
+        w_size = audio_element_output(self, in_buffer, r_size);
+    } else {
+        w_size = r_size;
+    }
+    return w_size;
+}
+
+audio_element_handle_t tapefile_reader_init(tapefile_reader_cfg_t *config)
+{
+    tapefile_reader_data_t *data = audio_calloc(1, sizeof(tapefile_reader_data_t));
+    AUDIO_MEM_CHECK(TAG, data, {return NULL;});
+    data->side = 'a';
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.destroy = tapefile_reader_destroy;
+    cfg.process = tapefile_reader_process;
+    cfg.read = tapefile_reader_read;
+    cfg.open = tapefile_reader_open;
+    cfg.close = tapefile_reader_close;
+    cfg.task_stack = TAPEFILE_READER_TASK_STACK;
+    if (config) {
+        if (config->task_stack) {
+            cfg.task_stack = config->task_stack;
+        }
+        cfg.stack_in_ext = config->stack_in_ext;
+        cfg.task_prio = config->task_prio;
+        cfg.task_core = config->task_core;
+        cfg.out_rb_size = config->out_rb_size;
+        data->side = config->side;
+    }
+
+    cfg.tag = "tapefile_reader";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {audio_free(data); return NULL;});
+    audio_element_setdata(el, data);
+    ESP_LOGD(TAG, "tapefile_reader_init");
+    return el;
+}
@@ -0,0 +1,38 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_MAIN_TAPEFILE_READER_H
+#define CASSETTEFLOW_FIRMWARE_MAIN_TAPEFILE_READER_H
+
+/*
+ * Reader element with the lines of a side file for the encoder, formatted
+ * from the side's timeline as they are read, so the side file does not have
+ * to be on the SD card (see tapefile_create()).
+ */
+typedef struct {
+    char                    side;           /*!< Side to read, a or b */
+    int                     out_rb_size;    /*!< Size of output ringbuffer */
+    int                     task_stack;     /*!< Task stack size */
+    int                     task_core;      /*!< Task running in core (0 or 1) */
+    int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
+    bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
+} tapefile_reader_cfg_t;
+
+#define TAPEFILE_READER_TASK_STACK          (3 * 1024)
+#define TAPEFILE_READER_TASK_CORE           (0)
+#define TAPEFILE_READER_TASK_PRIO           (4)
+#define TAPEFILE_READER_RINGBUFFER_SIZE     (8 * 1024)
+
+#define DEFAULT_TAPEFILE_READER_CONFIG() {\
+    .side               = 'a',\
+    .out_rb_size        = TAPEFILE_READER_RINGBUFFER_SIZE,\
+    .task_stack         = TAPEFILE_READER_TASK_STACK,\
+    .task_core          = TAPEFILE_READER_TASK_CORE,\
+    .task_prio          = TAPEFILE_READER_TASK_PRIO,\
+    .stack_in_ext       = false, \
+}
+
+audio_element_handle_t tapefile_reader_init(tapefile_reader_cfg_t *config);
+
+#endif //CASSETTEFLOW_FIRMWARE_MAIN_TAPEFILE_READER_H
@@ -0,0 +1,430 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include "tapefile_timeline.h"
+#include "tapefile.h"
+#include "internal.h"
+
+static const char *TAG = "cf_tapefile_timeline";
+
+#define TIMELINE_MAGIC      "CFTL"
+#define TIMELINE_VERSION    (2)
+
+// longer than a record line, so that a line that is not one is read whole
+#define TIMELINE_LINE_SIZE  (128)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    // of the side file the timeline was built from, 0 if built from a playlist
+    uint32_t file_size;
+    int64_t file_mtime;
+    char tape_id[5];
+    char side;
+    uint16_t nsegments;
+} timeline_header_t;
+
+typedef struct {
+    uint16_t start;             // first second on the tape side
+    uint16_t nseconds;
+    uint16_t playtime;          // position in the audio file at start, 0 for a mute
+    uint8_t track_num;
+    uint8_t type;               // tape_record_type_t
+    char audio_id[11];
+} timeline_segment_t;
+
+struct tapefile_timeline {
+    char tape_id[5];
+    char side;
+    size_t nsegments;
+    timeline_segment_t segments[];
+};
+
+static void header_init(timeline_header_t *header)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TIMELINE_MAGIC, sizeof(header->magic));
+    header->version = TIMELINE_VERSION;
+}
+
+static esp_err_t side_file_stat(const char side, timeline_header_t *header)
+{
+    struct stat file_stat;
+    header_init(header);
+    if (stat(tapefile_get_path(side), &file_stat) == -1) {
+        return ESP_FAIL;
+    }
+    header->file_size = file_stat.st_size;
+    header->file_mtime = file_stat.st_mtime;
+    return ESP_OK;
+}
+
+static esp_err_t timeline_write(const char side, const timeline_header_t *header,
+                                const tapefile_timeline_t *timeline)
+{
+    const char *filepath = tapefile_get_path_timeline(side);
+    FILE *fd = fopen(filepath, "wb");
+    if (!fd) {
+        ESP_LOGE(TAG, "Failed to create file : %s", filepath);
+        return ESP_FAIL;
+    }
+    esp_err_t ret = ESP_OK;
+    if (fwrite(header, sizeof(*header), 1, fd) != 1
+        || fwrite(timeline->segments, sizeof(timeline_segment_t), timeline->nsegments, fd)
+           != timeline->nsegments) {
+        ESP_LOGE(TAG, "Failed to write file : %s", filepath);
+        ret = ESP_FAIL;
+    }
+    if (fclose(fd) != 0) {
+        ret = ESP_FAIL;
+    }
+    if (ret != ESP_OK) {
+        remove(filepath);
+    }
+    ESP_LOGI(TAG, "Side %c: %u segments", side, (unsigned int)timeline->nsegments);
+    return ret;
+}
+
+static tapefile_timeline_t *timeline_alloc(tapefile_timeline_t *timeline, size_t nsegments)
+{
+    // kept for as long as the tape plays, out of the internal RAM
+    return heap_caps_realloc(timeline, sizeof(tapefile_timeline_t) + nsegments * sizeof(timeline_segment_t),
+                             MALLOC_CAP_SPIRAM);
+}
+
+/**
+ * Add the record of a line to the segments, extending the last one if the
+ * record is the next second of its run
+ * @return ESP_ERR_NO_MEM if segments is full
+ */
+static esp_err_t timeline_add(timeline_segment_t *segments, size_t *nsegments, size_t max_segments,
+                              const tape_record_t *rec)
+{
+    const int second = rec->total_ms / 1000;
+    const int playtime = rec->playtime_ms / 1000;
+    timeline_segment_t *last = *nsegments ? &segments[*nsegments - 1] : NULL;
+
+    if (rec->type == TAPE_RECORD_PLAY && last != NULL && last->type == TAPE_RECORD_PLAY) {
+        const int end = last->start + last->nseconds;
+        if (second == end - 1) {
+            // another copy of the run's last second
+            return ESP_OK;
+        }
+        if (second == end
+            && rec->track_num == last->track_num
+            && strcmp(rec->audio_id, last->audio_id) == 0
+            && playtime == last->playtime + last->nseconds) {
+            last->nseconds++;
+            return ESP_OK;
+        }
+    }
+    if (last != NULL && second < last->start + last->nseconds) {
+        // the side files written by tapefile_create() only go forward
+        ESP_LOGW(TAG, "record for second %d out of order, skipped", second);
+        return ESP_OK;
+    }
+    if (*nsegments == max_segments) {
+        return ESP_ERR_NO_MEM;
+    }
+    timeline_segment_t *seg = &segments[(*nsegments)++];
+    *seg = (timeline_segment_t) {
+        .start = second,
+        .nseconds = rec->type == TAPE_RECORD_MUTE ? playtime : 1,
+        .playtime = rec->type == TAPE_RECORD_MUTE ? 0 : playtime,
+        .track_num = rec->track_num,
+        .type = rec->type,
+    };
+    strlcpy(seg->audio_id, rec->audio_id, sizeof(seg->audio_id));
+    return ESP_OK;
+}
+
+/**
+ * Scan the side file into a new timeline
+ * @param header filled in with the tape id and the number of segments
+ */
+static tapefile_timeline_t *timeline_scan(const char side, timeline_header_t *header)
+{
+    const char *filepath = tapefile_get_path(side);
+    FILE *fd = fopen(filepath, "r");
+    if (!fd) {
+        ESP_LOGE(TAG, "Failed to open file : %s", filepath);
+        return NULL;
+    }
+
+    size_t max_segments = 32;
+    tapefile_timeline_t *timeline = timeline_alloc(NULL, max_segments);
+    if (timeline == NULL) {
+        fclose(fd);
+        return NULL;
+    }
+    memset(timeline, 0, sizeof(tapefile_timeline_t));
+
+    char line[TIMELINE_LINE_SIZE];
+    while (fgets(line, sizeof(line), fd)) {
+        line[strcspn(line, "\r\n")] = 0;
+        tape_record_t rec;
+        if (tape_record_parse(line, &rec) != ESP_OK) {
+            continue;
+        }
+        if (timeline->nsegments == 0) {
+            strlcpy(timeline->tape_id, rec.tape_id, sizeof(timeline->tape_id));
+            timeline->side = rec.side;
+        }
+        esp_err_t err;
+        while ((err = timeline_add(timeline->segments, &timeline->nsegments, max_segments, &rec))
+               == ESP_ERR_NO_MEM) {
+            tapefile_timeline_t *grown = timeline_alloc(timeline, 2 * max_segments);
+            if (grown == NULL) {
+                break;
+            }
+            timeline = grown;
+            max_segments *= 2;
+        }
+        if (err != ESP_OK) {
+            heap_caps_free(timeline);
+            fclose(fd);
+            return NULL;
+        }
+    }
+    fclose(fd);
+    memcpy(header->tape_id, timeline->tape_id, sizeof(header->tape_id));
+    header->side = timeline->side;
+    header->nsegments = timeline->nsegments;
+    return timeline;
+}
+
+esp_err_t tapefile_timeline_build(const char side)
+{
+    timeline_header_t header;
+    if (side_file_stat(side, &header) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to stat file : %s", tapefile_get_path(side));
+        return ESP_FAIL;
+    }
+    tapefile_timeline_t *timeline = timeline_scan(side, &header);
+    if (timeline == NULL) {
+        return ESP_FAIL;
+    }
+    esp_err_t ret = timeline_write(side, &header, timeline);
+    heap_caps_free(timeline);
+    return ret;
+}
+
+esp_err_t tapefile_timeline_create(const char side, const char *tape_id, char *const *audio_ids,
+                                   const int *durations, int count, int mute_time)
+{
+    // a mute and a run of seconds per track
+    tapefile_timeline_t *timeline = timeline_alloc(NULL, 2 * count);
+    if (timeline == NULL) {
+        return ESP_FAIL;
+    }
+    memset(timeline, 0, sizeof(tapefile_timeline_t));
+    strlcpy(timeline->tape_id, tape_id, sizeof(timeline->tape_id));
+    timeline->side = side;
+
+    int total = 0;
+    for (int track = 0; track < count; ++track) {
+        timeline_segment_t seg = {
+                .track_num = track + 1,
+        };
+        strlcpy(seg.audio_id, audio_ids[track], sizeof(seg.audio_id));
+        // a mute line before each track but the first
+        if (track >= 1) {
+            seg.start = total;
+            seg.nseconds = mute_time;
+            seg.type = TAPE_RECORD_MUTE;
+            timeline->segments[timeline->nsegments++] = seg;
+            total += mute_time;
+        }
+        if (durations[track] > 0) {
+            seg.start = total;
+            seg.nseconds = durations[track];
+            seg.type = TAPE_RECORD_PLAY;
+            timeline->segments[timeline->nsegments++] = seg;
+            total += durations[track];
+        }
+    }
+
+    timeline_header_t header;
+    header_init(&header);
+    memcpy(header.tape_id, timeline->tape_id, sizeof(header.tape_id));
+    header.side = timeline->side;
+    header.nsegments = timeline->nsegments;
+    esp_err_t ret = timeline_write(side, &header, timeline);
+    heap_caps_free(timeline);
+    return ret;
+}
+
+/**
+ * Read the header of the timeline file if it was built from the side file
+ * as it is now, or from a playlist when there is no side file
+ * @return ESP_OK, ESP_FAIL if it is missing or stale
+ */
+static esp_err_t header_read(const char side, FILE *fd, timeline_header_t *header)
+{
+    timeline_header_t current;
+    // with no side file, current has the size and time of one built from a playlist
+    side_file_stat(side, &current);
+    if (fread(header, sizeof(*header), 1, fd) == 1
+        && memcmp(header->magic, current.magic, sizeof(header->magic)) == 0
+        && header->version == current.version
+        && header->file_size == current.file_size
+        && header->file_mtime == current.file_mtime) {
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+/**
+ * @return the timeline, NULL if it is missing or stale
+ */
+static tapefile_timeline_t *timeline_read(const char side)
+{
+    timeline_header_t header;
+    FILE *fd = fopen(tapefile_get_path_timeline(side), "rb");
+    if (!fd) {
+        return NULL;
+    }
+    tapefile_timeline_t *timeline = NULL;
+    if (header_read(side, fd, &header) == ESP_OK) {
+        timeline = timeline_alloc(NULL, header.nsegments);
+        if (timeline != NULL) {
+            memcpy(timeline->tape_id, header.tape_id, sizeof(timeline->tape_id));
+            timeline->tape_id[sizeof(timeline->tape_id) - 1] = 0;
+            timeline->side = header.side;
+            timeline->nsegments = header.nsegments;
+            if (fread(timeline->segments, sizeof(timeline_segment_t), header.nsegments, fd)
+                != header.nsegments) {
+                heap_caps_free(timeline);
+                timeline = NULL;
+            }
+        }
+    }
+    fclose(fd);
+    return timeline;
+}
+
+tapefile_timeline_t *tapefile_timeline_load(const char side)
+{
+    tapefile_timeline_t *timeline = timeline_read(side);
+    if (timeline == NULL) {
+        ESP_LOGI(TAG, "Timeline of side %c missing or stale, building it from %s", side,
+                 tapefile_get_path(side));
+        if (tapefile_timeline_build(side) != ESP_OK) {
+            return NULL;
+        }
+        timeline = timeline_read(side);
+    }
+    return timeline;
+}
+
+void tapefile_timeline_free(tapefile_timeline_t *timeline)
+{
+    heap_caps_free(timeline);
+}
+
+const char *tapefile_timeline_tape_id(const tapefile_timeline_t *timeline)
+{
+    return timeline->tape_id;
+}
+
+esp_err_t tapefile_timeline_read_tape_id(const char side, char *tape_id)
+{
+    timeline_header_t header;
+    FILE *fd = fopen(tapefile_get_path_timeline(side), "rb");
+    if (!fd) {
+        return ESP_FAIL;
+    }
+    esp_err_t ret = header_read(side, fd, &header);
+    fclose(fd);
+    if (ret == ESP_OK) {
+        memcpy(tape_id, header.tape_id, sizeof(header.tape_id));
+        tape_id[sizeof(header.tape_id) - 1] = 0;
+    }
+    return ret;
+}
+
+esp_err_t tapefile_timeline_find(const tapefile_timeline_t *timeline, int total_seconds,
+                                 tape_record_t *rec)
+{
+    // last segment starting at or before total_seconds
+    size_t lo = 0, hi = timeline->nsegments;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (timeline->segments[mid].start <= total_seconds) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const timeline_segment_t *seg = &timeline->segments[lo - 1];
+    if (total_seconds >= seg->start + seg->nseconds) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memset(rec, 0, sizeof(*rec));
+    rec->type = seg->type;
+    memcpy(rec->tape_id, timeline->tape_id, sizeof(rec->tape_id));
+    rec->side = timeline->side;
+    rec->track_num = seg->track_num;
+    memcpy(rec->audio_id, seg->audio_id, sizeof(rec->audio_id));
+    if (seg->type == TAPE_RECORD_MUTE) {
+        // the mute line itself
+        rec->playtime_ms = seg->nseconds * 1000;
+        rec->total_ms = seg->start * 1000;
+    } else {
+        rec->playtime_ms = (seg->playtime + total_seconds - seg->start) * 1000;
+        rec->total_ms = total_seconds * 1000;
+    }
+    return ESP_OK;
+}
+
+int tapefile_timeline_next_line(const tapefile_timeline_t *timeline, tapefile_timeline_cursor_t *cursor,
+                                char *buf, size_t size)
+{
+    if (cursor->segment >= timeline->nsegments) {
+        return 0;
+    }
+    const timeline_segment_t *seg = &timeline->segments[cursor->segment];
+    tape_record_t rec = {
+            .type = seg->type,
+            .side = timeline->side,
+            .track_num = seg->track_num,
+    };
+    memcpy(rec.tape_id, timeline->tape_id, sizeof(rec.tape_id));
+    memcpy(rec.audio_id, seg->audio_id, sizeof(rec.audio_id));
+
+    if (seg->type == TAPE_RECORD_MUTE) {
+        // a single line for the whole mute
+        rec.playtime_ms = seg->nseconds * 1000;
+        rec.total_ms = seg->start * 1000;
+        cursor->segment++;
+    } else {
+        rec.playtime_ms = (seg->playtime + cursor->second) * 1000;
+        rec.total_ms = (seg->start + cursor->second) * 1000;
+        if (++cursor->copy == TAPEFILE_REPLICATE) {
+            cursor->copy = 0;
+            if (++cursor->second == seg->nseconds) {
+                cursor->second = 0;
+                cursor->segment++;
+            }
+        }
+    }
+    int len = tape_record_format(&rec, buf, size);
+    if (len < 0 || (size_t)len + 1 >= size) {
+        return -1;
+    }
+    buf[len++] = '\n';
+    buf[len] = 0;
+    return len;
+}
@@ -0,0 +1,90 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_MAIN_TAPEFILE_TIMELINE_H
+#define CASSETTEFLOW_FIRMWARE_MAIN_TAPEFILE_TIMELINE_H
+
+#include <esp_err.h>
+#include "tape_record.h"
+
+/*
+ * What a side file says for each second of the tape side, without the
+ * side file: its lines run-length coded into segments. A segment is a run
+ * of seconds of one track playing on from a position in the audio file, or
+ * a mute line, so a side has a few segments per track and a full side fits
+ * in a few hundred bytes instead of the side file's 430 KB.
+ *
+ * tapefile_create() writes only the timeline, made from the playlist, and
+ * the side file's lines are formatted from it when they are needed, see
+ * tapefile_reader.h. A side file put on the SD card by other means is read
+ * into a timeline, which is kept next to it (FILENAME_SIDE_A_TIMELINE) with
+ * the side file's size and time, and built again when they no longer match.
+ */
+typedef struct tapefile_timeline tapefile_timeline_t;
+
+// position in the lines of the side file, start from all 0
+typedef struct {
+    size_t segment;
+    int second;
+    int copy;
+} tapefile_timeline_cursor_t;
+
+/**
+ * Scan the side file and write its timeline
+ * @param side a or b
+ * @return ESP_OK, ESP_FAIL if a file could not be read or written
+ */
+esp_err_t tapefile_timeline_build(const char side);
+
+/**
+ * Write the timeline of a side from its playlist, as tapefile_create()
+ * would have written the side file
+ * @param side a or b
+ * @param audio_ids audio ids of the tracks in tape order
+ * @param durations their length in seconds
+ * @param mute_time mute time between tracks in seconds
+ * @return ESP_OK, ESP_FAIL if the file could not be written
+ */
+esp_err_t tapefile_timeline_create(const char side, const char *tape_id, char *const *audio_ids,
+                                   const int *durations, int count, int mute_time);
+
+/**
+ * Read the timeline of the side file, building it first if it is missing
+ * or older than the side file
+ * @param side a or b
+ * @return the timeline, NULL on error
+ */
+tapefile_timeline_t *tapefile_timeline_load(const char side);
+
+void tapefile_timeline_free(tapefile_timeline_t *timeline);
+
+const char *tapefile_timeline_tape_id(const tapefile_timeline_t *timeline);
+
+/**
+ * Read the tape id from the timeline file alone, which is neither built nor
+ * written, so that it can be called while the side is being played
+ * @param tape_id at least 5 bytes
+ * @return ESP_OK, ESP_FAIL if the timeline is missing or stale
+ */
+esp_err_t tapefile_timeline_read_tape_id(const char side, char *tape_id);
+
+/**
+ * Find the record the side file has for a second of the tape side
+ * @param total_seconds position on the tape side
+ * @param rec set to the record of that second, for a mute the whole mute
+ *  line starting at or before total_seconds
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the side file has no record for it
+ */
+esp_err_t tapefile_timeline_find(const tapefile_timeline_t *timeline, int total_seconds,
+                                 tape_record_t *rec);
+
+/**
+ * Format the next line of the side file, with its line end
+ * @param cursor advanced past the line
+ * @return length of the line, 0 past the last line, -1 if size is too small
+ */
+int tapefile_timeline_next_line(const tapefile_timeline_t *timeline, tapefile_timeline_cursor_t *cursor,
+                                char *buf, size_t size);
+
+#endif //CASSETTEFLOW_FIRMWARE_MAIN_TAPEFILE_TIMELINE_H
@@ -0,0 +1,191 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "channel_model.h"
+
+typedef struct {
+    float b0, b1, b2, a1, a2;
+    float x1, x2, y1, y2;
+} biquad_t;
+
+static uint32_t rng_next(uint32_t *state)
+{
+    // xorshift32, reproducible across platforms unlike rand()
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static float rng_uniform(uint32_t *state)
+{
+    return (rng_next(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+static float rng_gaussian(uint32_t *state)
+{
+    float u1 = rng_uniform(state);
+    float u2 = rng_uniform(state);
+    if (u1 < 1e-7f) {
+        u1 = 1e-7f;
+    }
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+// Butterworth (Q = 1/sqrt(2)) sections from the RBJ audio EQ cookbook
+static void biquad_init(biquad_t *bq, float corner_hz, unsigned int rate, int highpass)
+{
+    float w0 = 2.0f * (float)M_PI * corner_hz / rate;
+    float alpha = sinf(w0) / (2.0f * (float)M_SQRT1_2);
+    float cosw0 = cosf(w0);
+    float a0 = 1.0f + alpha;
+    if (highpass) {
+        bq->b0 = (1.0f + cosw0) / 2.0f / a0;
+        bq->b1 = -(1.0f + cosw0) / a0;
+    } else {
+        bq->b0 = (1.0f - cosw0) / 2.0f / a0;
+        bq->b1 = (1.0f - cosw0) / a0;
+    }
+    bq->b2 = bq->b0;
+    bq->a1 = -2.0f * cosw0 / a0;
+    bq->a2 = (1.0f - alpha) / a0;
+    bq->x1 = bq->x2 = bq->y1 = bq->y2 = 0;
+}
+
+static float biquad_run(biquad_t *bq, float x)
+{
+    float y = bq->b0 * x + bq->b1 * bq->x1 + bq->b2 * bq->x2 - bq->a1 * bq->y1 - bq->a2 * bq->y2;
+    bq->x2 = bq->x1;
+    bq->x1 = x;
+    bq->y2 = bq->y1;
+    bq->y1 = y;
+    return y;
+}
+
+/**
+ * Gain envelope of the dropouts: Poisson distributed start times, a linear
+ * ramp of CHANNEL_DROPOUT_RAMP_MS into and out of each one. The single gap
+ * has no ramp.
+ */
+static float *dropout_envelope(const channel_model_cfg_t *cfg, size_t nframes, unsigned int rate,
+                               uint32_t *rng)
+{
+    float *env = malloc(nframes * sizeof(float));
+    if (env == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < nframes; i++) {
+        env[i] = 1.0f;
+    }
+    if (cfg->gap_s > 0) {
+        const size_t start = cfg->gap_at_s * rate;
+        const size_t end = (cfg->gap_at_s + cfg->gap_s) * rate;
+        for (size_t i = start; i < end && i < nframes; i++) {
+            env[i] = cfg->dropout_gain;
+        }
+    }
+    if (cfg->dropouts_per_minute <= 0 || cfg->dropout_ms <= 0) {
+        return env;
+    }
+    const double mean_gap = 60.0 * rate / cfg->dropouts_per_minute;
+    const size_t len = cfg->dropout_ms * rate / 1000;
+    const size_t ramp = CHANNEL_DROPOUT_RAMP_MS * rate / 1000 + 1;
+    double pos = -mean_gap * log(1.0 - rng_uniform(rng));
+    while (pos < nframes) {
+        size_t start = (size_t)pos;
+        for (size_t i = 0; i < len + 2 * ramp && start + i < nframes; i++) {
+            float depth = 1.0f;
+            if (i < ramp) {
+                depth = (float)i / ramp;
+            } else if (i >= len + ramp) {
+                depth = (float)(len + 2 * ramp - i) / ramp;
+            }
+            float g = 1.0f - depth * (1.0f - cfg->dropout_gain);
+            if (g < env[start + i]) {
+                env[start + i] = g;
+            }
+        }
+        pos += len + 2 * ramp - mean_gap * log(1.0 - rng_uniform(rng));
+    }
+    return env;
+}
+
+int16_t *channel_model_apply(const channel_model_cfg_t *cfg, const int16_t *in, size_t nframes,
+                             unsigned int rate, size_t *out_nframes)
+{
+    uint32_t rng = cfg->seed ? cfg->seed : 1;
+    const float speed = cfg->speed > 0 ? cfg->speed : 1.0f;
+    const size_t nout = nframes > 1 ? (size_t)((nframes - 1) / speed) : 0;
+
+    int16_t *out = malloc((nout ? nout : 1) * 2 * sizeof(int16_t));
+    float *env = dropout_envelope(cfg, nout ? nout : 1, rate, &rng);
+    if (out == NULL || env == NULL) {
+        free(out);
+        free(env);
+        return NULL;
+    }
+
+    biquad_t highpass[2], lowpass[2];
+    for (int ch = 0; ch < 2; ch++) {
+        if (cfg->highpass_hz > 0) {
+            biquad_init(&highpass[ch], cfg->highpass_hz, rate, 1);
+        }
+        if (cfg->lowpass_hz > 0) {
+            biquad_init(&lowpass[ch], cfg->lowpass_hz, rate, 0);
+        }
+    }
+    const float noise_amplitude = cfg->noise * cfg->level * 32767.0f;
+    const float track_gain[2] = {1.0f, cfg->right_gain > 0 ? cfg->right_gain : 1.0f};
+    // input frames the right track lags behind the left one
+    const double azimuth = cfg->azimuth_us * 1e-6 * rate;
+
+    // position in the input advances at the momentary tape speed; both
+    // tracks carry the same signal so only the left one of the input is read
+    double pos = 0;
+    size_t n = 0;
+    for (; n < nout; n++) {
+        if ((size_t)pos + 1 >= nframes) {
+            break;
+        }
+        float t = (float)n / rate;
+        float gain = cfg->level * env[n]
+            * (1.0f + cfg->level_drift * sinf(2.0f * (float)M_PI * CHANNEL_DRIFT_HZ * t));
+        for (int ch = 0; ch < 2; ch++) {
+            double p = ch ? pos - azimuth : pos;
+            if (p < 0) {
+                p = 0;
+            }
+            size_t a = (size_t)p;
+            float frac = (float)(p - a);
+            float x = (in[2 * a] * (1.0f - frac) + in[2 * a + 2] * frac) / 32767.0f;
+
+            if (cfg->highpass_hz > 0) {
+                x = biquad_run(&highpass[ch], x);
+            }
+            if (cfg->lowpass_hz > 0) {
+                x = biquad_run(&lowpass[ch], x);
+            }
+
+            float v = x * gain * track_gain[ch] * 32767.0f + noise_amplitude * rng_gaussian(&rng);
+            if (v > 32767.0f) {
+                v = 32767.0f;
+            } else if (v < -32768.0f) {
+                v = -32768.0f;
+            }
+            out[2 * n + ch] = (int16_t)lrintf(v);
+        }
+
+        pos += speed * (1.0
+            + cfg->wow * sin(2.0 * M_PI * CHANNEL_WOW_HZ * t)
+            + cfg->flutter * sin(2.0 * M_PI * CHANNEL_FLUTTER_HZ * t));
+    }
+    free(env);
+    *out_nframes = n;
+    return out;
+}
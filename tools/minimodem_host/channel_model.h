@@ -0,0 +1,62 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Simple cassette channel: tape transport speed with wow and flutter, head
+// band-limiting, dropouts, level drift and hiss, applied in that order to
+// the encoder output.
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_CHANNEL_MODEL_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_CHANNEL_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHANNEL_WOW_HZ          (0.7f)
+#define CHANNEL_FLUTTER_HZ      (9.0f)
+#define CHANNEL_DRIFT_HZ        (0.1f)
+#define CHANNEL_DROPOUT_RAMP_MS (2.0f)
+
+typedef struct {
+    const char *name;
+    float level;                /*!< Playback level, fraction of full scale */
+    float speed;                /*!< Tape speed, 1.0 is nominal */
+    float wow;                  /*!< Peak speed deviation at CHANNEL_WOW_HZ */
+    float flutter;              /*!< Peak speed deviation at CHANNEL_FLUTTER_HZ */
+    float highpass_hz;          /*!< 2nd order high-pass corner, 0 for none */
+    float lowpass_hz;           /*!< 2nd order low-pass corner, 0 for none */
+    float dropouts_per_minute;  /*!< Mean rate of dropouts */
+    float dropout_ms;           /*!< Length of each dropout */
+    float dropout_gain;         /*!< Gain during a dropout, 0 for silence */
+    float gap_at_s;             /*!< Start of a single extra dropout */
+    float gap_s;                /*!< Length of that dropout, 0 for none */
+    float level_drift;          /*!< Peak level deviation at CHANNEL_DRIFT_HZ */
+    float right_gain;           /*!< Level of the right track relative to the left, 0 for the same */
+    float azimuth_us;           /*!< Delay of the right track from a head azimuth error */
+    float noise;                /*!< Hiss RMS relative to the playback level */
+    unsigned int seed;          /*!< Seed for the noise and dropout times */
+} channel_model_cfg_t;
+
+/**
+ * Play back interleaved stereo frames through the channel. Each channel gets
+ * its own hiss, everything else is common to both tracks.
+ *
+ * @param cfg           The channel
+ * @param in            Interleaved stereo S16 input
+ * @param nframes       Number of input frames
+ * @param rate          Sample rate of input and output
+ * @param out_nframes   Set to the number of output frames
+ * @return malloc()ed output, NULL if out of memory
+ */
+int16_t *channel_model_apply(const channel_model_cfg_t *cfg, const int16_t *in, size_t nframes,
+                             unsigned int rate, size_t *out_nframes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_CHANNEL_MODEL_H
@@ -0,0 +1,169 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Tone analyzer micro-benchmark: searches frames of a synthetic 1200 baud
+// signal with fsk_find_frame() like the decoder's coarse search, once per
+// analyzer (see fsk_set_analyzer()) and once with the bin tracker, checks
+// that they find the same frames and reports frames per second of each,
+// see benchmark.md.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_decoder.h"
+
+#define BENCH_NFRAMES       (2000)
+// hiss added to the tones, like the hiss scenario of minimodem_loopback
+#define BENCH_NOISE         (0.1f)
+
+typedef struct {
+    const char *name;
+    int analyzer;           // enum fsk_analyzer, or -1 for the bin tracker
+} bench_method_t;
+
+typedef struct {
+    unsigned long long bits[BENCH_NFRAMES];
+    unsigned int nfound;
+    double frames_per_second;
+} bench_result_t;
+
+static double cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float gaussian(void)
+{
+    const float u1 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+    const float u2 = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+/**
+ * Frames of expect_bits_string back to back, random data bits, each bit
+ * the tone of its value with continuous phase
+ */
+static fsk_sample_t *synthesize(const fsk_plan *fskp, unsigned int sample_rate, float nsamples_per_bit,
+                                const char *expect_bits_string, unsigned int nsamples)
+{
+    fsk_sample_t *samples = malloc(nsamples * sizeof(fsk_sample_t));
+    if (samples == NULL) {
+        return NULL;
+    }
+    const unsigned int n_bits = strlen(expect_bits_string);
+    double phase = 0;
+    unsigned int bit = 0;
+    unsigned int value = 0;
+    for (unsigned int i = 0; i < nsamples; i++) {
+        if (i >= (unsigned int)((bit + 1) * nsamples_per_bit + 0.5f) || i == 0) {
+            bit += i != 0;
+            const char c = expect_bits_string[bit % n_bits];
+            value = c == 'd' ? (unsigned int)rand() % 2 : (unsigned int)(c - '0');
+        }
+        phase += 2.0 * M_PI * fskp->b_tones[value] * fskp->band_width / sample_rate;
+        const float s = 0.5f * (float)sin(phase) + BENCH_NOISE * gaussian();
+#ifdef FSK_FIXED_POINT
+        samples[i] = (fsk_sample_t)lrintf(fmaxf(-1.0f, fminf(s, 32767.0f / 32768.0f)) * 32768.0f);
+#else
+        samples[i] = s;
+#endif
+    }
+    return samples;
+}
+
+/**
+ * Search every frame starting half a bit before it, like the decoder does
+ * before its bit clock locks
+ */
+static void run_method(const bench_method_t *method, minimodem_decoder_struct *dec, fsk_sample_t *samples,
+                       float nsamples_per_bit, bench_result_t *result)
+{
+    fsk_plan *fskp = dec->fskp;
+    const unsigned int frame_nsamples = nsamples_per_bit * dec->expect_n_bits;
+    const unsigned int try_max_nsamples = nsamples_per_bit;
+    const unsigned int try_step_nsamples = try_max_nsamples / dec->analyze_nsteps;
+    size_t nruns = 0;
+    const double start = cpu_seconds();
+    double elapsed;
+
+    if (method->analyzer >= 0) {
+        fsk_set_analyzer(fskp, (enum fsk_analyzer)method->analyzer);
+    }
+    do {
+        result->nfound = 0;
+        for (unsigned int k = 1; k < BENCH_NFRAMES; k++) {
+            const unsigned int frame_start = k * dec->expect_n_bits * nsamples_per_bit + 0.5f;
+            fsk_sample_t *p = samples + frame_start - try_max_nsamples / 2;
+            if (method->analyzer >= 0) {
+                fsk_track_invalidate(fskp);
+            } else {
+                fsk_track_bins(fskp, p, try_max_nsamples + frame_nsamples, frame_nsamples,
+                               dec->expect_n_bits);
+            }
+            float ampl;
+            unsigned int found_start;
+            const float confidence = fsk_find_frame(fskp, p, frame_nsamples, 0, try_max_nsamples,
+                                                    try_step_nsamples, dec->fsk_confidence_search_limit,
+                                                    dec->expect_data_string, &result->bits[k],
+                                                    &ampl, &found_start);
+            result->nfound += confidence > dec->fsk_confidence_threshold;
+        }
+        nruns++;
+        elapsed = cpu_seconds() - start;
+    } while (elapsed < 0.5);
+    fsk_track_invalidate(fskp);
+    fsk_set_analyzer(fskp, FSK_ANALYZER_DEFAULT);
+    result->frames_per_second = nruns * (BENCH_NFRAMES - 1) / elapsed;
+}
+
+int main(void)
+{
+    static const bench_method_t methods[] = {
+#ifndef FSK_FIXED_POINT
+            {"fft", FSK_ANALYZER_FFT},
+#endif
+            {"goertzel", FSK_ANALYZER_GOERTZEL},
+            {"bin tracker", -1},
+    };
+    const size_t nmethods = sizeof(methods) / sizeof(methods[0]);
+    static bench_result_t results[sizeof(methods) / sizeof(methods[0])];
+
+    const minimodem_profile_t profile = MINIMODEM_PROFILE_DEFAULT();
+    minimodem_decoder_struct *dec = minimodem_receive_cfg_profile(&profile);
+    if (dec == NULL) {
+        fprintf(stderr, "decoder init failed\n");
+        return 1;
+    }
+    const float nsamples_per_bit = dec->bit_clock.nominal_nsamples_per_bit;
+    srand(1);
+    fsk_sample_t *samples = synthesize(dec->fskp, dec->sample_rate, nsamples_per_bit,
+                                       dec->expect_data_string,
+                                       (BENCH_NFRAMES + 1) * dec->expect_n_bits * nsamples_per_bit);
+    if (samples == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("| analyzer | frames found | differing from %s | frames/s | speedup |\n", methods[0].name);
+    printf("|---|---|---|---|---|\n");
+    for (size_t m = 0; m < nmethods; m++) {
+        run_method(&methods[m], dec, samples, nsamples_per_bit, &results[m]);
+        unsigned int ndiffer = 0;
+        for (unsigned int k = 1; k < BENCH_NFRAMES; k++) {
+            ndiffer += results[m].bits[k] != results[0].bits[k];
+        }
+        printf("| %s | %u/%u | %u | %.0f | %.1fx |\n", methods[m].name, results[m].nfound,
+               BENCH_NFRAMES - 1, ndiffer, results[m].frames_per_second,
+               results[m].frames_per_second / results[0].frames_per_second);
+    }
+
+    free(samples);
+    minimodem_receive_destroy(dec);
+    return 0;
+}
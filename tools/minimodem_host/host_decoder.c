@@ -0,0 +1,389 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "frame_search.h"
+#include "host_decoder.h"
+#include "tape_record.h"
+#include "tape_fec.h"
+#include "tape_combine.h"
+#include "tape_sequence.h"
+
+// chunk handed to minimodem_dec_buf() per call, like an i2s stream read
+#define FEED_CHUNK_BYTES    (4096)
+// silence appended to the recording so the last frames leave samplebuf
+#define FLUSH_SECONDS       (1)
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void end_line(host_decoder_t *hd)
+{
+    hd->line[hd->line_len] = '\0';
+    if (hd->line_len > 0) {
+        host_lines_add(&hd->decoded, hd->line,
+                       hd->line_nframes ? hd->line_confidence / hd->line_nframes : 0);
+        hd->decoded.time_ms[hd->decoded.nlines - 1] = hd->fed_ms;
+    }
+    hd->line_len = 0;
+    hd->line_confidence = 0;
+    hd->line_nframes = 0;
+}
+
+/*
+ * Everything the decoder outputs ends up here. The frames decoded since the
+ * previous call produced these bytes, so their confidence is credited to the
+ * current line.
+ */
+static int decoder_output(audio_element_handle_t self, char *buffer, int wanted_size)
+{
+    host_decoder_t *hd = self->data;
+    minimodem_decoder_struct *dec = hd->dec;
+
+    // the counters restart from 0 when the carrier is lost
+    if (dec->nframes_decoded < hd->last_nframes_decoded) {
+        hd->last_nframes_decoded = 0;
+        hd->last_confidence_total = 0;
+    }
+    unsigned int nframes = dec->nframes_decoded - hd->last_nframes_decoded;
+    hd->line_nframes += nframes;
+    hd->line_confidence += dec->confidence_total - hd->last_confidence_total;
+    hd->nframes += nframes;
+    hd->last_nframes_decoded = dec->nframes_decoded;
+    hd->last_confidence_total = dec->confidence_total;
+
+    for (int i = 0; i < wanted_size; i++) {
+        char c = buffer[i];
+        if (c == '\n') {
+            end_line(hd);
+        } else if (hd->line_len < HOST_MAX_LINE_LEN - 1) {
+            hd->line[hd->line_len++] = c;
+        }
+    }
+    return wanted_size;
+}
+
+host_decoder_t *host_decoder_create(int workers, const minimodem_profile_t *profile)
+{
+    const minimodem_profile_t default_profile = MINIMODEM_PROFILE_DEFAULT();
+    host_decoder_t *hd = calloc(1, sizeof(host_decoder_t));
+    if (hd == NULL) {
+        return NULL;
+    }
+    hd->dec = minimodem_receive_cfg_profile(profile ? profile : &default_profile);
+    if (hd->dec == NULL) {
+        free(hd);
+        return NULL;
+    }
+    if (workers > 0) {
+        frame_search_cfg_t search_cfg = {
+            .nworkers = workers,
+        };
+        hd->dec->search_pool = frame_search_pool_create(&search_cfg);
+    }
+    hd->element.output = decoder_output;
+    hd->element.data = hd;
+    return hd;
+}
+
+unsigned int host_decoder_input_rate(const host_decoder_t *hd)
+{
+    return hd->dec->sample_rate * MINIMODEM_DECIMATION;
+}
+
+void host_decoder_set_analyzer(host_decoder_t *hd, enum fsk_analyzer analyzer)
+{
+    for (int i = 0; i < MINIMODEM_NMODES; i++) {
+        fsk_set_analyzer(hd->dec->modes[i].fskp, analyzer);
+    }
+}
+
+int host_analyzer_parse(const char *name, enum fsk_analyzer *analyzer)
+{
+    if (strcmp(name, "goertzel") == 0) {
+        *analyzer = FSK_ANALYZER_GOERTZEL;
+        return 0;
+    }
+    if (strcmp(name, "fft") == 0) {
+#ifdef FSK_FIXED_POINT
+        fprintf(stderr, "the fixed-point build has only the goertzel analyzer\n");
+        return -1;
+#else
+        *analyzer = FSK_ANALYZER_FFT;
+        return 0;
+#endif
+    }
+    fprintf(stderr, "unknown analyzer %s, use fft or goertzel\n", name);
+    return -1;
+}
+
+const char *host_analyzer_name(enum fsk_analyzer analyzer)
+{
+    return analyzer == FSK_ANALYZER_FFT ? "fft" : "goertzel";
+}
+
+void host_decoder_run(host_decoder_t *hd, const int16_t *frames, size_t nframes)
+{
+    const size_t in_size = nframes * 2 * sizeof(int16_t);
+    const size_t flush_size = FLUSH_SECONDS * host_decoder_input_rate(hd) * 2 * sizeof(int16_t);
+    unsigned char *silence = calloc(1, FEED_CHUNK_BYTES);
+    if (silence == NULL) {
+        return;
+    }
+
+    const double bytes_per_ms = host_decoder_input_rate(hd) * 2 * sizeof(int16_t) / 1000.0;
+    const uint32_t start_ms = hd->fed_ms;
+    double wall0 = wall_seconds();
+    double cpu0 = cpu_seconds();
+    for (size_t pos = 0; pos < in_size; pos += FEED_CHUNK_BYTES) {
+        size_t len = in_size - pos < FEED_CHUNK_BYTES ? in_size - pos : FEED_CHUNK_BYTES;
+        hd->fed_ms = start_ms + (uint32_t)((pos + len) / bytes_per_ms);
+        minimodem_dec_buf(hd->dec, &hd->element, (unsigned char *)frames + pos, len);
+    }
+    for (size_t pos = 0; pos < flush_size; pos += FEED_CHUNK_BYTES) {
+        size_t len = flush_size - pos < FEED_CHUNK_BYTES ? flush_size - pos : FEED_CHUNK_BYTES;
+        hd->fed_ms = start_ms + (uint32_t)((in_size + pos + len) / bytes_per_ms);
+        minimodem_dec_buf(hd->dec, &hd->element, silence, len);
+    }
+    hd->wall_seconds += wall_seconds() - wall0;
+    hd->cpu_seconds += cpu_seconds() - cpu0;
+    free(silence);
+
+    // an unterminated last line still counts
+    if (hd->line_len > 0) {
+        end_line(hd);
+    }
+}
+
+void host_decoder_destroy(host_decoder_t *hd)
+{
+    if (hd == NULL) {
+        return;
+    }
+    frame_search_pool_destroy(hd->dec->search_pool);
+    minimodem_receive_destroy(hd->dec);
+    host_lines_free(&hd->decoded);
+    free(hd);
+}
+
+void host_lines_add(host_lines_t *list, const char *line, float confidence)
+{
+    if (list->nlines == list->size) {
+        list->size = list->size ? list->size * 2 : 256;
+        list->lines = realloc(list->lines, list->size * sizeof(char *));
+        list->confidence = realloc(list->confidence, list->size * sizeof(float));
+        list->time_ms = realloc(list->time_ms, list->size * sizeof(uint32_t));
+        if (list->lines == NULL || list->confidence == NULL || list->time_ms == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    list->confidence[list->nlines] = confidence;
+    list->time_ms[list->nlines] = 0;
+    list->lines[list->nlines++] = strdup(line);
+}
+
+int host_lines_read(const char *path, int skip_pauses, host_lines_t *list)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    char line[HOST_MAX_LINE_LEN];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+        // 0001A_03_b3488ae07e_000M_0481 is a pause record
+        if (skip_pauses && strlen(line) > 23 && line[23] == 'M') {
+            continue;
+        }
+        host_lines_add(list, line, 0);
+    }
+    fclose(f);
+    return 0;
+}
+
+int host_profile_read(const char *path, minimodem_profile_t *profile)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    char text[1024];
+    size_t len = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[len] = '\0';
+    if (minimodem_profile_parse(text, profile) != ESP_OK) {
+        fprintf(stderr, "%s: bad modem profile\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_line_ptrs(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static char **sorted_lines(const host_lines_t *list)
+{
+    char **sorted = malloc((list->nlines ? list->nlines : 1) * sizeof(char *));
+    if (sorted == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    memcpy(sorted, list->lines, list->nlines * sizeof(char *));
+    qsort(sorted, list->nlines, sizeof(char *), compare_line_ptrs);
+    return sorted;
+}
+
+size_t host_lines_compare(const host_lines_t *decoded, const host_lines_t *expected,
+                          size_t *ngarbled)
+{
+    // merge the sorted lists: a line repeated in the decoded output does
+    // not make up for a lost one
+    char **d = sorted_lines(decoded);
+    char **e = sorted_lines(expected);
+    size_t i = 0, j = 0, nfound = 0;
+    while (i < decoded->nlines && j < expected->nlines) {
+        int cmp = strcmp(d[i], e[j]);
+        if (cmp == 0) {
+            nfound++;
+            i++;
+            j++;
+        } else if (cmp < 0) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    free(d);
+    free(e);
+    if (ngarbled) {
+        *ngarbled = decoded->nlines - nfound;
+    }
+    return expected->nlines - nfound;
+}
+
+/**
+ * Add rec unless it is out of sequence, as line if it is ASCII and was not
+ * repaired
+ * @return 1 if it was dropped
+ */
+static size_t add_record(tape_record_t *rec, const char *line, uint32_t time_ms, float confidence,
+                         tape_sequence_t *seq, host_lines_t *lines)
+{
+    char ascii_line[HOST_MAX_LINE_LEN];
+    bool repaired = false;
+
+    if (seq != NULL && tape_sequence_check(seq, rec, time_ms, &repaired) != ESP_OK) {
+        return 1;
+    }
+    if (rec->binary || repaired) {
+        tape_record_format(rec, ascii_line, sizeof(ascii_line));
+        line = ascii_line;
+    }
+    host_lines_add(lines, line, confidence);
+    return 0;
+}
+
+/**
+ * Add a line that arrived late_ms before time_ms, the records recovered
+ * from FEC slots keep their own time here
+ */
+static size_t add_record_line(const char *line, uint32_t time_ms, uint32_t late_ms, float confidence,
+                              tape_fec_decoder_t *fec, tape_sequence_t *seq, host_lines_t *lines)
+{
+    tape_fec_record_t recs[TAPE_FEC_MAX_DATA];
+    int nrecs;
+    tape_record_t rec;
+
+    if (tape_fec_decoder_push(fec, line, recs, &nrecs) == ESP_OK) {
+        size_t ndropped = 0;
+        for (int k = 0; k < nrecs; k++) {
+            ndropped += add_record(&recs[k].rec, NULL, time_ms - recs[k].late_ms, confidence, seq, lines);
+        }
+        return ndropped;
+    }
+    const esp_err_t err = tape_record_parse(line, &rec);
+    if (err == ESP_OK) {
+        return add_record(&rec, line, time_ms - late_ms, confidence, seq, lines);
+    }
+    if (line[0] == TAPE_RECORD_MARKER) {
+        return 1;
+    }
+    host_lines_add(lines, line, confidence);
+    return 0;
+}
+
+size_t host_lines_from_records(const host_lines_t *decoded, int flags, host_lines_t *lines)
+{
+    tape_fec_decoder_t *fec = tape_fec_decoder_create();
+    tape_combine_t *comb = tape_combine_create();
+    tape_sequence_t *seq = (flags & HOST_RECORDS_SEQUENCE) ? tape_sequence_create() : NULL;
+    if (fec == NULL || comb == NULL || ((flags & HOST_RECORDS_SEQUENCE) && seq == NULL)) {
+        exit(1);
+    }
+    size_t ndropped = 0;
+    tape_combine_line_t out[TAPE_COMBINE_MAX_OUT];
+    int nout;
+    for (size_t i = 0; i < decoded->nlines; i++) {
+        const char *line = decoded->lines[i];
+        const uint32_t time_ms = decoded->time_ms[i];
+        const float confidence = decoded->confidence[i];
+        if (!(flags & HOST_RECORDS_COMBINE)) {
+            ndropped += add_record_line(line, time_ms, 0, confidence, fec, seq, lines);
+            continue;
+        }
+        const esp_err_t err = tape_combine_push(comb, line, time_ms, out, &nout);
+        for (int k = 0; k < nout; k++) {
+            ndropped += add_record_line(out[k].line, time_ms, out[k].late_ms, confidence, fec, seq, lines);
+        }
+        if (err == ESP_ERR_NOT_FOUND) {
+            ndropped += add_record_line(line, time_ms, 0, confidence, fec, seq, lines);
+        }
+    }
+    if (flags & HOST_RECORDS_COMBINE) {
+        // the last group is output by the line after it
+        const uint32_t time_ms = decoded->nlines ? decoded->time_ms[decoded->nlines - 1] : 0;
+        tape_combine_flush(comb, time_ms, out, &nout);
+        for (int k = 0; k < nout; k++) {
+            ndropped += add_record_line(out[k].line, time_ms, out[k].late_ms, 0, fec, seq, lines);
+        }
+    }
+    tape_sequence_destroy(seq);
+    tape_combine_destroy(comb);
+    tape_fec_decoder_destroy(fec);
+    return ndropped;
+}
+
+void host_lines_free(host_lines_t *list)
+{
+    for (size_t i = 0; i < list->nlines; i++) {
+        free(list->lines[i]);
+    }
+    free(list->lines);
+    free(list->confidence);
+    free(list->time_ms);
+    memset(list, 0, sizeof(host_lines_t));
+}
@@ -0,0 +1,124 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Runs the firmware's minimodem decoder over a recording held in memory and
+// collects the decoded lines, shared by the host tools.
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_HOST_DECODER_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_HOST_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio_element.h"
+#include "minimodem_dec_init.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOST_MAX_LINE_LEN   (256)
+
+typedef struct {
+    char **lines;
+    float *confidence;      // mean frame confidence per line, if decoded
+    uint32_t *time_ms;      // where the line ended in the recording, if decoded
+    size_t nlines;
+    size_t size;
+} host_lines_t;
+
+typedef struct {
+    struct audio_element element;
+    minimodem_decoder_struct *dec;
+    // current line and the confidence of the frames that produced it
+    char line[HOST_MAX_LINE_LEN];
+    size_t line_len;
+    float line_confidence;
+    unsigned int line_nframes;
+    // input fed to the decoder so far
+    uint32_t fed_ms;
+    // decoder counters at the previous output, to take the deltas from
+    float last_confidence_total;
+    unsigned int last_nframes_decoded;
+    // results of host_decoder_run()
+    host_lines_t decoded;
+    unsigned long long nframes;
+    double wall_seconds;
+    double cpu_seconds;
+} host_decoder_t;
+
+/**
+ * @param workers frame search helper threads, 0 for none
+ * @param profile modem parameters, NULL for MINIMODEM_PROFILE_DEFAULT()
+ * @return decoder taking MINIMODEM_DECIMATION * 16 kHz S16 stereo, or NULL
+ */
+host_decoder_t *host_decoder_create(int workers, const minimodem_profile_t *profile);
+
+/**
+ * Decode interleaved stereo frames at host_decoder_input_rate(), followed by
+ * a second of silence to flush the decoder. Lines and timings accumulate in
+ * the decoder.
+ */
+void host_decoder_run(host_decoder_t *hd, const int16_t *frames, size_t nframes);
+
+unsigned int host_decoder_input_rate(const host_decoder_t *hd);
+
+/**
+ * Use this tone analyzer in every modem mode instead of FSK_ANALYZER_DEFAULT
+ */
+void host_decoder_set_analyzer(host_decoder_t *hd, enum fsk_analyzer analyzer);
+
+/**
+ * @param name "fft" or "goertzel"
+ * @return 0 or -1 if the name is unknown or the analyzer is not in this build
+ */
+int host_analyzer_parse(const char *name, enum fsk_analyzer *analyzer);
+
+const char *host_analyzer_name(enum fsk_analyzer analyzer);
+
+// frees the decoder, its line buffers and helper tasks
+void host_decoder_destroy(host_decoder_t *hd);
+
+void host_lines_add(host_lines_t *list, const char *line, float confidence);
+
+/**
+ * Read a side file or list of expected lines, skipping empty lines and,
+ * if skip_pauses, the pause records (which are encoded as silence)
+ * @return 0 or -1 if the file could not be read
+ */
+int host_lines_read(const char *path, int skip_pauses, host_lines_t *list);
+
+/**
+ * Read a modem profile file, see minimodem_profile.h, into profile
+ * @return 0 or -1 if the file could not be read or parsed
+ */
+int host_profile_read(const char *path, minimodem_profile_t *profile);
+
+/**
+ * Match decoded against expected lines, each expected line at most once
+ * @return number of expected lines that were not decoded
+ */
+size_t host_lines_compare(const host_lines_t *decoded, const host_lines_t *expected,
+                          size_t *ngarbled);
+
+// host_lines_from_records() flags, the decode pipeline does all of these
+#define HOST_RECORDS_COMBINE    (1 << 0)    // combine the copies of each record, see tape_combine.h
+#define HOST_RECORDS_SEQUENCE   (1 << 1)    // check the record sequence, see tape_sequence.h
+
+/**
+ * Copy decoded lines to lines, binary tape records converted to their ASCII
+ * line like the decode pipeline does, corrupted ones dropped. FEC slots are
+ * replaced by the data records they carry or recover.
+ * @param flags HOST_RECORDS_*
+ * @return number of lines dropped, corrupted or out of sequence
+ */
+size_t host_lines_from_records(const host_lines_t *decoded, int flags, host_lines_t *lines);
+
+void host_lines_free(host_lines_t *list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_HOST_DECODER_H
@@ -0,0 +1,296 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Offline tape decoder: runs a WAV or raw S16LE recording of a tape side
+// through the same minimodem decoder as the record pipeline and writes the
+// decoded line records to stdout. Throughput, per-line confidence and, given
+// the expected lines, the line error rate are reported on stderr.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "host_decoder.h"
+
+typedef struct {
+    int16_t *frames;        // interleaved stereo
+    size_t nframes;
+    unsigned int rate;
+} pcm_t;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-r rate] [-c channels] [-e expected.txt] [-w workers] [-a analyzer] [-P profile] [-m] [-p] [-v] [-q] input\n"
+            "  input        WAV (16 bit PCM) or raw S16LE file\n"
+            "  -r rate      sample rate of a raw input (default: decoder input rate)\n"
+            "  -c channels  channels of a raw input, 1 or 2 (default 2)\n"
+            "  -e file      expected lines, to report the line error rate\n"
+            "  -w workers   frame search helper threads (default 0)\n"
+            "  -a analyzer  tone analyzer, fft or goertzel (default goertzel)\n"
+            "  -P profile   modem profile file, like the firmware's modem.txt\n"
+            "  -m           combine the copies of each record like the decode pipeline,\n"
+            "               -e then lists each record once\n"
+            "  -p           check the record sequence like the decode pipeline\n"
+            "  -v           prefix each decoded line with its mean frame confidence\n"
+            "  -q           report only, do not print decoded lines\n", prog);
+}
+
+static uint32_t le32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/**
+ * Load a recording as interleaved stereo S16 at its own rate. A mono
+ * recording is duplicated to both channels.
+ */
+static int load_pcm(const char *path, unsigned int raw_rate, unsigned int raw_channels,
+                    pcm_t *pcm)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *data = malloc(file_size > 0 ? file_size : 1);
+    if (data == NULL || fread(data, 1, file_size, f) != (size_t)file_size) {
+        fprintf(stderr, "%s: read error\n", path);
+        fclose(f);
+        free(data);
+        return -1;
+    }
+    fclose(f);
+
+    const unsigned char *samples = data;
+    size_t samples_size = file_size;
+    unsigned int channels = raw_channels;
+    pcm->rate = raw_rate;
+
+    if (file_size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0) {
+        int have_fmt = 0;
+        samples = NULL;
+        for (size_t pos = 12; pos + 8 <= (size_t)file_size;) {
+            uint32_t chunk_size = le32(data + pos + 4);
+            const unsigned char *chunk = data + pos + 8;
+            if (chunk_size > file_size - pos - 8) {
+                // truncated recording, take what is there
+                chunk_size = file_size - pos - 8;
+            }
+            if (memcmp(data + pos, "fmt ", 4) == 0 && chunk_size >= 16) {
+                uint16_t format = le16(chunk);
+                channels = le16(chunk + 2);
+                pcm->rate = le32(chunk + 4);
+                uint16_t bits = le16(chunk + 14);
+                // 0xfffe is WAVE_FORMAT_EXTENSIBLE, assumed to carry PCM
+                if ((format != 1 && format != 0xfffe) || bits != 16) {
+                    fprintf(stderr, "%s: only 16 bit PCM WAV is supported\n", path);
+                    free(data);
+                    return -1;
+                }
+                have_fmt = 1;
+            } else if (memcmp(data + pos, "data", 4) == 0) {
+                samples = chunk;
+                samples_size = chunk_size;
+            }
+            pos += 8 + chunk_size + (chunk_size & 1);
+        }
+        if (!have_fmt || samples == NULL) {
+            fprintf(stderr, "%s: no fmt or data chunk\n", path);
+            free(data);
+            return -1;
+        }
+    }
+    if (channels != 1 && channels != 2) {
+        fprintf(stderr, "%s: %u channels not supported\n", path, channels);
+        free(data);
+        return -1;
+    }
+
+    pcm->nframes = samples_size / (2 * channels);
+    pcm->frames = malloc((pcm->nframes ? pcm->nframes : 1) * 2 * sizeof(int16_t));
+    if (pcm->frames == NULL) {
+        perror("malloc");
+        free(data);
+        return -1;
+    }
+    for (size_t i = 0; i < pcm->nframes; i++) {
+        const unsigned char *p = samples + i * 2 * channels;
+        pcm->frames[2 * i] = (int16_t)le16(p);
+        pcm->frames[2 * i + 1] = (int16_t)le16(p + 2 * (channels - 1));
+    }
+    free(data);
+    return 0;
+}
+
+/**
+ * Linear interpolation to the decoder input rate. Good enough for
+ * recordings made at 44.1 kHz; the decoder's own low-pass follows.
+ */
+static int resample_pcm(pcm_t *pcm, unsigned int rate)
+{
+    if (pcm->rate == rate || pcm->nframes < 2) {
+        pcm->rate = rate;
+        return 0;
+    }
+    double step = (double)pcm->rate / rate;
+    size_t nframes = (size_t)((pcm->nframes - 1) / step);
+    int16_t *frames = malloc((nframes ? nframes : 1) * 2 * sizeof(int16_t));
+    if (frames == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    for (size_t i = 0; i < nframes; i++) {
+        double pos = i * step;
+        size_t a = (size_t)pos;
+        double frac = pos - a;
+        for (int ch = 0; ch < 2; ch++) {
+            double v = pcm->frames[2 * a + ch] * (1.0 - frac) + pcm->frames[2 * a + 2 + ch] * frac;
+            frames[2 * i + ch] = (int16_t)(v < 0 ? v - 0.5 : v + 0.5);
+        }
+    }
+    free(pcm->frames);
+    pcm->frames = frames;
+    pcm->nframes = nframes;
+    pcm->rate = rate;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int raw_rate = 0;
+    unsigned int raw_channels = 2;
+    const char *expected_path = NULL;
+    int workers = 0;
+    enum fsk_analyzer analyzer = FSK_ANALYZER_DEFAULT;
+    minimodem_profile_t profile = MINIMODEM_PROFILE_DEFAULT();
+    int show_confidence = 0;
+    int show_lines = 1;
+    int flags = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:c:e:w:a:P:mpvqh")) != -1) {
+        switch (opt) {
+            case 'r':
+                raw_rate = atoi(optarg);
+                break;
+            case 'c':
+                raw_channels = atoi(optarg);
+                break;
+            case 'e':
+                expected_path = optarg;
+                break;
+            case 'w':
+                workers = atoi(optarg);
+                break;
+            case 'a':
+                if (host_analyzer_parse(optarg, &analyzer) != 0) {
+                    return 2;
+                }
+                break;
+            case 'P':
+                if (host_profile_read(optarg, &profile) != 0) {
+                    return 2;
+                }
+                break;
+            case 'm':
+                flags |= HOST_RECORDS_COMBINE;
+                break;
+            case 'p':
+                flags |= HOST_RECORDS_SEQUENCE;
+                break;
+            case 'v':
+                show_confidence = 1;
+                break;
+            case 'q':
+                show_lines = 0;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    host_decoder_t *hd = host_decoder_create(workers, &profile);
+    if (hd == NULL) {
+        fprintf(stderr, "decoder init failed\n");
+        return 1;
+    }
+    host_decoder_set_analyzer(hd, analyzer);
+    const unsigned int input_rate = host_decoder_input_rate(hd);
+
+    pcm_t pcm;
+    if (load_pcm(argv[optind], raw_rate ? raw_rate : input_rate, raw_channels, &pcm) != 0
+        || resample_pcm(&pcm, input_rate) != 0) {
+        return 1;
+    }
+    const double audio_seconds = (double)pcm.nframes / input_rate;
+
+    host_decoder_run(hd, pcm.frames, pcm.nframes);
+
+    // binary records are printed as their ASCII line
+    host_lines_t lines = {0};
+    const size_t nrejected = host_lines_from_records(&hd->decoded, flags, &lines);
+    const host_lines_t *decoded = &lines;
+    double confidence_sum = 0;
+    float confidence_min = 0;
+    for (size_t i = 0; i < decoded->nlines; i++) {
+        if (show_lines) {
+            if (show_confidence) {
+                printf("%6.2f  %s\n", (double)decoded->confidence[i], decoded->lines[i]);
+            } else {
+                printf("%s\n", decoded->lines[i]);
+            }
+        }
+        confidence_sum += decoded->confidence[i];
+        if (i == 0 || decoded->confidence[i] < confidence_min) {
+            confidence_min = decoded->confidence[i];
+        }
+    }
+    fflush(stdout);
+
+    fprintf(stderr, "audio:       %.1f s at %u Hz\n", audio_seconds, input_rate);
+    fprintf(stderr, "decode time: %.3f s (%.3f s cpu), real-time factor %.1fx\n",
+            hd->wall_seconds, hd->cpu_seconds,
+            hd->wall_seconds > 0 ? audio_seconds / hd->wall_seconds : 0.0);
+    fprintf(stderr, "frames:      %llu, %.0f frames/s\n", hd->nframes,
+            hd->wall_seconds > 0 ? hd->nframes / hd->wall_seconds : 0.0);
+    fprintf(stderr, "lines:       %zu, confidence mean %.2f min %.2f, %zu corrupted or out of sequence records dropped\n",
+            decoded->nlines, decoded->nlines ? confidence_sum / decoded->nlines : 0.0,
+            (double)confidence_min, nrejected);
+
+    int ret = 0;
+    if (expected_path != NULL) {
+        host_lines_t expected = {0};
+        if (host_lines_read(expected_path, 1, &expected) != 0) {
+            return 1;
+        }
+        size_t ngarbled;
+        size_t nmissing = host_lines_compare(decoded, &expected, &ngarbled);
+        fprintf(stderr, "expected:    %zu lines, %zu missing, %zu garbled, line error rate %.4f\n",
+                expected.nlines, nmissing, ngarbled,
+                expected.nlines ? (double)nmissing / expected.nlines : 0.0);
+        host_lines_free(&expected);
+        ret = nmissing ? 3 : 0;
+    }
+
+    host_lines_free(&lines);
+    host_decoder_destroy(hd);
+    free(pcm.frames);
+    return ret;
+}
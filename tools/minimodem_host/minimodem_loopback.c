@@ -0,0 +1,632 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Loopback benchmark: encodes a side file with the firmware's minimodem
+// encoder, plays it through a set of cassette channel scenarios and decodes
+// it again with the firmware's decoder. Prints a markdown table of line
+// error rate and decode cost per scenario, see benchmark.md.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "minimodem_enc_init.h"
+#include "channel_model.h"
+#include "host_decoder.h"
+#include "tape_record.h"
+#include "tape_fec.h"
+
+// hiss-only lead-in and lead-out around the recording, like tape leader
+#define LEADER_SECONDS      (1)
+// where the dropout sweep puts its dropout, a little into the first block
+#define DROPOUT_AT_SECONDS  (LEADER_SECONDS + 2.1f)
+
+/*
+ * The scenarios, each a single impairment at a level seen on real decks,
+ * then everything at once.
+ */
+static const channel_model_cfg_t scenarios[] = {
+    {.name = "clean", .level = 0.5f, .speed = 1.0f},
+    {.name = "hiss", .level = 0.5f, .speed = 1.0f, .noise = 0.5f},
+    {.name = "heavy hiss", .level = 0.5f, .speed = 1.0f, .noise = 1.0f},
+    {.name = "slow tape -3%", .level = 0.5f, .speed = 0.97f, .noise = 0.5f},
+    {.name = "fast tape +3%", .level = 0.5f, .speed = 1.03f, .noise = 0.5f},
+    {.name = "wow 1% flutter 0.2%", .level = 0.5f, .speed = 1.0f, .wow = 0.01f,
+        .flutter = 0.002f, .noise = 0.5f},
+    {.name = "dull head 2.5 kHz", .level = 0.5f, .speed = 1.0f, .highpass_hz = 80,
+        .lowpass_hz = 2500, .noise = 0.5f},
+    {.name = "dropouts", .level = 0.5f, .speed = 1.0f, .dropouts_per_minute = 10,
+        .dropout_ms = 40, .dropout_gain = 0.1f, .noise = 0.5f},
+    {.name = "level drift 50%", .level = 0.3f, .speed = 1.0f, .level_drift = 0.5f,
+        .noise = 0.5f},
+    {.name = "azimuth error 200 us", .level = 0.5f, .speed = 1.0f, .azimuth_us = 200,
+        .noise = 0.5f},
+    {.name = "weak right track -12 dB", .level = 0.5f, .speed = 1.0f, .right_gain = 0.25f,
+        .noise = 0.5f},
+    {.name = "quiet deck -40 dBFS", .level = 0.01f, .speed = 1.0f, .level_drift = 0.5f,
+        .noise = 0.3f},
+    {.name = "worn cassette", .level = 0.3f, .speed = 0.98f, .wow = 0.01f, .flutter = 0.002f,
+        .highpass_hz = 80, .lowpass_hz = 3000, .dropouts_per_minute = 6, .dropout_ms = 30,
+        .dropout_gain = 0.2f, .level_drift = 0.3f, .noise = 0.3f},
+};
+
+#define NUM_SCENARIOS   (sizeof(scenarios) / sizeof(scenarios[0]))
+
+// what the decoder gets with no tape signal, see -i
+#define IDLE_SECONDS    (60)
+static const channel_model_cfg_t idle_inputs[] = {
+    {.name = "stopped deck -66 dBFS", .level = 0.5f, .speed = 1.0f, .noise = 0.001f},
+    {.name = "tape hiss -26 dBFS", .level = 0.5f, .speed = 1.0f, .noise = 0.1f},
+};
+
+#define NUM_IDLE_INPUTS (sizeof(idle_inputs) / sizeof(idle_inputs[0]))
+
+// encoder and decoder parameters, see -P
+static minimodem_profile_t profile = MINIMODEM_PROFILE_DEFAULT();
+// tone analyzer of the decoder, see -a
+static enum fsk_analyzer analyzer = FSK_ANALYZER_DEFAULT;
+
+typedef struct {
+    int16_t *frames;
+    size_t nframes;
+    size_t size;
+} pcm_buf_t;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s scenario] [-w workers] [-a analyzer] [-b] [-f seconds] [-r copies] [-q] [-P profile] [-m] [-p] [-d] [-i] [-l] side.txt\n"
+            "  side.txt     side file to encode, e.g. corpus/sideA.txt\n"
+            "  -s scenario  run only the scenario with this number (see -l)\n"
+            "  -w workers   frame search helper threads (default 0)\n"
+            "  -a analyzer  tone analyzer of the decoder, fft or goertzel (default goertzel)\n"
+            "  -b           send binary records\n"
+            "  -f seconds   send binary records in FEC blocks of this many seconds\n"
+            "  -r copies    lines per second instead of the side file's\n"
+            "  -q           send the records in 4-FSK after a header, like minimodem_encoder\n"
+            "  -P profile   modem profile file, like the firmware's modem.txt\n"
+            "  -m           combine the copies of each record like the decode pipeline\n"
+            "  -p           check the record sequence like the decode pipeline\n"
+            "  -d           sweep the length of a single dropout instead of the scenarios\n"
+            "  -i           decode a minute without tape signal instead of the scenarios\n"
+            "  -l           list the scenarios\n", prog);
+}
+
+static int pcm_append(pcm_buf_t *pcm, const int16_t *frames, size_t nframes)
+{
+    if (pcm->nframes + nframes > pcm->size) {
+        size_t size = pcm->size ? pcm->size : 48000;
+        while (size < pcm->nframes + nframes) {
+            size *= 2;
+        }
+        int16_t *p = realloc(pcm->frames, size * 2 * sizeof(int16_t));
+        if (p == NULL) {
+            return -1;
+        }
+        pcm->frames = p;
+        pcm->size = size;
+    }
+    if (frames) {
+        memcpy(pcm->frames + 2 * pcm->nframes, frames, nframes * 2 * sizeof(int16_t));
+    } else {
+        memset(pcm->frames + 2 * pcm->nframes, 0, nframes * 2 * sizeof(int16_t));
+    }
+    pcm->nframes += nframes;
+    return 0;
+}
+
+static int encoder_output(audio_element_handle_t self, char *buffer, int wanted_size)
+{
+    pcm_buf_t *pcm = self->data;
+    if (pcm_append(pcm, (const int16_t *)buffer, wanted_size / (2 * sizeof(int16_t))) != 0) {
+        return AEL_IO_FAIL;
+    }
+    return wanted_size;
+}
+
+/**
+ * Binary record for a side file line, numbering the copies of each second
+ * like minimodem_encoder does. Pause lines stay ASCII.
+ */
+static const char *binary_record(const minimodem_struct *enc, const char *line, char *record)
+{
+    static char last_line[HOST_MAX_LINE_LEN];
+    static int nrepeat;
+    tape_record_t rec;
+
+    if (strcmp(line, last_line) == 0) {
+        nrepeat++;
+    } else {
+        snprintf(last_line, sizeof(last_line), "%s", line);
+        nrepeat = 0;
+    }
+    if (tape_record_parse(line, &rec) != ESP_OK
+        || (rec.type == TAPE_RECORD_MUTE && rec.playtime_ms > 0)) {
+        return line;
+    }
+    const uint32_t record_ms = fsk_transmit_line_ms(enc);
+    const uint32_t offset_ms = nrepeat * record_ms;
+    if (rec.type == TAPE_RECORD_PLAY && offset_ms < 1000) {
+        rec.playtime_ms += offset_ms;
+        rec.total_ms += offset_ms;
+    }
+    if (tape_record_encode(&rec, record, TAPEFILE_LINE_LENGTH + 1) != ESP_OK) {
+        return line;
+    }
+    return record;
+}
+
+// 0001A_03_b3488ae07e_000M_0481 is a pause record
+static int is_pause(const char *line)
+{
+    return strlen(line) > 23 && line[23] == 'M';
+}
+
+/**
+ * Lines a mode sends in the time of a MINIMODEM_MODE_1200 one
+ */
+static int mode_copies(minimodem_mode_t mode)
+{
+    minimodem_struct base = minimodem_transmit_cfg_profile(MINIMODEM_MODE_1200, &profile);
+    minimodem_struct data = minimodem_transmit_cfg_profile(mode, &profile);
+    return fsk_transmit_line_ms(&base) / fsk_transmit_line_ms(&data);
+}
+
+typedef struct {
+    minimodem_struct base;      // headers
+    minimodem_struct data;      // the records
+    minimodem_mode_t mode;
+    int nheader_slots;          // lines still to be replaced by the header
+    tape_record_t header_rec;
+    struct audio_element element;
+} tape_encoder_t;
+
+/**
+ * Send a line like minimodem_encoder does: at the start and after a pause
+ * a header in MINIMODEM_MODE_1200 takes the place of the first lines
+ */
+static int transmit_line(tape_encoder_t *tape, char *line, size_t len)
+{
+    minimodem_struct *enc = &tape->data;
+    char header[TAPEFILE_LINE_LENGTH + 1];
+
+    if (is_pause(line)) {
+        if (tape->mode != MINIMODEM_MODE_1200) {
+            tape->nheader_slots = mode_copies(tape->mode);
+        }
+    } else if (tape->nheader_slots > 0) {
+        if (tape->nheader_slots-- < mode_copies(tape->mode)) {
+            return 0;
+        }
+        if (tape_record_encode_header(&tape->header_rec, tape->mode, header, sizeof(header)) != ESP_OK) {
+            return 0;
+        }
+        header[TAPEFILE_LINE_LENGTH] = '\n';
+        line = header;
+        len = sizeof(header);
+        enc = &tape->base;
+    }
+    return fsk_transmit_buf(enc, &tape->element, line, len) == 0 ? -1 : 0;
+}
+
+/**
+ * Encode the side file like the encode pipeline does, one line per
+ * fsk_transmit_buf() call. fec_ndata > 0 sends FEC blocks of that many
+ * seconds with copies slots per second. In another mode than
+ * MINIMODEM_MODE_1200 the side file has mode_copies() times the lines.
+ */
+static int encode_side(const host_lines_t *side, int binary, int fec_ndata, int copies,
+                       minimodem_mode_t mode, pcm_buf_t *pcm, unsigned int *rate)
+{
+    tape_encoder_t tape = {
+        .base = minimodem_transmit_cfg_profile(MINIMODEM_MODE_1200, &profile),
+        .data = minimodem_transmit_cfg_profile(mode, &profile),
+        .mode = mode,
+        .nheader_slots = mode != MINIMODEM_MODE_1200 ? mode_copies(mode) : 0,
+        .element = {
+            .output = encoder_output,
+            .data = pcm,
+        },
+    };
+    minimodem_struct *enc = &tape.data;
+    if (tape.base.sample_rate == 0 || enc->sample_rate == 0) {
+        fprintf(stderr, "encoder init failed\n");
+        return -1;
+    }
+    tape_fec_encoder_t *fec = NULL;
+    if (fec_ndata > 0) {
+        fec = tape_fec_encoder_create(fec_ndata, copies);
+        if (fec == NULL) {
+            return -1;
+        }
+    }
+    *rate = enc->sample_rate;
+    int ret = pcm_append(pcm, NULL, LEADER_SECONDS * enc->sample_rate);
+    for (size_t i = 0; i <= side->nlines && ret == 0; i++) {
+        char line[HOST_MAX_LINE_LEN + 1];
+        char record[TAPEFILE_LINE_LENGTH + 1];
+        const char *text = i < side->nlines ? side->lines[i] : NULL;
+        if (text && !is_pause(text)) {
+            tape_record_parse(text, &tape.header_rec);
+        }
+        if (fec) {
+            tape_fec_encoder_push(fec, text);
+            while (ret == 0 && tape_fec_encoder_pop(fec, record)) {
+                size_t len = snprintf(line, sizeof(line), "%s\n", record);
+                ret = transmit_line(&tape, line, len);
+            }
+            continue;
+        }
+        if (text == NULL) {
+            break;
+        }
+        if (binary) {
+            text = binary_record(enc, text, record);
+        }
+        size_t len = snprintf(line, sizeof(line), "%s\n", text);
+        ret = transmit_line(&tape, line, len);
+    }
+    if (ret == 0) {
+        ret = pcm_append(pcm, NULL, LEADER_SECONDS * enc->sample_rate);
+    }
+    tape_fec_encoder_destroy(fec);
+    return ret;
+}
+
+/**
+ * Side file with each second's line repeated copies times instead
+ */
+static void replicate_side(const host_lines_t *side, int copies, host_lines_t *out)
+{
+    for (size_t i = 0; i < side->nlines; i++) {
+        if (i > 0 && strcmp(side->lines[i], side->lines[i - 1]) == 0) {
+            continue;
+        }
+        for (int k = 0; k < (is_pause(side->lines[i]) ? 1 : copies); k++) {
+            host_lines_add(out, side->lines[i], 0);
+        }
+    }
+}
+
+static int compare_line_ptrs(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Every record is replicated on tape, so a record is only lost when none of
+ * its copies decoded
+ */
+static void unique_lines(const host_lines_t *list, host_lines_t *unique)
+{
+    char **sorted = malloc((list->nlines ? list->nlines : 1) * sizeof(char *));
+    if (sorted == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    memcpy(sorted, list->lines, list->nlines * sizeof(char *));
+    qsort(sorted, list->nlines, sizeof(char *), compare_line_ptrs);
+    for (size_t i = 0; i < list->nlines; i++) {
+        if (i == 0 || strcmp(sorted[i], sorted[i - 1]) != 0) {
+            host_lines_add(unique, sorted[i], 0);
+        }
+    }
+    free(sorted);
+}
+
+typedef struct {
+    size_t nmissing;
+    size_t nrecords_lost;
+    size_t ngarbled;
+    size_t nwrong;
+    size_t nrejected;
+    size_t nlines;
+    double confidence;
+    double cpu_seconds;
+    double records_cpu_seconds;
+    size_t nframes;
+} loopback_result_t;
+
+static double cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Decoded lines as long as a record that parse as one but are not one of
+ * records, the ones the decode pipeline would act on wrongly
+ */
+static size_t wrong_records(const host_lines_t *decoded, const host_lines_t *records)
+{
+    size_t nwrong = 0;
+    for (size_t i = 0; i < decoded->nlines; i++) {
+        tape_record_t rec;
+        if (strlen(decoded->lines[i]) != TAPEFILE_LINE_LENGTH
+            || tape_record_parse(decoded->lines[i], &rec) != ESP_OK) {
+            continue;
+        }
+        size_t k = 0;
+        while (k < records->nlines && strcmp(decoded->lines[i], records->lines[k]) != 0) {
+            k++;
+        }
+        nwrong += k == records->nlines;
+    }
+    return nwrong;
+}
+
+/**
+ * Play the tape through one channel and decode it
+ */
+static int run_channel(const channel_model_cfg_t *channel, const pcm_buf_t *tape, unsigned int rate,
+                       int workers, int flags, const host_lines_t *expected, const host_lines_t *records,
+                       loopback_result_t *result)
+{
+    host_decoder_t *hd = host_decoder_create(workers, &profile);
+    if (hd == NULL) {
+        fprintf(stderr, "decoder init failed\n");
+        return -1;
+    }
+    host_decoder_set_analyzer(hd, analyzer);
+    if (host_decoder_input_rate(hd) != rate) {
+        fprintf(stderr, "encoder rate %u does not match decoder input rate %u\n",
+                rate, host_decoder_input_rate(hd));
+        return -1;
+    }
+    int16_t *played = channel_model_apply(channel, tape->frames, tape->nframes, rate,
+                                          &result->nframes);
+    if (played == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    host_decoder_run(hd, played, result->nframes);
+    free(played);
+
+    // rejected: binary records that failed the CRC, which the decode
+    // pipeline would not act on
+    host_lines_t decoded = {0};
+    double t0 = cpu_seconds();
+    result->nrejected = host_lines_from_records(&hd->decoded, flags, &decoded);
+    result->records_cpu_seconds = cpu_seconds() - t0;
+    result->nmissing = host_lines_compare(&decoded, expected, &result->ngarbled);
+    result->nrecords_lost = host_lines_compare(&decoded, records, NULL);
+    result->nwrong = wrong_records(&decoded, records);
+    result->confidence = 0;
+    for (size_t k = 0; k < decoded.nlines; k++) {
+        result->confidence += decoded.confidence[k];
+    }
+    result->nlines = hd->decoded.nlines;
+    result->confidence = decoded.nlines ? result->confidence / decoded.nlines : 0.0;
+    result->cpu_seconds = hd->cpu_seconds;
+    host_lines_free(&decoded);
+    host_decoder_destroy(hd);
+    return 0;
+}
+
+/**
+ * Records lost to a single dropout of increasing length, on top of hiss
+ */
+static int dropout_sweep(const pcm_buf_t *tape, unsigned int rate, int workers, int flags,
+                         const host_lines_t *expected, const host_lines_t *records,
+                         const char *coding)
+{
+    static const float gaps[] = {0.5f, 1.0f, 2.0f, 4.0f, 6.0f, 8.0f, 12.0f};
+    const size_t ngaps = sizeof(gaps) / sizeof(gaps[0]);
+    double records_cpu = 0;
+    size_t nlines = 0;
+
+    printf("| coding | tape time |");
+    for (size_t i = 0; i < ngaps; i++) {
+        printf(" %.1f s |", gaps[i]);
+    }
+    printf(" record layer cpu/line |\n|---|---|");
+    for (size_t i = 0; i < ngaps; i++) {
+        printf("---|");
+    }
+    printf("---|\n| %s | %.1f s |", coding, (double)tape->nframes / rate);
+    for (size_t i = 0; i < ngaps; i++) {
+        channel_model_cfg_t channel = scenarios[1];
+        channel.gap_at_s = DROPOUT_AT_SECONDS;
+        channel.gap_s = gaps[i];
+        loopback_result_t result;
+        if (run_channel(&channel, tape, rate, workers, flags, expected, records, &result) != 0) {
+            return 1;
+        }
+        printf(" %zu/%zu |", result.nrecords_lost, records->nlines);
+        fflush(stdout);
+        records_cpu += result.records_cpu_seconds;
+        nlines += result.nlines;
+    }
+    printf(" %.1f us |\n", nlines ? records_cpu * 1e6 / nlines : 0.0);
+    return 0;
+}
+
+/**
+ * Decode cost with no tape signal, where the decoder spends most of its time
+ */
+static int idle_run(unsigned int rate, int workers)
+{
+    pcm_buf_t quiet = {0};
+    if (pcm_append(&quiet, NULL, IDLE_SECONDS * rate) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    const host_lines_t none = {0};
+    printf("| input | lines | decode cpu | real-time factor |\n|---|---|---|---|\n");
+    for (size_t i = 0; i < NUM_IDLE_INPUTS; i++) {
+        loopback_result_t r;
+        if (run_channel(&idle_inputs[i], &quiet, rate, workers, 0, &none, &none, &r) != 0) {
+            free(quiet.frames);
+            return 1;
+        }
+        printf("| %s | %zu | %.1f ms | %.0fx |\n", idle_inputs[i].name, r.nlines,
+               r.cpu_seconds * 1e3, r.cpu_seconds > 0 ? (double)r.nframes / rate / r.cpu_seconds : 0.0);
+        fflush(stdout);
+    }
+    free(quiet.frames);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int only_scenario = -1;
+    int workers = 0;
+    int binary = 0;
+    int fec_ndata = 0;
+    int copies = 0;
+    minimodem_mode_t mode = MINIMODEM_MODE_1200;
+    int sweep = 0;
+    int idle = 0;
+    int flags = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:w:a:bf:r:qP:mpdilh")) != -1) {
+        switch (opt) {
+            case 's':
+                only_scenario = atoi(optarg);
+                break;
+            case 'w':
+                workers = atoi(optarg);
+                break;
+            case 'a':
+                if (host_analyzer_parse(optarg, &analyzer) != 0) {
+                    return 2;
+                }
+                break;
+            case 'b':
+                binary = 1;
+                break;
+            case 'f':
+                fec_ndata = atoi(optarg);
+                binary = 1;
+                break;
+            case 'r':
+                copies = atoi(optarg);
+                break;
+            case 'q':
+                mode = MINIMODEM_MODE_4FSK;
+                break;
+            case 'P':
+                if (host_profile_read(optarg, &profile) != 0) {
+                    return 2;
+                }
+                break;
+            case 'm':
+                flags |= HOST_RECORDS_COMBINE;
+                break;
+            case 'p':
+                flags |= HOST_RECORDS_SEQUENCE;
+                break;
+            case 'd':
+                sweep = 1;
+                break;
+            case 'i':
+                idle = 1;
+                break;
+            case 'l':
+                for (size_t i = 0; i < NUM_SCENARIOS; i++) {
+                    printf("%2zu  %s\n", i, scenarios[i].name);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    host_lines_t side = {0};
+    if (host_lines_read(argv[optind], 0, &side) != 0) {
+        return 1;
+    }
+    if (copies > 0 || mode != MINIMODEM_MODE_1200) {
+        // the faster mode sends each second's line more often in the same time
+        copies = (copies > 0 ? copies : TAPE_FEC_SLOTS_PER_SECOND) * mode_copies(mode);
+        host_lines_t replicated = {0};
+        replicate_side(&side, copies, &replicated);
+        host_lines_free(&side);
+        side = replicated;
+    } else {
+        copies = TAPE_FEC_SLOTS_PER_SECOND;
+    }
+    host_lines_t expected = {0};
+    host_lines_t records = {0};
+    // the lines replaced by a header are not expected
+    int nheader_slots = mode != MINIMODEM_MODE_1200 ? mode_copies(mode) : 0;
+    for (size_t i = 0; i < side.nlines; i++) {
+        if (is_pause(side.lines[i])) {
+            nheader_slots = mode != MINIMODEM_MODE_1200 ? mode_copies(mode) : 0;
+        } else if (nheader_slots > 0) {
+            nheader_slots--;
+        } else {
+            host_lines_add(&expected, side.lines[i], 0);
+        }
+    }
+    unique_lines(&expected, &records);
+
+    pcm_buf_t tape = {0};
+    unsigned int rate;
+    if (encode_side(&side, binary, fec_ndata, copies, mode, &tape, &rate) != 0) {
+        return 1;
+    }
+    // with FEC each second is sent once, the other copies are parity, and
+    // combining outputs each second once
+    const host_lines_t *lines_expected = (fec_ndata > 0 || (flags & HOST_RECORDS_COMBINE)) ? &records : &expected;
+
+    int ret = 0;
+    if (idle) {
+        ret = idle_run(rate, workers);
+        only_scenario = -2;
+    } else if (sweep) {
+        char coding[64];
+        const char *modem = mode != MINIMODEM_MODE_1200 ? "4-FSK " : "";
+        if (fec_ndata > 0) {
+            snprintf(coding, sizeof(coding), "%sFEC %d s blocks, %d slots/s", modem, fec_ndata, copies);
+        } else {
+            snprintf(coding, sizeof(coding), "%s%s x%d%s", modem, binary ? "binary" : "ASCII", copies,
+                     (flags & HOST_RECORDS_COMBINE) ? " combined" : "");
+        }
+        ret = dropout_sweep(&tape, rate, workers, flags, lines_expected, &records, coding);
+        only_scenario = -2;
+    } else {
+        printf("| # | scenario | lines | line error rate | records lost | garbled | wrong records "
+               "| rejected | confidence | decode cpu | cpu/line | real-time factor |\n");
+        printf("|---|---|---|---|---|---|---|---|---|---|---|---|\n");
+    }
+
+    for (size_t i = 0; i < NUM_SCENARIOS && only_scenario != -2; i++) {
+        if (only_scenario >= 0 && (size_t)only_scenario != i) {
+            continue;
+        }
+        loopback_result_t r;
+        if (run_channel(&scenarios[i], &tape, rate, workers, flags, lines_expected, &records, &r) != 0) {
+            return 1;
+        }
+        double audio_seconds = (double)r.nframes / rate;
+        printf("| %zu | %s | %zu/%zu | %.4f | %zu/%zu | %zu | %zu | %zu | %.2f | %.1f ms | %.0f us | %.0fx |\n",
+               i, scenarios[i].name, lines_expected->nlines - r.nmissing, lines_expected->nlines,
+               lines_expected->nlines ? (double)r.nmissing / lines_expected->nlines : 0.0,
+               r.nrecords_lost, records.nlines, r.ngarbled, r.nwrong, r.nrejected, r.confidence,
+               r.cpu_seconds * 1e3,
+               r.nlines ? r.cpu_seconds * 1e6 / r.nlines : 0.0,
+               r.cpu_seconds > 0 ? audio_seconds / r.cpu_seconds : 0.0);
+        fflush(stdout);
+        if (i == 0 && r.nmissing) {
+            // a clean channel must decode everything
+            ret = 3;
+        }
+    }
+
+    host_lines_free(&side);
+    host_lines_free(&expected);
+    host_lines_free(&records);
+    free(tape.frames);
+    return ret;
+}
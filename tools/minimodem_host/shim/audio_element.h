@@ -0,0 +1,48 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Host shim: just enough of the ESP-ADF audio_element API for the minimodem
+// codec sources. Each element handle carries the callback its output is
+// passed to.
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_AUDIO_ELEMENT_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_AUDIO_ELEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct audio_element *audio_element_handle_t;
+
+typedef enum {
+    AEL_IO_OK = ESP_OK,
+    AEL_IO_FAIL = ESP_FAIL,
+    AEL_IO_DONE = -2,
+    AEL_IO_ABORT = -3,
+    AEL_IO_TIMEOUT = -4,
+} audio_element_err_t;
+
+typedef int (*audio_element_output_fn)(audio_element_handle_t self, char *buffer, int wanted_size);
+
+// an element is just where its output goes
+struct audio_element {
+    audio_element_output_fn output;
+    void *data;
+};
+
+static inline int audio_element_output(audio_element_handle_t self, char *buffer, int wanted_size)
+{
+    return self->output(self, buffer, wanted_size);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_AUDIO_ELEMENT_H
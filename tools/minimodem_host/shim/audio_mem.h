@@ -0,0 +1,15 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_AUDIO_MEM_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_AUDIO_MEM_H
+
+#include <stdlib.h>
+
+#define audio_malloc(size)      malloc(size)
+#define audio_calloc(n, size)   calloc(n, size)
+#define audio_realloc(p, size)  realloc(p, size)
+#define audio_free(p)           free(p)
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_AUDIO_MEM_H
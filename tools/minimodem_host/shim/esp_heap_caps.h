@@ -0,0 +1,27 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_ESP_HEAP_CAPS_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+// the host has a single heap, capabilities are ignored
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_SPIRAM       (1 << 10)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+
+static inline void *heap_caps_malloc(size_t size, unsigned int caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+static inline void *heap_caps_calloc(size_t n, size_t size, unsigned int caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_ESP_HEAP_CAPS_H
@@ -0,0 +1,21 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_ESP_LOG_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_ESP_LOG_H
+
+#include <stdio.h>
+// on the ESP32 these come in through the IDF headers
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+// everything goes to stderr so stdout only carries decoded data;
+// debug and verbose output is dropped like with the default log level
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) fprintf(stderr, "I %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { } while (0)
+#define ESP_LOGV(tag, format, ...) do { } while (0)
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_ESP_LOG_H
@@ -0,0 +1,24 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Host shim: the few FreeRTOS types and tasks/semaphores used by
+// frame_search.c, on top of pthreads. Core affinity and priorities are
+// ignored.
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_FREERTOS_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE             (0)
+#define pdTRUE              (1)
+#define pdPASS              (pdTRUE)
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define portNUM_PROCESSORS  (2)
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_FREERTOS_H
@@ -0,0 +1,62 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+
+#ifndef CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_TASK_H
+#define CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_TASK_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct {
+    TaskFunction_t task;
+    void *param;
+} shim_task_start_t;
+
+static inline void *shim_task_entry(void *arg)
+{
+    shim_task_start_t start = *(shim_task_start_t *)arg;
+    free(arg);
+    start.task(start.param);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name,
+                                                 uint32_t stack_depth, void *param,
+                                                 UBaseType_t prio, TaskHandle_t *handle,
+                                                 BaseType_t core)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)prio;
+    (void)core;
+    pthread_t thread;
+    shim_task_start_t *start = malloc(sizeof(shim_task_start_t));
+    if (start == NULL) {
+        return pdFALSE;
+    }
+    start->task = task;
+    start->param = param;
+    if (pthread_create(&thread, NULL, shim_task_entry, start) != 0) {
+        free(start);
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    if (handle) {
+        *handle = NULL;
+    }
+    return pdPASS;
+}
+
+// only deleting the calling task is supported
+static inline void vTaskDelete(TaskHandle_t task)
+{
+    (void)task;
+    pthread_exit(NULL);
+}
+
+#endif //CASSETTEFLOW_FIRMWARE_TOOLS_MINIMODEM_HOST_SHIM_TASK_H
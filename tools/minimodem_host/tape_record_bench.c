@@ -0,0 +1,170 @@
+//
+// Created by Volodymyr Ananiev <volodymyr.ananiev@gmail.com>
+//
+// Record parser micro-benchmark: parses the ASCII lines of a side file and
+// garbled copies of them with tape_record_parse() and with the sscanf()
+// parser it replaced, checks that they agree and reports the time per line
+// of each, see benchmark.md.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tape_record.h"
+
+#define BENCH_MAX_LINES     (4096)
+#define BENCH_LINE_SIZE     (TAPEFILE_LINE_LENGTH + 1)
+
+typedef struct {
+    const char *name;
+    char (*lines)[BENCH_LINE_SIZE];
+    size_t nlines;
+} bench_set_t;
+
+/**
+ * The ASCII parser before it went by position
+ */
+static esp_err_t parse_sscanf(const char *line, tape_record_t *rec)
+{
+    int seconds;
+    int total_seconds;
+
+    // mute line first, the play line pattern matches its beginning
+    if (sscanf(line, "%4s%c_%02d_%10s_%03dM_%04d",
+               rec->tape_id, &rec->side, &rec->track_num, rec->audio_id, &seconds, &total_seconds) == 6) {
+        rec->type = TAPE_RECORD_MUTE;
+    } else if (sscanf(line, "%4s%c_%02d_%10s_%04d_%04d",
+                      rec->tape_id, &rec->side, &rec->track_num, rec->audio_id, &seconds, &total_seconds) == 6) {
+        rec->type = TAPE_RECORD_PLAY;
+    } else {
+        return ESP_FAIL;
+    }
+    if (seconds < 0 || total_seconds < 0) {
+        return ESP_FAIL;
+    }
+    rec->playtime_ms = (uint32_t)seconds * 1000;
+    rec->total_ms = (uint32_t)total_seconds * 1000;
+    rec->binary = false;
+    return ESP_OK;
+}
+
+static bool same_record(const tape_record_t *a, const tape_record_t *b)
+{
+    return a->type == b->type
+           && strcmp(a->tape_id, b->tape_id) == 0
+           && a->side == b->side
+           && a->track_num == b->track_num
+           && strcmp(a->audio_id, b->audio_id) == 0
+           && a->playtime_ms == b->playtime_ms
+           && a->total_ms == b->total_ms;
+}
+
+static double cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @return ns per line of parse over set, repeated until it took long enough
+ *  to time
+ */
+static double time_parser(esp_err_t (*parse)(const char *, tape_record_t *), const bench_set_t *set,
+                          size_t *nparsed)
+{
+    tape_record_t rec;
+    size_t nruns = 0;
+    *nparsed = 0;
+    const double start = cpu_seconds();
+    double elapsed;
+    do {
+        for (size_t i = 0; i < set->nlines; i++) {
+            *nparsed += parse(set->lines[i], &rec) == ESP_OK;
+        }
+        nruns++;
+        elapsed = cpu_seconds() - start;
+    } while (elapsed < 0.2);
+    *nparsed /= nruns;
+    return elapsed * 1e9 / (double)(nruns * set->nlines);
+}
+
+/**
+ * Lines both parsers accept as different records, and lines only the
+ * sscanf() parser accepts
+ */
+static void compare_parsers(const bench_set_t *set, size_t *ndiffer, size_t *nsscanf_only)
+{
+    *ndiffer = 0;
+    *nsscanf_only = 0;
+    for (size_t i = 0; i < set->nlines; i++) {
+        tape_record_t a, b;
+        const bool ok_a = tape_record_parse(set->lines[i], &a) == ESP_OK;
+        const bool ok_b = parse_sscanf(set->lines[i], &b) == ESP_OK;
+        if (ok_a && ok_b && !same_record(&a, &b)) {
+            (*ndiffer)++;
+        } else if (ok_b && !ok_a) {
+            (*nsscanf_only)++;
+        }
+    }
+}
+
+static void garble(const bench_set_t *from, bench_set_t *to)
+{
+    for (size_t i = 0; i < from->nlines; i++) {
+        memcpy(to->lines[i], from->lines[i], BENCH_LINE_SIZE);
+        // a character lost to a dropout or turned into another one
+        const int pos = rand() % TAPEFILE_LINE_LENGTH;
+        to->lines[i][pos] = (rand() % 3 == 0) ? ' ' : (char)(' ' + 1 + rand() % 94);
+    }
+    to->nlines = from->nlines;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s side_file\n", argv[0]);
+        return 1;
+    }
+    FILE *fd = fopen(argv[1], "r");
+    if (fd == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    static char lines[2][BENCH_MAX_LINES][BENCH_LINE_SIZE];
+    bench_set_t sets[2] = {
+            {"ASCII lines", lines[0], 0},
+            {"garbled ASCII lines", lines[1], 0},
+    };
+    char line[128];
+    while (fgets(line, sizeof(line), fd) && sets[0].nlines < BENCH_MAX_LINES) {
+        line[strcspn(line, "\r\n")] = 0;
+        tape_record_t rec;
+        if (tape_record_parse(line, &rec) == ESP_OK) {
+            strcpy(sets[0].lines[sets[0].nlines++], line);
+        }
+    }
+    fclose(fd);
+    if (sets[0].nlines == 0) {
+        fprintf(stderr, "%s: no records\n", argv[1]);
+        return 1;
+    }
+    srand(1);
+    garble(&sets[0], &sets[1]);
+
+    printf("| lines | parsed | sscanf parsed | sscanf only | differing | parse | sscanf parse | speedup |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (size_t k = 0; k < sizeof(sets) / sizeof(sets[0]); k++) {
+        size_t nparsed, nparsed_sscanf, ndiffer, nsscanf_only;
+        const double ns = time_parser(tape_record_parse, &sets[k], &nparsed);
+        const double ns_sscanf = time_parser(parse_sscanf, &sets[k], &nparsed_sscanf);
+        compare_parsers(&sets[k], &ndiffer, &nsscanf_only);
+        printf("| %s | %zu/%zu | %zu/%zu | %zu | %zu | %.0f ns | %.0f ns | %.1fx |\n",
+               sets[k].name, nparsed, sets[k].nlines, nparsed_sscanf, sets[k].nlines,
+               nsscanf_only, ndiffer, ns, ns_sscanf, ns_sscanf / ns);
+    }
+    return 0;
+}